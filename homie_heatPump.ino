@@ -38,14 +38,14 @@ void setupHandler() {
 
     if(updateFlags & UpdateProperty::UpdateControl) {
       // Always get update to get sample time
-      senville->toJsonBuff((char *)controlBuff);
+      senville->toJsonBuff((char *)controlBuff, maxBuffLen);
 
       strVal = String((const char *)controlBuff);
       controlNode0.setProperty("control").send(strVal);
     }
     if(updateFlags & UpdateProperty::Display) {
       // Always get update to get sample time
-      disp->toBuff((char *)displayBuff);
+      disp->toBuff((char *)displayBuff, maxBuffLen);
 
       strVal = String((const char *)displayBuff);
       controlNode0.setProperty("display").send(strVal);
@@ -67,7 +67,7 @@ void loopHandler() {
   // Check display hardware
   if(disp->hasUpdate()) {
 #ifdef DEBUG
-    disp->toBuff((char *)displayBuff);
+    disp->toBuff((char *)displayBuff, maxBuffLen);
     Serial.println((const char *)displayBuff);
 #endif
     updateFlags |= UpdateProperty::Display;
@@ -86,11 +86,11 @@ void loopHandler() {
     if(senville->isValid(mem)) {
 #ifdef DEBUG
       Serial.print("Validated message : ");
-      senville->toBuff((char *)controlBuff);
+      senville->toBuff((char *)controlBuff, maxBuffLen);
       Serial.println((char *)controlBuff);
 #endif
 #ifdef DEBUG
-      senville->toJsonBuff((char *)controlBuff);
+      senville->toJsonBuff((char *)controlBuff, maxBuffLen);
       Serial.println((char *)controlBuff);
 #endif
       updateFlags |= UpdateProperty::UpdateControl;
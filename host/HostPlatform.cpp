@@ -0,0 +1,232 @@
+//
+//  HostPlatform.cpp
+//
+//  Virtual clock, GPIO, edge interrupt and Timer1 backend for host builds
+//
+#include <stdarg.h>
+#include <chrono>
+#include "HostPlatform.hpp"
+#include "espinc/spi_register.h"
+
+HostSerial Serial;
+
+#define NO_WIRE 0xFF
+
+typedef struct HostPinS {
+    uint8_t mode;
+    uint8_t level;
+    uint8_t wiredTo;
+    int intrMode;
+    void (*isr)(void);
+} HostPin;
+
+static HostPin pins[HOST_GPIO_PINS];
+static uint64_t clockNs = 0;
+static HostPlatform::PinListener pinListener = nullptr;
+
+// Timer1 state
+static hw_timer_callback_t timerCallback = nullptr;
+static void *timerArg = nullptr;
+static uint64_t timerPsPerTick = 200000; // TIMER_CLKDIV_16
+static uint64_t timerDueNs = 0;
+static bool timerEnabled = false;
+static bool timerRunning = false;
+
+// HSPI register block and the bits clocked in since the last sync reset
+static uint32_t hspiRegs[0x100 / 4];
+static unsigned int hspiBits = 0;
+
+static unsigned long isrCalls = 0;
+static uint64_t isrNs = 0;
+static bool isrTimed = false;
+
+// Slave shifts MOSI in on the rising clock while CS is low, up to the MOSI length
+static void hspiClock() {
+    if(!(hspiRegs[(SPI_SLAVE(HSPI) - REG_SPI_BASE(HSPI)) / 4] & SPI_SLAVE_MODE)) return;
+    if(pins[HOST_HSPI_CS].level != LOW) return;
+    uint32_t user1 = hspiRegs[(SPI_USER1(HSPI) - REG_SPI_BASE(HSPI)) / 4];
+    unsigned int len = ((user1 >> SPI_USR_MOSI_BITLEN_S) & SPI_USR_MOSI_BITLEN) + 1;
+    if(hspiBits >= len || hspiBits >= SPI_W_REGS * 32) return;
+    bool lsbFirst = hspiRegs[(SPI_CTRL(HSPI) - REG_SPI_BASE(HSPI)) / 4] & SPI_WR_BIT_ORDER;
+    unsigned int byte = hspiBits / 8, bit = lsbFirst ? hspiBits % 8 : 7 - hspiBits % 8;
+    if(pins[HOST_HSPI_MOSI].level) {
+        hspiRegs[(SPI_W0(HSPI) - REG_SPI_BASE(HSPI)) / 4 + byte / 4] |= 1UL << ((byte % 4) * 8 + bit);
+    }
+    hspiBits++;
+}
+
+static void setLevel(uint8_t pin, uint8_t level) {
+    if(pin >= HOST_GPIO_PINS) return;
+    HostPin &p = pins[pin];
+    level = level ? HIGH : LOW;
+    if(p.level == level) return;
+    p.level = level;
+    if(pinListener) pinListener(pin, level, clockNs);
+    if(pin == HOST_HSPI_CLK && level == HIGH) hspiClock();
+    if(p.isr && (p.intrMode == CHANGE
+                 || (p.intrMode == RISING && level == HIGH)
+                 || (p.intrMode == FALLING && level == LOW))) {
+        isrCalls++;
+        if(isrTimed) {
+            auto start = std::chrono::steady_clock::now();
+            p.isr();
+            isrNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        } else {
+            p.isr();
+        }
+    }
+    if(p.wiredTo != NO_WIRE) setLevel(p.wiredTo, level);
+}
+
+//////////
+// Arduino / Sming API
+//////////
+unsigned long micros() {
+    return (unsigned long)(clockNs / 1000);
+}
+unsigned long millis() {
+    return (unsigned long)(clockNs / 1000000);
+}
+uint32_t esp_get_ccount() {
+    return (uint32_t)(clockNs * HOST_CPU_MHZ / 1000);
+}
+uint8_t system_get_cpu_freq() {
+    return HOST_CPU_MHZ;
+}
+void delay(unsigned long ms) {
+    HostPlatform::advanceNs((uint64_t)ms * 1000000);
+}
+void delayMicroseconds(unsigned int us) {
+    HostPlatform::advanceNs((uint64_t)us * 1000);
+}
+void pinMode(uint8_t pin, uint8_t mode) {
+    if(pin < HOST_GPIO_PINS) pins[pin].mode = mode;
+}
+int digitalRead(uint8_t pin) {
+    return pin < HOST_GPIO_PINS ? pins[pin].level : LOW;
+}
+void digitalWrite(uint8_t pin, uint8_t val) {
+    setLevel(pin, val);
+}
+void attachInterrupt(uint8_t intr, void (*isr)(void), int mode) {
+    if(intr >= HOST_GPIO_PINS) return;
+    pins[intr].isr = isr;
+    pins[intr].intrMode = mode;
+}
+void detachInterrupt(uint8_t intr) {
+    if(intr >= HOST_GPIO_PINS) return;
+    pins[intr].isr = nullptr;
+}
+
+void hw_timer_init() {
+    timerEnabled = false;
+    timerRunning = false;
+}
+void hw_timer1_attach_interrupt(hw_timer_source_type_t /*source_type*/, hw_timer_callback_t callback, void *arg) {
+    timerCallback = callback;
+    timerArg = arg;
+}
+void hw_timer1_enable(hw_timer_clkdiv_t div, hw_timer_intr_type_t /*intr_type*/, bool /*auto_load*/) {
+    timerPsPerTick = (1000000000000ULL << div) / HW_TIMER1_APB_HZ;
+    timerEnabled = true;
+}
+void hw_timer1_write(uint32_t ticks) {
+    if(!timerEnabled) return;
+    timerDueNs = clockNs + ((uint64_t)(ticks & HW_TIMER1_MAX_TICKS) * timerPsPerTick) / 1000;
+    timerRunning = true;
+}
+void hw_timer1_disable() {
+    timerEnabled = false;
+    timerRunning = false;
+}
+
+uint32_t hostPeriRead(uint32_t addr) {
+    if(addr < REG_SPI_BASE(HSPI) || addr >= REG_SPI_BASE(HSPI) + sizeof(hspiRegs)) return 0;
+    return hspiRegs[(addr - REG_SPI_BASE(HSPI)) / 4];
+}
+void hostPeriWrite(uint32_t addr, uint32_t val) {
+    if(addr < REG_SPI_BASE(HSPI) || addr >= REG_SPI_BASE(HSPI) + sizeof(hspiRegs)) return;
+    hspiRegs[(addr - REG_SPI_BASE(HSPI)) / 4] = val;
+    // Sync reset starts the slave over, with the buffer cleared
+    if(addr == SPI_SLAVE(HSPI) && (val & SPI_SYNC_RESET)) {
+        hspiBits = 0;
+        memset(&hspiRegs[(SPI_W0(HSPI) - REG_SPI_BASE(HSPI)) / 4], 0, SPI_W_REGS * sizeof(uint32_t));
+    }
+}
+
+int HostSerial::printf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vprintf(fmt, args);
+    va_end(args);
+    return n;
+}
+
+//////////
+// Host control
+//////////
+void HostPlatform::reset() {
+    for(int i = 0; i < HOST_GPIO_PINS; i++) {
+        pins[i].mode = INPUT;
+        pins[i].level = LOW;
+        pins[i].wiredTo = NO_WIRE;
+        pins[i].intrMode = 0;
+        pins[i].isr = nullptr;
+    }
+    clockNs = 0;
+    pinListener = nullptr;
+    timerCallback = nullptr;
+    timerArg = nullptr;
+    timerEnabled = false;
+    timerRunning = false;
+    memset(hspiRegs, 0, sizeof(hspiRegs));
+    hspiBits = 0;
+    isrCalls = 0;
+    isrNs = 0;
+    isrTimed = false;
+}
+uint64_t HostPlatform::nowNs() {
+    return clockNs;
+}
+void HostPlatform::advanceNs(uint64_t ns) {
+    uint64_t target = clockNs + ns;
+    // One-shot timer: the callback re-arms it with hw_timer1_write()
+    while(timerRunning && timerDueNs <= target) {
+        clockNs = timerDueNs;
+        timerRunning = false;
+        if(timerCallback) timerCallback(timerArg);
+    }
+    clockNs = target;
+}
+void HostPlatform::advanceUs(unsigned long us) {
+    advanceNs((uint64_t)us * 1000);
+}
+void HostPlatform::runTimer(uint64_t limitNs) {
+    uint64_t end = clockNs + limitNs;
+    while(timerRunning && timerDueNs <= end) {
+        advanceNs(timerDueNs - clockNs);
+    }
+}
+bool HostPlatform::timerArmed() {
+    return timerRunning;
+}
+void HostPlatform::drivePin(uint8_t pin, uint8_t level) {
+    setLevel(pin, level);
+}
+void HostPlatform::wire(uint8_t from, uint8_t to) {
+    if(from >= HOST_GPIO_PINS) return;
+    pins[from].wiredTo = to;
+    setLevel(to, pins[from].level);
+}
+void HostPlatform::onPinChange(PinListener listener) {
+    pinListener = listener;
+}
+void HostPlatform::timeIsrs(bool on) {
+    isrTimed = on;
+}
+unsigned long HostPlatform::isrCount() {
+    return isrCalls;
+}
+uint64_t HostPlatform::isrCpuNs() {
+    return isrNs;
+}
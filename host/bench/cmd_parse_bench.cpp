@@ -0,0 +1,91 @@
+//
+//  cmd_parse_bench.cpp
+//
+//  Parses the control commands the application sees, as toJsonBuff() writes
+//  them and as quoted JSON, with SenvilleAURA::parseCmd() and with the
+//  StaticJsonDocument/containsKey() path fromJsonBuff() used before.  Reports
+//  time per command and the parse state each keeps on the stack.  Without
+//  ARDUINOJSON_ROOT the second is the host stand-in, not the library.
+//
+//  usage: cmd_parse_bench [rounds]
+//
+#include <chrono>
+#include <ArduinoJson.h>
+#include "SenvilleAURA.hpp"
+
+#define BENCH_ROUNDS 200000
+#define BENCH_JSON_BUFFER 512 // As fromJsonBuff() had
+
+static const char *cmds[] = {
+    "{IsOn:1 , Instr:1 , Mode:3 , FanSpeed:0 , IsSleepOn:0 , SetTemp:22 , SampleId:1234 }",
+    "{Instr:2, Opt:8}",
+    "{Instr:4, IsOn:1, Mode:3, MeasTemp:21, State:127}",
+    "{\"IsOn\":true, \"Instr\":1, \"Mode\":0, \"FanSpeed\":2, \"SetTemp\":24}",
+    "{\"Instr\":1, \"SetTemp\":24.5}"
+};
+#define BENCH_CMDS (sizeof(cmds) / sizeof(cmds[0]))
+
+// Key lookups as fromJsonBuff() made them
+static long viaDocument(const char *buf) {
+    StaticJsonDocument<BENCH_JSON_BUFFER> root;
+    long sum = 0;
+    if(deserializeJson(root, buf)) return -1;
+    if(root.containsKey("Instr")) sum += root["Instr"].as<uint8_t>();
+    if(root.containsKey("IsOn")) sum += root["IsOn"].as<bool>();
+    if(root.containsKey("Mode")) sum += root["Mode"].as<uint8_t>();
+    if(root.containsKey("FanSpeed")) sum += root["FanSpeed"].as<uint8_t>();
+    if(root.containsKey("IsSleepOn")) sum += root["IsSleepOn"].as<bool>();
+    if(root.containsKey("SetTemp")) sum += root["SetTemp"].as<uint8_t>();
+    if(root.containsKey("MeasTemp") && root.containsKey("State")) {
+        sum += root["MeasTemp"].as<uint8_t>() + root["State"].as<uint8_t>();
+    }
+    if(root.containsKey("Opt")) sum += root["Opt"].as<uint8_t>();
+    return sum;
+}
+
+static long viaParseCmd(const char *buf, size_t len) {
+    SenvilleCmd cmd;
+    long sum = 0;
+    if(!SenvilleAURA::parseCmd(buf, len, &cmd)) return -1;
+    for(int k = 0; k < SENVILLE_FIELD_CNT; k++) {
+        if(cmd.hasKey((SenvilleKey)k)) sum += (uint8_t)cmd.val[k];
+    }
+    return sum;
+}
+
+int main(int argc, char **argv) {
+    long rounds = argc > 1 ? atol(argv[1]) : BENCH_ROUNDS;
+    size_t lens[BENCH_CMDS];
+    long sumDoc = 0, sumCmd = 0;
+
+    for(size_t c = 0; c < BENCH_CMDS; c++) {
+        lens[c] = strlen(cmds[c]);
+        if(viaDocument(cmds[c]) != viaParseCmd(cmds[c], lens[c])) {
+            printf("parsers disagree on %s\n", cmds[c]);
+            return 1;
+        }
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(long r = 0; r < rounds; r++) {
+        for(size_t c = 0; c < BENCH_CMDS; c++) sumDoc += viaDocument(cmds[c]);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for(long r = 0; r < rounds; r++) {
+        for(size_t c = 0; c < BENCH_CMDS; c++) sumCmd += viaParseCmd(cmds[c], lens[c]);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    double n = (double)rounds * BENCH_CMDS;
+    printf("%s %8.1f ns/cmd, %4zu bytes parse state\n",
+#ifdef ARDUINOJSON_HOST_STANDIN
+           "document (stand-in)",
+#else
+           "document           ",
+#endif
+           std::chrono::duration<double, std::nano>(t1 - t0).count() / n,
+           sizeof(StaticJsonDocument<BENCH_JSON_BUFFER>));
+    printf("parseCmd            %8.1f ns/cmd, %4zu bytes parse state\n",
+           std::chrono::duration<double, std::nano>(t2 - t1).count() / n, sizeof(SenvilleCmd));
+    return sumDoc == sumCmd ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+//
+//  disp_bench.cpp
+//
+//  Drives the display bus as the indoor board does, a byte every 4 ms on
+//  CLK/DATA and an LED_INTER pulse every third byte, while the loop takes
+//  the updates from the frame ring every scan interval as scan() does.  The
+//  value changes each second, flashes off for a frame and shows 88 for two
+//  frames in between, and every showing must come out of the ring in order
+//  and stamped within two frames.  Reads the bus first with an interrupt per
+//  CLK edge, then with the HSPI slave clocking the bytes in, and reports the
+//  interrupts taken and their CPU time.
+//
+//  usage: disp_bench [seconds] [scan interval ms]
+//
+
+#include <deque>
+#include "SenvilleAURADisp.hpp"
+
+#define BENCH_SECONDS 60
+#define BENCH_SCAN_MS 200           // DISPLAY_IR_SCAN_INTERVAL of the application
+#define BENCH_BYTE_US 4000
+#define BENCH_CLK_HALF_US 5
+#define BENCH_LED_PULSE_US 100
+#define BENCH_LEDS 0x80
+
+static const uint8_t digits[10] = {0x02, 0x9E, 0x24, 0x0C, 0x98, 0x48, 0x40, 0x1E, 0x00, 0x08};
+
+// One byte LSB first, DATA set up half a clock before the rising edge
+static void clockByte(uint8_t b) {
+    for(uint8_t i = 0; i < 8; i++) {
+        HostPlatform::drivePin(DATA_MOSI, (b >> i) & 0x01);
+        HostPlatform::advanceUs(BENCH_CLK_HALF_US);
+        HostPlatform::drivePin(CLK_HSPI, HIGH);
+        HostPlatform::advanceUs(BENCH_CLK_HALF_US);
+        HostPlatform::drivePin(CLK_HSPI, LOW);
+    }
+}
+
+typedef struct RunS {
+    unsigned long isrs, scans, changes, seen, missed, late;
+    uint64_t isrNs;
+} Run;
+
+typedef struct ShownS {
+    char ascii[DISPLAY_BYTE_SIZE];
+    unsigned long ms;
+} Shown;
+
+// The value for the second, blanked a cycle at a quarter past as the display
+// flashes, and a blip of 88 held for two cycles at half past
+static void frameAt(unsigned long us, unsigned long cycleUs, uint8_t *frame) {
+    uint8_t d = (us / 1000000) % 10;
+    unsigned long into = us % 1000000;
+    frame[0] = digits[d];
+    frame[1] = digits[(d + 1) % 10];
+    frame[2] = BENCH_LEDS;
+    if(into >= 250000 && into < 250000 + cycleUs) frame[0] = frame[1] = 0xFE;
+    if(into >= 500000 && into < 500000 + 2 * cycleUs) frame[0] = frame[1] = digits[8];
+}
+
+static Run runBus(DispCapture capture, long seconds, unsigned long scanMs) {
+    Run run = {0, 0, 0, 0, 0, 0, 0};
+    std::deque<Shown> driven;
+    uint8_t last[DISPLAY_BYTE_SIZE] = {0xFE, 0xFE, 0xFE};
+
+    HostPlatform::reset();
+    HostPlatform::timeIsrs(true);
+    SenvilleAURADisp disp(capture);
+    unsigned long nextScan = scanMs;
+    unsigned long cycleUs = DISPLAY_BYTE_SIZE * BENCH_BYTE_US;
+    for(unsigned long us = 0; us < seconds * 1000000UL; us += cycleUs) {
+        uint8_t frame[DISPLAY_BYTE_SIZE];
+        frameAt(us, cycleUs, frame);
+        // Each showing after a change or a blank is an update the loop should get
+        if(memcmp(frame, last, DISPLAY_BYTE_SIZE) != 0 && frame[0] != 0xFE) {
+            Shown s;
+            snprintf(s.ascii, sizeof(s.ascii), "%s%s", SenvilleAURADisp::displayBytetoAscii(frame[0]),
+                     SenvilleAURADisp::displayBytetoAscii(frame[1]));
+            s.ms = us / 1000;
+            driven.push_back(s);
+            run.changes++;
+        }
+        memcpy(last, frame, DISPLAY_BYTE_SIZE);
+
+        HostPlatform::drivePin(LED_INTER, HIGH);
+        HostPlatform::advanceUs(BENCH_LED_PULSE_US);
+        HostPlatform::drivePin(LED_INTER, LOW);
+        for(uint8_t i = 0; i < DISPLAY_BYTE_SIZE; i++) {
+            HostPlatform::advanceUs(i ? BENCH_BYTE_US - 16 * BENCH_CLK_HALF_US : 400);
+            clockByte(frame[i]);
+        }
+        HostPlatform::advanceNs((uint64_t)(us + cycleUs) * 1000 - HostPlatform::nowNs());
+
+        if(millis() >= nextScan) {
+            nextScan += scanMs;
+            run.scans++;
+            // Each update the ring gave up against what was driven since the last scan
+            char shown[DISPLAY_BYTE_SIZE];
+            while(disp.nextUpdate()) {
+                disp.asciiDisplay(shown, sizeof(shown));
+                while(!driven.empty() && strcmp(driven.front().ascii, shown) != 0) {
+                    driven.pop_front();
+                    run.missed++;
+                }
+                if(driven.empty()) break;
+                // Stamped as the frame finished coming in, a frame after it started
+                // or two for the slave, which has it at the next sync
+                if(disp.getUpdateMs() - driven.front().ms > 2 * cycleUs / 1000) run.late++;
+                driven.pop_front();
+                run.seen++;
+            }
+            disp.listen();
+        }
+    }
+    disp.listenStop();
+    run.missed += driven.size() > 1 ? driven.size() - 1 : 0; // the last may be waiting
+    run.isrs = HostPlatform::isrCount();
+    run.isrNs = HostPlatform::isrCpuNs();
+    return run;
+}
+
+int main(int argc, char **argv) {
+    long seconds = argc > 1 ? atol(argv[1]) : BENCH_SECONDS;
+    unsigned long scanMs = argc > 2 ? atol(argv[2]) : BENCH_SCAN_MS;
+    const char *names[] = {"bit-bang", "HSPI"};
+    Run runs[2];
+    int failed = 0;
+
+    printf("%lds of display bus, scan every %lu ms\n", seconds, scanMs);
+    printf("capture   interrupts  per s    per scan  ISR us/s  changes  seen     missed  late\n");
+    for(int c = DispBitBang; c <= DispHspi; c++) {
+        runs[c] = runBus((DispCapture)c, seconds, scanMs);
+        Run &r = runs[c];
+        printf("%-9s %-11lu %-8.1f %-9.1f %-9.2f %-8lu %-8lu %-7lu %lu\n", names[c], r.isrs, (double)r.isrs / seconds,
+               (double)r.isrs / r.scans, r.isrNs / 1000.0 / seconds, r.changes, r.seen, r.missed, r.late);
+        if(r.missed || r.late || r.seen == 0) failed++;
+    }
+    printf("reclaimed %.1f%% of the interrupts, %.1f%% of the ISR time\n",
+           100.0 * (1.0 - (double)runs[DispHspi].isrs / runs[DispBitBang].isrs),
+           100.0 * (1.0 - (double)runs[DispHspi].isrNs / runs[DispBitBang].isrNs));
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+//
+//  field_bench.cpp
+//
+//  SenvilleAURA getters and setters, now driven by SENVILLE_FIELDS, against
+//  the hand masked accessors they replaced, kept here as the reference.  The
+//  same sequence of sets goes to both and the state bytes are compared, then
+//  each is timed.  The reference is kept out of line as the class methods are.
+//
+//  usage: field_bench [rounds]
+//
+#include <chrono>
+#include "SenvilleAURA.hpp"
+
+#define BENCH_ROUNDS 2000000
+#define NOINLINE __attribute__((noinline))
+
+// Hand written accessors on sample 0, as they were
+static uint8_t ref[MSG_CONST_STATE(1)];
+NOINLINE static bool refGetPowerOn() { return 0x80 & ref[MSG_CMD_OPT(0)]; }
+NOINLINE static void refSetPowerOn(bool s) { ref[MSG_CMD_OPT(0)] = s ? ref[MSG_CMD_OPT(0)] | 0x80 : ref[MSG_CMD_OPT(0)] & 0x7F; }
+NOINLINE static Mode refGetMode() { return static_cast<Mode>(ref[MSG_CMD_OPT(0)] & 0x07); }
+NOINLINE static void refSetMode(Mode v) { ref[MSG_CMD_OPT(0)] &= 0xF8; ref[MSG_CMD_OPT(0)] |= (0x07 & (uint8_t)v); }
+NOINLINE static FanSpeed refGetFanSpeed() { return static_cast<FanSpeed>((ref[MSG_CMD_OPT(0)] & 0x18) >> 3); }
+NOINLINE static void refSetFanSpeed(FanSpeed v) {
+    Mode m = refGetMode();
+    if(m == Mode::ModeAuto || m == Mode::Dry) v = FanSpeed::FanAuto;
+    ref[MSG_CMD_OPT(0)] &= 0xE7;
+    ref[MSG_CMD_OPT(0)] |= ((v << 3) & 0x18);
+}
+NOINLINE static bool refGetSleepOn() { return ref[MSG_CMD_OPT(0)] & 0x40; }
+NOINLINE static void refSetSleepOn(bool s) {
+    Mode m = refGetMode();
+    if(m == Mode::Fan || m == Mode::Dry || !refGetPowerOn()) return;
+    ref[MSG_CMD_OPT(0)] = s ? ref[MSG_CMD_OPT(0)] | 0x40 : ref[MSG_CMD_OPT(0)] & 0xBF;
+}
+NOINLINE static uint8_t refGetSetTemp() { return (ref[MSG_RUNMODE(0)] & 0x0f) + TEMP_LOWEST; }
+NOINLINE static void refSetSetTemp(uint8_t v) {
+    if(refGetMode() == Mode::Fan) return;
+    ref[MSG_RUNMODE(0)] &= 0xF0;
+    ref[MSG_RUNMODE(0)] |= (v - TEMP_LOWEST) & 0x0F;
+}
+
+static long refRound(long r) {
+    refSetPowerOn(r & 0x01);
+    refSetMode(static_cast<Mode>(r % 5));
+    refSetFanSpeed(static_cast<FanSpeed>(r % 4));
+    refSetSleepOn(r & 0x02);
+    refSetSetTemp(TEMP_LOWEST + r % 16);
+    return refGetPowerOn() + refGetMode() + refGetFanSpeed() + refGetSleepOn() + refGetSetTemp();
+}
+static long fieldRound(SenvilleAURA &s, long r) {
+    s.setPowerOn(r & 0x01);
+    s.setMode(static_cast<Mode>(r % 5));
+    s.setFanSpeed(static_cast<FanSpeed>(r % 4));
+    s.setSleepOn(r & 0x02);
+    s.setSetTemp(TEMP_LOWEST + r % 16);
+    return s.getPowerOn() + s.getMode() + s.getFanSpeed() + s.getSleepOn() + s.getSetTemp();
+}
+
+int main(int argc, char **argv) {
+    long rounds = argc > 1 ? atol(argv[1]) : BENCH_ROUNDS;
+    long sumRef = 0, sumField = 0;
+    SenvilleAURA senville;
+    memcpy(ref, senville.getMessage(), sizeof(ref));
+
+    for(long r = 0; r < 1000; r++) {
+        if(refRound(r) != fieldRound(senville, r) || memcmp(ref, senville.getMessage(), MSG_CRC(0)) != 0) {
+            printf("state differs after round %ld\n", r);
+            return 1;
+        }
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(long r = 0; r < rounds; r++) sumRef += refRound(r);
+    auto t1 = std::chrono::steady_clock::now();
+    for(long r = 0; r < rounds; r++) sumField += fieldRound(senville, r);
+    auto t2 = std::chrono::steady_clock::now();
+
+    printf("hand masked    %6.1f ns/round (5 sets, 5 gets)\n", std::chrono::duration<double, std::nano>(t1 - t0).count() / rounds);
+    printf("field table    %6.1f ns/round\n", std::chrono::duration<double, std::nano>(t2 - t1).count() / rounds);
+    return sumRef == sumField ? 0 : 1;
+}
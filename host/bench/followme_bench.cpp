@@ -0,0 +1,78 @@
+//
+//  followme_bench.cpp
+//
+//  A day of Follow-Me from SenvilleFollowMe, polled every scan interval of
+//  the application with a room temperature that drifts a degree now and
+//  then, and the display property scan keeping the link busy for a few
+//  seconds each minute.  Checks no keep-alive deadline is missed and reports
+//  the frames and IR airtime against a sender of one update per interval.
+//
+//  usage: followme_bench [hours] [fixed interval s]
+//
+
+#include "IRLink.hpp"
+#include "SenvilleAURA.hpp"
+#include "SenvilleFollowMe.hpp"
+
+#define BENCH_HOURS 24
+#define BENCH_POLL_MS 200          // DISPLAY_IR_SCAN_INTERVAL of the application
+#define BENCH_SCAN_EVERY_MS 60000  // PROPERTY_SCAN_AT_TIME
+#define BENCH_SCAN_BUSY_MS 6000
+#define BENCH_DRIFT_EVERY_MS 600000
+
+int main(int argc, char **argv) {
+    long hours = argc > 1 ? atol(argv[1]) : BENCH_HOURS;
+    unsigned long fixedMs = argc > 2 ? atol(argv[2]) * 1000UL : FM_FIXED_INTERVAL_MS;
+    char cmd[] = "{Instr:1, IsOn:1, Mode:3, FanSpeed:0, SetTemp:22}";
+    uint8_t msg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+
+    HostPlatform::reset();
+    SenvilleAURA senville;
+    if(!senville.fromJsonBuff(cmd, msg)) {
+        printf("could not build frame from %s\n", cmd);
+        return 1;
+    }
+    SenvilleFollowMe followMe(&senville, fixedMs);
+    uint8_t temp = 20;
+    uint32_t rnd = 12345;
+    unsigned long lastSent = 0, longestGap = 0, busySends = 0, changes = 0;
+    unsigned long endMs = hours * 3600000UL;
+    int failed = 0;
+
+    followMe.setMeasured(temp);
+    followMe.start();
+    for(unsigned long now = BENCH_POLL_MS; now <= endMs; now += BENCH_POLL_MS) {
+        if(now % BENCH_DRIFT_EVERY_MS == 0) {
+            rnd = rnd * 1103515245 + 12345;
+            uint8_t step = (rnd >> 16) % 3; // down, same or up a degree
+            if(step != 1) {
+                temp = step ? temp + 1 : temp - 1;
+                changes++;
+            }
+            followMe.setMeasured(temp);
+        }
+        bool busy = (now % BENCH_SCAN_EVERY_MS) < BENCH_SCAN_BUSY_MS;
+        if(followMe.poll(msg, now, busy) != NULL) {
+            if(SenvilleAURA::checkFrame(msg) != FrameOk) {
+                printf("bad frame at %lu ms\n", now);
+                failed++;
+            }
+            if(lastSent && now - lastSent > longestGap) longestGap = now - lastSent;
+            if(busy) busySends++;
+            lastSent = now;
+        }
+    }
+    followMe.stop();
+    followMe.poll(msg, endMs + BENCH_POLL_MS);
+    if(longestGap >= FM_KEEPALIVE_MS) {
+        printf("keep-alive missed, %lu ms between frames\n", longestGap);
+        failed++;
+    }
+
+    printf("%ld h, %lu temperature changes, longest gap %lu s, %lu sent while busy\n",
+           hours, changes, longestGap / 1000, busySends);
+    printf("scheduled  %6lu frames %8lu ms airtime\n", followMe.getSent(), followMe.getAirtimeMs());
+    printf("every %3lus %6lu frames %8lu ms airtime\n", fixedMs / 1000, followMe.getFixedSent(), followMe.getFixedAirtimeMs());
+    printf("saved      %15ld ms airtime\n", followMe.getSavedMs());
+    return failed ? 1 : 0;
+}
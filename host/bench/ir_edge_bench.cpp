@@ -0,0 +1,150 @@
+//
+//  ir_edge_bench.cpp
+//
+//  Replays a Senville frame, rendered by IRLink::send on the virtual Timer1,
+//  edge by edge into IRLink::handler and reports receive throughput.  Then
+//  sends frames back to back while the loop is polled on the scan() interval
+//  and reports how many were lost to overrun.  Last, three quick SetTemp
+//  commands and two options go through the send queue, looped back to the
+//  receive pin, to check commands merge and options keep their order.
+//
+//  usage: ir_edge_bench [frames] [scan interval ms]
+//
+#include <chrono>
+#include <vector>
+#include "IRLink.hpp"
+#include "SenvilleAURA.hpp"
+
+#define BENCH_FRAMES 20000
+#define BENCH_FRAME_GAP_US 40000
+#define BENCH_SCAN_MS 200
+#define BENCH_BACK_TO_BACK 50
+
+static std::vector<uint64_t> edgeNs;
+
+static void recordEdge(uint8_t pin, uint8_t level, uint64_t ns) {
+    if(pin == IR_PINX) edgeNs.push_back(ns);
+}
+
+static int sentCallbacks = 0;
+static void sendComplete() {
+    sentCallbacks++;
+}
+
+int main(int argc, char **argv) {
+    long frames = argc > 1 ? atol(argv[1]) : BENCH_FRAMES;
+    unsigned long scanMs = argc > 2 ? atol(argv[2]) : BENCH_SCAN_MS;
+    char cmd[] = "{Instr:1, IsOn:1, Mode:3, FanSpeed:0, SetTemp:22}";
+    uint8_t msg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+    char buf[100];
+
+    HostPlatform::reset();
+    SenvilleAURA senville;
+    IRLink link(senville.getIRConfig());
+    if(!senville.fromJsonBuff(cmd, msg)) {
+        printf("could not build frame from %s\n", cmd);
+        return 1;
+    }
+
+    // Render the pulses exactly as they leave the send pin
+    HostPlatform::onPinChange(recordEdge);
+    link.send(msg, true);
+    HostPlatform::runTimer();
+    HostPlatform::onPinChange(nullptr);
+
+    std::vector<uint64_t> gaps;
+    gaps.push_back((uint64_t)BENCH_FRAME_GAP_US * 1000);
+    for(size_t i = 1; i < edgeNs.size(); i++) gaps.push_back(edgeNs[i] - edgeNs[i-1]);
+
+    // Replay into the receive pin
+    long decoded = 0, valid = 0;
+    unsigned long edges = 0;
+    uint8_t level = HIGH;
+    SenvilleAURA check;
+    HostPlatform::drivePin(IR_PINR, level);
+    link.listen();
+    auto start = std::chrono::steady_clock::now();
+    for(long f = 0; f < frames; f++) {
+        for(size_t i = 0; i < gaps.size(); i++) {
+            HostPlatform::advanceNs(gaps[i]);
+            level = !level;
+            HostPlatform::drivePin(IR_PINR, level);
+        }
+        edges += gaps.size();
+        uint8_t *mem = link.loop_chkMsgReceived();
+        if(mem != NULL) {
+            decoded++;
+            if(check.isValid(mem)) valid++;
+            link.listen();
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(stop - start).count();
+
+    // Back to back frames, e.g. a held remote or our own echo after a command,
+    // with the loop only looking every scanMs
+    long b2bDecoded = 0;
+    unsigned long nextScan = millis() + scanMs;
+    unsigned long dropped = link.getDroppedFrames();
+    for(long f = 0; f < BENCH_BACK_TO_BACK; f++) {
+        for(size_t i = 0; i < gaps.size(); i++) {
+            HostPlatform::advanceNs(i == 0 ? 10000000 : gaps[i]);
+            level = !level;
+            HostPlatform::drivePin(IR_PINR, level);
+            while(millis() >= nextScan) {
+                nextScan += scanMs;
+                while(link.loop_chkMsgReceived() != NULL) b2bDecoded++;
+            }
+        }
+    }
+    while(link.loop_chkMsgReceived() != NULL) b2bDecoded++;
+    dropped = link.getDroppedFrames() - dropped;
+
+    // Send queue, the receiver hears the send pin
+    const char *queued[] = {
+        "{Instr:1, IsOn:1, Mode:3, FanSpeed:0, SetTemp:20}",
+        "{Instr:1, IsOn:1, Mode:3, FanSpeed:0, SetTemp:21}",
+        "{Instr:1, IsOn:1, Mode:3, FanSpeed:0, SetTemp:22}",
+        "{Instr:2, Opt:8}",
+        "{Instr:2, Opt:1}"
+    };
+    char txOrder[64] = "", item[16];
+    SenvilleAURA tx, rx;
+    uint8_t *mem;
+    HostPlatform::drivePin(IR_PINR, HIGH);
+    HostPlatform::wire(IR_PINX, IR_PINR);
+    link.loop_chkSendComplete();
+    link.onSendComplete(sendComplete);
+    while(link.loop_chkMsgReceived() != NULL) ;
+    for(size_t i = 0; i < sizeof(queued) / sizeof(queued[0]); i++) {
+        strcpy(buf, queued[i]);
+        tx.fromJsonBuff(buf, msg);
+        link.sendAsync(msg, SenvilleAURA::getInstructionType(msg) == Instruction::Command ? IRTxSupersede : IRTxOrdered);
+        HostPlatform::advanceUs(1000);
+    }
+    uint8_t depth = link.getTxQueueDepth();
+    for(int ms = 0; ms < 2000; ms += 10) {
+        HostPlatform::advanceUs(10000);
+        link.loop_chkSendComplete();
+        while((mem = link.loop_chkMsgReceived()) != NULL) {
+            if(!rx.isValid(mem)) continue;
+            if(rx.getInstructionType() == Instruction::Command) sprintf(item, "T%d ", rx.getSetTemp());
+            else sprintf(item, "O%d ", rx.getOption());
+            strcat(txOrder, item);
+        }
+    }
+
+    check.toJsonBuff(buf, sizeof(buf));
+    printf("frame      %s\n", buf);
+    printf("edges      %lu (%zu per frame)\n", edges, gaps.size());
+    printf("frames     %ld sent, %ld decoded, %ld valid\n", frames, decoded, valid);
+    printf("time       %.3f s\n", secs);
+    printf("throughput %.2f Medges/s, %.1f ns/edge, %.0f frames/s\n",
+           edges / secs / 1e6, secs * 1e9 / edges, decoded / secs);
+    printf("back2back  %d sent, %ld decoded, %lu dropped, scan every %lu ms\n",
+           BENCH_BACK_TO_BACK, b2bDecoded, dropped, scanMs);
+    printf("tx queue   5 queued, depth %d, %lu merged, %d sent, received %s\n",
+           depth, link.getTxMerged(), sentCallbacks, txOrder);
+    printf("tx latency last %lu us, worst %lu us\n", link.getTxLatencyUs(), link.getTxMaxLatencyUs());
+    return valid == frames && strcmp(txOrder, "T20 T22 O8 O1 ") == 0 ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+//
+//  ir_jitter_bench.cpp
+//
+//  Replays a Senville frame with random jitter added to every pulse, as WiFi
+//  interrupts delaying the edge handler would, and prints the pulse width
+//  histogram IRLink keeps per symbol.  Shows how much of each tolerance
+//  window the received pulses use, and how many frames the soft decision on
+//  the two samples brings back when some bit pulses are pushed well off.
+//
+//  usage: ir_jitter_bench [frames] [jitter us] [soft bits 0/1] [off pulses per frame]
+//
+#include <vector>
+#include "IRLink.hpp"
+#include "SenvilleAURA.hpp"
+
+#define BENCH_FRAMES 2000
+#define BENCH_JITTER_US 60
+#define BENCH_FRAME_GAP_US 40000
+#define BENCH_OFF_US 640 // past halfway between zero and one
+
+static std::vector<uint64_t> edgeNs;
+
+static void recordEdge(uint8_t pin, uint8_t level, uint64_t ns) {
+    if(pin == IR_PINX) edgeNs.push_back(ns);
+}
+
+int main(int argc, char **argv) {
+    long frames = argc > 1 ? atol(argv[1]) : BENCH_FRAMES;
+    long jitterUs = argc > 2 ? atol(argv[2]) : BENCH_JITTER_US;
+    bool soft = argc > 3 ? atoi(argv[3]) != 0 : true;
+    int offPulses = argc > 4 ? atoi(argv[4]) : 0;
+    char cmd[] = "{Instr:1, IsOn:1, Mode:3, FanSpeed:0, SetTemp:22}";
+    const char *names[IR_HIST_SYMBOLS] = {"sync0", "sync1", "sep", "zero", "one", "break"};
+    uint8_t msg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+
+    HostPlatform::reset();
+    SenvilleAURA senville;
+    IRLink link(senville.getIRConfig());
+    if(!senville.fromJsonBuff(cmd, msg)) {
+        printf("could not build frame from %s\n", cmd);
+        return 1;
+    }
+    HostPlatform::onPinChange(recordEdge);
+    link.send(msg, true);
+    HostPlatform::runTimer();
+    HostPlatform::onPinChange(nullptr);
+
+    std::vector<uint64_t> gaps;
+    gaps.push_back((uint64_t)BENCH_FRAME_GAP_US * 1000);
+    for(size_t i = 1; i < edgeNs.size(); i++) gaps.push_back(edgeNs[i] - edgeNs[i-1]);
+
+    long decoded = 0, valid = 0;
+    uint8_t level = HIGH, *mem;
+    SenvilleAURA check;
+    if(soft) link.enableSoftBits();
+    srand(1);
+    HostPlatform::drivePin(IR_PINR, level);
+    link.listen();
+    link.resetHistogram();
+    for(long f = 0; f < frames; f++) {
+        // Bit pulses are every other one after the frame gap, two syncs and a separator
+        size_t off[8] = {0};
+        for(int o = 0; o < offPulses && o < 8; o++) {
+            off[o] = 4 + 2 * (rand() % MESSAGE_BITS) + (rand() % MESSAGE_SAMPLES) * (gaps.size() / MESSAGE_SAMPLES);
+        }
+        for(size_t i = 0; i < gaps.size(); i++) {
+            long jitterNs = jitterUs ? (rand() % (2 * jitterUs * 1000 + 1)) - jitterUs * 1000 : 0;
+            for(int o = 0; o < offPulses && o < 8; o++) {
+                if(off[o] == i) jitterNs += (gaps[i] > 1000000 ? -1 : 1) * BENCH_OFF_US * 1000L;
+            }
+            HostPlatform::advanceNs(gaps[i] + jitterNs);
+            level = !level;
+            HostPlatform::drivePin(IR_PINR, level);
+        }
+        while((mem = link.loop_chkMsgReceived()) != NULL) {
+            decoded++;
+            if(check.isValidSoft(mem, link.getSoftBits())) valid++;
+        }
+    }
+
+    uint16_t *hist = link.getHistogram(0);
+    if(hist == NULL) {
+        printf("built without IR_PULSE_HISTOGRAM\n");
+        return 1;
+    }
+    printf("frames %ld sent, %ld decoded, %ld valid (%lu by soft decision), jitter +/-%ld us\n",
+           frames, decoded, valid, check.getSoftRecovered(), jitterUs);
+    printf("%-6s", "dev%");
+    for(int b = 0; b < IR_HIST_BINS; b++) printf("%7d", (b - IR_HIST_BINS / 2) * IR_HIST_STEP_PCT);
+    printf("\n");
+    for(int s = 0; s < IR_HIST_SYMBOLS; s++) {
+        printf("%-6s", names[s]);
+        for(int b = 0; b < IR_HIST_BINS; b++) printf("%7u", hist[s * IR_HIST_BINS + b]);
+        printf("\n");
+    }
+    char buf[200];
+    printf("%s\n", link.histogramToBuff(buf, sizeof(buf), 0, IRHistSep));
+    return decoded > 0 ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+//
+//  ir_protocol_bench.cpp
+//
+//  Interleaved Senville and NEC frames on one receive pin, decoded with 1 up
+//  to IR_MAX_PROTOCOLS protocols registered.  Reports the per-edge cost of
+//  IRLink::handler as protocols are added and the frames seen per protocol,
+//  then the frames IRCodecRegistry hands to each brand's class.
+//
+//  usage: ir_protocol_bench [frame pairs]
+//
+#include <chrono>
+#include <vector>
+#include "IRCodec.hpp"
+#include "IRLink.hpp"
+#include "IRLinkT.hpp"
+#include "IRNECRemote.hpp"
+#include "SenvilleAURA.hpp"
+
+#define BENCH_PAIRS 10000
+#define BENCH_FRAME_GAP_US 40000
+
+typedef IRLinkT<SenvilleAURAProtocol> SenvilleLink;
+typedef IRLinkT<NECProtocol> NECLink;
+
+static std::vector<uint64_t> edgeNs;
+
+// Both compile time links on the one receive pin
+static void bothHandler() {
+    unsigned long d = SenvilleLink::pulseLength();
+    SenvilleLink::pulse(d);
+    NECLink::pulse(d);
+}
+
+static void recordEdge(uint8_t pin, uint8_t level, uint64_t ns) {
+    if(pin == IR_PINX) edgeNs.push_back(ns);
+}
+
+// Pulse lengths of one frame as IRLink::send puts them on the wire
+static std::vector<uint64_t> renderFrame(IRConfig *config, uint8_t *msg) {
+    std::vector<uint64_t> gaps;
+    IRLink *link = new IRLink(config);
+    edgeNs.clear();
+    HostPlatform::onPinChange(recordEdge);
+    link->send(msg, true);
+    HostPlatform::runTimer();
+    HostPlatform::onPinChange(nullptr);
+    delete link;
+    gaps.push_back((uint64_t)BENCH_FRAME_GAP_US * 1000);
+    for(size_t i = 1; i < edgeNs.size(); i++) gaps.push_back(edgeNs[i] - edgeNs[i-1]);
+    return gaps;
+}
+
+// A protocol that never matches the test stream, only there to cost time
+static IRConfig scaledConfig(IRConfig *from, float scale) {
+    IRConfig c = *from;
+    for(int i = 0; i < MAX_SYNCS; i++) c.syncLengths[i] = IRPulseLengthUsS(from->syncLengths[i].val * scale);
+    c.bitSeparatorLength = IRPulseLengthUsS(from->bitSeparatorLength.val * scale);
+    c.bitZeroLength = IRPulseLengthUsS(from->bitZeroLength.val * scale);
+    c.bitOneLength = IRPulseLengthUsS(from->bitOneLength.val * scale);
+    c.msgBreakLength = IRPulseLengthUsS(from->msgBreakLength.val * scale);
+    return c;
+}
+
+int main(int argc, char **argv) {
+    long pairs = argc > 1 ? atol(argv[1]) : BENCH_PAIRS;
+    char cmd[] = "{Instr:1, IsOn:1, Mode:0, FanSpeed:2, SetTemp:24}";
+    uint8_t senvilleMsg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+
+    HostPlatform::reset();
+    SenvilleAURA senville;
+    IRNECRemote nec;
+    irMsg m;
+    m.addr = 0x6B86;
+    m.cmd = 0x5A;
+    nec.setMessage(m);
+    if(!senville.fromJsonBuff(cmd, senvilleMsg)) {
+        printf("could not build frame from %s\n", cmd);
+        return 1;
+    }
+
+    std::vector<uint64_t> stream = renderFrame(senville.getIRConfig(), senvilleMsg);
+    std::vector<uint64_t> necGaps = renderFrame(nec.getIRConfig(), nec.rawMessage());
+    stream.insert(stream.end(), necGaps.begin(), necGaps.end());
+
+    IRConfig padding[IR_MAX_PROTOCOLS];
+    for(int i = 0; i < IR_MAX_PROTOCOLS; i++) padding[i] = scaledConfig(senville.getIRConfig(), 1.8f + i);
+
+    printf("protocols  ns/edge   Senville  NEC       other  dropped\n");
+    int failed = 0;
+    for(int protocols = 1; protocols <= IR_MAX_PROTOCOLS; protocols++) {
+        long seen[IR_MAX_PROTOCOLS] = {0};
+        uint8_t level = HIGH, protocol;
+        IRLink link(senville.getIRConfig());
+        for(int p = 1; p < protocols; p++) {
+            link.addProtocol(p == 1 ? nec.getIRConfig() : &padding[p]);
+        }
+        HostPlatform::drivePin(IR_PINR, level);
+        link.listen();
+
+        auto start = std::chrono::steady_clock::now();
+        for(long f = 0; f < pairs; f++) {
+            for(size_t i = 0; i < stream.size(); i++) {
+                HostPlatform::advanceNs(stream[i]);
+                level = !level;
+                HostPlatform::drivePin(IR_PINR, level);
+            }
+            while(link.loop_chkMsgReceived(&protocol) != NULL) seen[protocol]++;
+        }
+        auto stop = std::chrono::steady_clock::now();
+        double secs = std::chrono::duration<double>(stop - start).count();
+        long others = 0;
+        for(int p = 2; p < IR_MAX_PROTOCOLS; p++) others += seen[p];
+
+        printf("%-10d %-9.1f %-9ld %-9ld %-6ld %lu\n", protocols,
+               secs * 1e9 / (pairs * stream.size()), seen[0], seen[1], others,
+               link.getDroppedFrames());
+        if(seen[0] != pairs || seen[1] != (protocols > 1 ? pairs : 0) || others) failed++;
+        link.listenStop();
+    }
+
+    // Through the registry, each frame checked by its brand's class
+    {
+        long seenC[2] = {0};
+        uint8_t level = HIGH;
+        IRCodec *codec;
+        IRCodecOf<SenvilleAURA> senvilleCodec(senville, "SenvilleAURA");
+        IRCodecOf<IRNECRemote> necCodec(nec, "NEC");
+        IRLink link(senvilleCodec.getIRConfig());
+        IRCodecRegistry codecs(&link, &senvilleCodec);
+        codecs.add(&necCodec);
+        HostPlatform::drivePin(IR_PINR, level);
+        link.listen();
+        for(long f = 0; f < pairs; f++) {
+            for(size_t i = 0; i < stream.size(); i++) {
+                HostPlatform::advanceNs(stream[i]);
+                level = !level;
+                HostPlatform::drivePin(IR_PINR, level);
+            }
+            while(codecs.loop_chkMsgReceived(&codec) != NULL) seenC[codec == &necCodec]++;
+        }
+        link.listenStop();
+        printf("%-10s %-9s %-9ld %-9ld %-6lu %lu\n", "registry", "", seenC[0], seenC[1],
+               codecs.getRejected(), link.getDroppedFrames());
+        if(seenC[0] != pairs || seenC[1] != pairs || codecs.getRejected()) failed++;
+    }
+
+    // The same stream through IRLinkT, windows and sizes fixed at compile time
+    long seenT[2] = {0};
+    uint8_t level = HIGH;
+    SenvilleLink senvilleT;
+    HostPlatform::drivePin(IR_PINR, level);
+    SenvilleLink::listen(bothHandler);
+    auto start = std::chrono::steady_clock::now();
+    for(long f = 0; f < pairs; f++) {
+        for(size_t i = 0; i < stream.size(); i++) {
+            HostPlatform::advanceNs(stream[i]);
+            level = !level;
+            HostPlatform::drivePin(IR_PINR, level);
+        }
+        while(SenvilleLink::loop_chkMsgReceived() != NULL) seenT[0]++;
+        while(NECLink::loop_chkMsgReceived() != NULL) seenT[1]++;
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(stop - start).count();
+    SenvilleLink::listenStop();
+    printf("%-10s %-9.1f %-9ld %-9ld %-6d %lu\n", "IRLinkT", secs * 1e9 / (pairs * stream.size()),
+           seenT[0], seenT[1], 0, SenvilleLink::getDroppedFrames() + NECLink::getDroppedFrames());
+    if(seenT[0] != pairs || seenT[1] != pairs) failed++;
+
+    return failed ? 1 : 0;
+}
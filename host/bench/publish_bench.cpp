@@ -0,0 +1,119 @@
+//
+//  publish_bench.cpp
+//
+//  Time to build the payloads of one publish(): status, display, debug
+//  counters and all 27 properties.  Compares BuffWriter against the
+//  strlen()+sprintf() appends they were built with before, kept here as the
+//  reference, and checks both write the same text.  The display payload is
+//  built with BuffWriter in both runs.  Also shows the status payload sent
+//  between snapshots when one field changes.
+//
+//  usage: publish_bench [rounds]
+//
+#include <chrono>
+#include "IRLink.hpp"
+#include "SenvilleAURA.hpp"
+#include "SenvilleAURADisp.hpp"
+
+#define BENCH_ROUNDS 50000
+#define BENCH_BUFFLEN 300 // MAX_BUFFLEN of the application
+
+#define APND_CHARBUFF(pos,buf,arg0,arg1) (pos) = strlen(buf); sprintf(&(buf)[(pos)],arg0,arg1);
+
+static Properties properties[DISP_PROPERTIES];
+
+// Status and properties as the append chain wrote them
+static void viaSprintf(SenvilleAURA &s, char *status, char *props) {
+    int pos = 0;
+    status[0] = 0x00;
+    APND_CHARBUFF(pos,status,"{IsOn:%d ", s.getPowerOn())
+    APND_CHARBUFF(pos,status,", Instr:%d ", s.getInstructionType())
+    APND_CHARBUFF(pos,status,", Mode:%d ", s.getMode())
+    APND_CHARBUFF(pos,status,", FanSpeed:%d ", s.getFanSpeed())
+    APND_CHARBUFF(pos,status,", IsSleepOn:%d ", s.getSleepOn())
+    APND_CHARBUFF(pos,status,", SetTemp:%d ", s.getSetTemp())
+    APND_CHARBUFF(pos,status,", SampleId:%ld ", s.getSeqId())
+    APND_CHARBUFF(pos,status,"}%s", "")
+
+    sprintf(props,"{");
+    for(int i = 0; i < DISP_PROPERTIES; i++) {
+        pos = strlen(props);
+        if(strlen(properties[i].key) > 0) {
+            sprintf(&props[pos],"%s:%d%s",properties[i].key,properties[i].value,((i < DISP_PROPERTIES-1)?", ":""));
+        }
+    }
+    pos = strlen(props); sprintf(&props[pos],"}");
+}
+
+static bool viaWriter(SenvilleAURA &s, char *status, char *props) {
+    BuffWriter statusOut(status, BENCH_BUFFLEN), propOut(props, BENCH_BUFFLEN);
+    return s.toJsonBuff(statusOut) && propertiesToBuff(propOut, properties);
+}
+
+int main(int argc, char **argv) {
+    long rounds = argc > 1 ? atol(argv[1]) : BENCH_ROUNDS;
+    char cmd[] = "{Instr:1, IsOn:1, Mode:3, FanSpeed:2, SetTemp:22}";
+    char status[2][BENCH_BUFFLEN], props[2][BENCH_BUFFLEN], disp[BENCH_BUFFLEN];
+    uint8_t msg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+
+    HostPlatform::reset();
+    SenvilleAURA senville;
+    SenvilleAURADisp display;
+    senville.fromJsonBuff(cmd, msg);
+    for(int i = 0; i < DISP_PROPERTIES; i++) {
+        properties[i].key[0] = 'A' + i % 26;
+        properties[i].key[1] = '0' + i % 10;
+        properties[i].key[2] = 0x00;
+        properties[i].value = (i - 5) * 37;
+    }
+
+    viaSprintf(senville, status[0], props[0]);
+    if(!viaWriter(senville, status[1], props[1])) {
+        printf("payload does not fit %d bytes\n", BENCH_BUFFLEN);
+        return 1;
+    }
+    if(strcmp(status[0], status[1]) != 0 || strcmp(props[0], props[1]) != 0) {
+        printf("payloads differ\n%s\n%s\n%s\n%s\n", status[0], status[1], props[0], props[1]);
+        return 1;
+    }
+
+    char small[20];
+    BuffWriter smallOut(small, sizeof(small));
+    if(senville.toJsonBuff(smallOut) || smallOut.length() != sizeof(small) - 1) {
+        printf("overflow of a %zu byte buffer not reported\n", sizeof(small));
+        return 1;
+    }
+
+    // Snapshot, then nothing changed, then only the set temperature
+    char delta[3][BENCH_BUFFLEN];
+    BuffWriter snapOut(delta[0], BENCH_BUFFLEN), sameOut(delta[1], BENCH_BUFFLEN), tempOut(delta[2], BENCH_BUFFLEN);
+    senville.toJsonDelta(snapOut, true);
+    if(senville.toJsonDelta(sameOut) != 0 || sameOut.length() != 0) {
+        printf("unchanged sample wrote a delta: %s\n", delta[1]);
+        return 1;
+    }
+    senville.setSetTemp(23);
+    if(senville.toJsonDelta(tempOut) != 1 || strcmp(delta[2], "{SetTemp:23 }") != 0) {
+        printf("set temperature delta: %s\n", delta[2]);
+        return 1;
+    }
+    senville.setSetTemp(22);
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(long r = 0; r < rounds; r++) {
+        viaSprintf(senville, status[0], props[0]);
+        display.toBuff(disp, sizeof(disp));
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for(long r = 0; r < rounds; r++) {
+        viaWriter(senville, status[1], props[1]);
+        display.toBuff(disp, sizeof(disp));
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    printf("status   %s\nprops    %.60s... (%zu bytes)\n", status[1], props[1], strlen(props[1]));
+    printf("delta    %s (%zu bytes, snapshot %zu)\n", delta[2], strlen(delta[2]), strlen(delta[0]));
+    printf("sprintf    %8.0f ns/publish\n", std::chrono::duration<double, std::nano>(t1 - t0).count() / rounds);
+    printf("BuffWriter %8.0f ns/publish\n", std::chrono::duration<double, std::nano>(t2 - t1).count() / rounds);
+    return 0;
+}
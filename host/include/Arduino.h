@@ -0,0 +1,11 @@
+//
+//  Arduino.h
+//
+//  Host stand-in for the Arduino core header, see HostPlatform.hpp
+//
+#ifndef Arduino_h
+#define Arduino_h
+
+#include "HostPlatform.hpp"
+
+#endif /* Arduino_h */
@@ -0,0 +1,127 @@
+//
+//  ArduinoJson.h
+//
+//  Host stand-in for the part of ArduinoJson 6 used by SenvilleAURA, for
+//  builds where the library itself is not installed.  Flat objects only,
+//  keys may be quoted or bare, values are numbers, true/false or strings.
+//  Like StaticJsonDocument it never touches the heap.
+//
+#ifndef ArduinoJson_h
+#define ArduinoJson_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARDUINOJSON_HOST_STANDIN 1
+
+class DeserializationError {
+public:
+    enum Code { Ok, InvalidInput, NoMemory };
+    DeserializationError(Code c = Ok) : code(c) {}
+    explicit operator bool() const { return code != Ok; }
+    const char *c_str() const {
+        return code == Ok ? "Ok" : (code == NoMemory ? "NoMemory" : "InvalidInput");
+    }
+private:
+    Code code;
+};
+
+#define JSON_STANDIN_KEYLEN 16
+
+typedef struct JsonStandinMemberS {
+    char key[JSON_STANDIN_KEYLEN];
+    long value;
+} JsonStandinMember;
+
+class JsonStandinVariant {
+public:
+    JsonStandinVariant(const JsonStandinMember *m) : member(m) {}
+    template<typename T> T as() const { return member ? (T)member->value : (T)0; }
+private:
+    const JsonStandinMember *member;
+};
+
+template<size_t capacity>
+class StaticJsonDocument {
+public:
+    StaticJsonDocument() : count(0) {}
+    bool containsKey(const char *key) const { return find(key) != nullptr; }
+    JsonStandinVariant operator[](const char *key) const { return JsonStandinVariant(find(key)); }
+
+    void clear() { count = 0; }
+    bool add(const char *key, size_t keyLen, long value) {
+        if(count >= maxMembers || keyLen >= JSON_STANDIN_KEYLEN) return false;
+        memcpy(members[count].key, key, keyLen);
+        members[count].key[keyLen] = 0x00;
+        members[count].value = value;
+        count++;
+        return true;
+    }
+private:
+    static const size_t maxMembers = capacity / sizeof(JsonStandinMember) > 0
+                                     ? capacity / sizeof(JsonStandinMember) : 1;
+    JsonStandinMember members[maxMembers];
+    size_t count;
+
+    const JsonStandinMember *find(const char *key) const {
+        for(size_t i = 0; i < count; i++) {
+            if(strcmp(members[i].key, key) == 0) return &members[i];
+        }
+        return nullptr;
+    }
+};
+
+inline const char *jsonStandinSkipWs(const char *p) {
+    while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    return p;
+}
+
+template<size_t capacity>
+DeserializationError deserializeJson(StaticJsonDocument<capacity> &doc, const char *input) {
+    const char *p = jsonStandinSkipWs(input), *key;
+    size_t keyLen;
+    long value;
+
+    doc.clear();
+    if(*p++ != '{') return DeserializationError::InvalidInput;
+    p = jsonStandinSkipWs(p);
+    if(*p == '}') return DeserializationError::Ok;
+    for(;;) {
+        // Key, quoted or not
+        if(*p == '"') {
+            key = ++p;
+            while(*p && *p != '"') p++;
+            if(!*p) return DeserializationError::InvalidInput;
+            keyLen = p++ - key;
+        } else {
+            key = p;
+            while(*p && *p != ':' && *p != ' ' && *p != '\t') p++;
+            keyLen = p - key;
+        }
+        p = jsonStandinSkipWs(p);
+        if(keyLen == 0 || *p++ != ':') return DeserializationError::InvalidInput;
+        p = jsonStandinSkipWs(p);
+        // Value
+        if(strncmp(p, "true", 4) == 0) { value = 1; p += 4; }
+        else if(strncmp(p, "false", 5) == 0) { value = 0; p += 5; }
+        else if(*p == '"') {
+            value = 0;
+            p++;
+            while(*p && *p != '"') p++;
+            if(!*p++) return DeserializationError::InvalidInput;
+        } else {
+            char *end;
+            value = (long)strtod(p, &end); // as<>() of a float truncates
+            if(end == p) return DeserializationError::InvalidInput;
+            p = end;
+        }
+        if(!doc.add(key, keyLen, value)) return DeserializationError::NoMemory;
+        p = jsonStandinSkipWs(p);
+        if(*p == ',') { p = jsonStandinSkipWs(p + 1); continue; }
+        if(*p == '}') return DeserializationError::Ok;
+        return DeserializationError::InvalidInput;
+    }
+}
+
+#endif /* ArduinoJson_h */
@@ -0,0 +1,11 @@
+//
+//  HardwareTimer.h
+//
+//  Host stand-in, the Timer1 calls are declared in HostPlatform.hpp
+//
+#ifndef HardwareTimer_h
+#define HardwareTimer_h
+
+#include "HostPlatform.hpp"
+
+#endif /* HardwareTimer_h */
@@ -0,0 +1,158 @@
+//
+//  HostPlatform.hpp
+//
+//  Linux backend for the hardware calls made by the IR and display classes
+//  (clock, GPIO, edge interrupts and the one-shot Timer1).  Time is virtual:
+//  it only moves when the host code advances it, and every timer or edge
+//  interrupt due on the way is run synchronously, in order, exactly like
+//  the ESP8266 would have run it.  This lets the code in sming_heatpump/app
+//  compile unmodified for a workstation.
+//
+#ifndef HostPlatform_hpp
+#define HostPlatform_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define INPUT  0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+
+#define LOW  0x0
+#define HIGH 0x1
+
+// Interrupt modes, same values as the ESP8266 core
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define DEC 10
+#define HEX 16
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define GDB_IRAM_ATTR
+
+// Strings live in RAM on the host
+#define F(s) (s)
+#define _F(s) (s)
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint8_t uint8;
+
+#define HOST_GPIO_PINS 17
+
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Xtensa CCOUNT, wraps every 53 s at 80 MHz like the real one
+#define HOST_CPU_MHZ 80
+uint32_t esp_get_ccount();
+uint8_t system_get_cpu_freq();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+void attachInterrupt(uint8_t intr, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t intr);
+
+// Interrupt handlers run synchronously on the host, nothing to mask
+inline void cli() {}
+inline void sei() {}
+
+// ESP8266 Timer1 (FRC1), 23-bit down counter clocked from the 80MHz APB
+typedef enum {
+    TIMER_CLKDIV_1 = 0,
+    TIMER_CLKDIV_16 = 4,
+    TIMER_CLKDIV_256 = 8
+} hw_timer_clkdiv_t;
+typedef enum {
+    TIMER_EDGE_INT = 0,
+    TIMER_LEVEL_INT = 1
+} hw_timer_intr_type_t;
+typedef enum {
+    TIMER_FRC1_SOURCE = 0,
+    TIMER_NMI_SOURCE = 1
+} hw_timer_source_type_t;
+typedef void (*hw_timer_callback_t)(void *arg);
+
+#define HW_TIMER1_APB_HZ 80000000UL
+#define HW_TIMER1_MAX_TICKS 0x7FFFFF
+
+void hw_timer_init();
+void hw_timer1_attach_interrupt(hw_timer_source_type_t source_type, hw_timer_callback_t callback, void *arg);
+void hw_timer1_enable(hw_timer_clkdiv_t div, hw_timer_intr_type_t intr_type, bool auto_load);
+void hw_timer1_write(uint32_t ticks);
+void hw_timer1_disable();
+
+// Peripheral registers, only the HSPI block is modelled (see espinc/spi_register.h)
+uint32_t hostPeriRead(uint32_t addr);
+void hostPeriWrite(uint32_t addr, uint32_t val);
+#define READ_PERI_REG(addr) hostPeriRead((uint32_t)(addr))
+#define WRITE_PERI_REG(addr, val) hostPeriWrite((uint32_t)(addr), (uint32_t)(val))
+#define SET_PERI_REG_MASK(addr, mask) WRITE_PERI_REG((addr), READ_PERI_REG(addr) | (mask))
+#define CLEAR_PERI_REG_MASK(addr, mask) WRITE_PERI_REG((addr), READ_PERI_REG(addr) & ~(mask))
+// Pin functions are not modelled, HSPI is always on GPIO14 (CLK), 13 (MOSI) and 15 (CS)
+#define PERIPHS_IO_MUX_MTMS_U 0
+#define PERIPHS_IO_MUX_MTCK_U 0
+#define PERIPHS_IO_MUX_MTDO_U 0
+#define FUNC_HSPI_CLK 2
+#define FUNC_HSPID_MOSI 2
+#define FUNC_HSPI_CS0 2
+#define PIN_FUNC_SELECT(reg, func) do {} while(0)
+#define HOST_HSPI_CLK 14
+#define HOST_HSPI_MOSI 13
+#define HOST_HSPI_CS 15
+
+class HostSerial {
+public:
+    void begin(unsigned long /*baud*/) {}
+    void print(const char *s) { fputs(s, stdout); }
+    void print(char c) { fputc(c, stdout); }
+    void print(long v, int base = DEC) { printf(base == HEX ? "%lX" : "%ld", v); }
+    void print(unsigned long v, int base = DEC) { printf(base == HEX ? "%lX" : "%lu", v); }
+    void print(int v, int base = DEC) { print((long)v, base); }
+    void print(unsigned int v, int base = DEC) { print((unsigned long)v, base); }
+    void println() { fputc('\n', stdout); }
+    template<typename T> void println(T v) { print(v); println(); }
+    template<typename T> void println(T v, int base) { print(v, base); println(); }
+    int printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+extern HostSerial Serial;
+
+// Host side control of the virtual hardware
+namespace HostPlatform {
+    typedef void (*PinListener)(uint8_t pin, uint8_t level, uint64_t ns);
+
+    // Clock back to zero, all pins low and inputs, interrupts and timer off
+    void reset();
+
+    uint64_t nowNs();
+    // Move the virtual clock forward, running any timer interrupt that falls due
+    void advanceNs(uint64_t ns);
+    void advanceUs(unsigned long us);
+    // Advance until Timer1 stops re-arming itself (or limitNs elapses)
+    void runTimer(uint64_t limitNs = 10000000000ULL);
+    bool timerArmed();
+
+    // Drive an input from outside the chip, fires any edge interrupt attached
+    void drivePin(uint8_t pin, uint8_t level);
+    // Connect an output pin to an input pin, e.g. IR send line to IR receive line
+    void wire(uint8_t from, uint8_t to);
+    // Observe every level change on any pin
+    void onPinChange(PinListener listener);
+
+    // Edge interrupt handlers run, and the host CPU time spent in them if timed
+    void timeIsrs(bool on);
+    unsigned long isrCount();
+    uint64_t isrCpuNs();
+}
+
+#endif /* HostPlatform_hpp */
@@ -0,0 +1,11 @@
+//
+//  SmingCore.h
+//
+//  Host stand-in for the Sming framework header, see HostPlatform.hpp
+//
+#ifndef SmingCore_h
+#define SmingCore_h
+
+#include "HostPlatform.hpp"
+
+#endif /* SmingCore_h */
@@ -0,0 +1,45 @@
+//
+//  spi_register.h
+//
+//  Host stand-in for the ESP8266 SDK header, only the registers and bits
+//  used for the HSPI slave.  HostPlatform.cpp clocks MOSI into SPI_W0 on
+//  each rising CLK while CS is low, as the slave does in hardware.
+//
+#ifndef spi_register_h
+#define spi_register_h
+
+#include "HostPlatform.hpp"
+
+#define SPI  0
+#define HSPI 1
+
+#define REG_SPI_BASE(i)  (0x60000200 - (i) * 0x100)
+
+#define SPI_CTRL(i)      (REG_SPI_BASE(i) + 0x8)
+#define SPI_WR_BIT_ORDER (1UL << 26)
+#define SPI_RD_BIT_ORDER (1UL << 25)
+
+#define SPI_USER(i)      (REG_SPI_BASE(i) + 0x1C)
+#define SPI_USR_COMMAND  (1UL << 31)
+#define SPI_USR_ADDR     (1UL << 30)
+#define SPI_USR_MOSI     (1UL << 27)
+#define SPI_CK_I_EDGE    (1UL << 6)
+
+#define SPI_USER1(i)     (REG_SPI_BASE(i) + 0x20)
+#define SPI_USR_MOSI_BITLEN   0x000001FF
+#define SPI_USR_MOSI_BITLEN_S 17
+
+#define SPI_USER2(i)     (REG_SPI_BASE(i) + 0x24)
+#define SPI_USR_COMMAND_BITLEN   0x0000000F
+#define SPI_USR_COMMAND_BITLEN_S 28
+
+#define SPI_SLAVE(i)     (REG_SPI_BASE(i) + 0x30)
+#define SPI_SYNC_RESET   (1UL << 31)
+#define SPI_SLAVE_MODE   (1UL << 30)
+#define SPI_TRANS_DONE_EN (1UL << 9)
+#define SPI_TRANS_DONE   (1UL << 4)
+
+#define SPI_W0(i)        (REG_SPI_BASE(i) + 0x40)
+#define SPI_W_REGS 16
+
+#endif /* spi_register_h */
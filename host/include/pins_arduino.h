@@ -0,0 +1,11 @@
+//
+//  pins_arduino.h
+//
+//  Host stand-in, GPIO numbers are used directly as pin numbers
+//
+#ifndef pins_arduino_h
+#define pins_arduino_h
+
+#include "HostPlatform.hpp"
+
+#endif /* pins_arduino_h */
@@ -0,0 +1,47 @@
+//
+//  DispGlyphs.hpp
+//
+//  The unit's display glyphs, the segment code of each character as the
+//  display bus carries it with the LSB clear, for the display tests to build
+//  frames from and check SenvilleAURADisp's table against.  Digits are ahead
+//  of the letters that share their segments, as the old map had them.
+//
+#ifndef DispGlyphs_hpp
+#define DispGlyphs_hpp
+
+#include "SenvilleDispFilter.hpp"
+
+#define TEST_SHOW_MS 480          // label or value up, blinking in diagnostic mode
+
+typedef struct GlyphS {
+    uint8_t code;
+    const char *ascii;
+} Glyph;
+
+static const Glyph glyphs[] = {
+    {0xFE, " "}, {0x9C, "-1"}, {0xFC, "-"}, {0x02, "0"}, {0x9E, "1"}, {0x24, "2"}, {0x0C, "3"},
+    {0x98, "4"}, {0x48, "5"}, {0x40, "6"}, {0x1E, "7"}, {0x00, "8"}, {0x08, "9"}, {0x10, "A"},
+    {0x62, "C"}, {0x60, "E"}, {0x70, "F"}, {0x90, "H"}, {0xF2, "I"}, {0xE2, "L"}, {0x30, "P"},
+    {0x48, "S"}, {0x72, "T"}, {0x82, "U"}, {0xC0, "b"}, {0xE4, "c"}, {0x84, "d"}, {0x20, "e"},
+    {0x9E, "i"}, {0xC4, "o"}, {0xF4, "r"}, {0xC6, "u"}
+};
+#define GLYPH_CNT (sizeof(glyphs) / sizeof(glyphs[0]))
+
+// Segment codes of a two character text, "-1" taking a character of its own
+static inline bool encode(const char *text, uint8_t *frame) {
+    uint8_t n = 0;
+    while(*text && n < DISP_DIGITS) {
+        const Glyph *g = NULL;
+        for(size_t i = 0; i < GLYPH_CNT; i++) {
+            size_t len = strlen(glyphs[i].ascii);
+            if(strncmp(text, glyphs[i].ascii, len) == 0 && (!g || len > strlen(g->ascii))) g = &glyphs[i];
+        }
+        if(!g) return false;
+        frame[n++] = g->code;
+        text += strlen(g->ascii);
+    }
+    frame[DISP_DIGITS] = 0x80;
+    return n == DISP_DIGITS && *text == 0x00;
+}
+
+#endif /* DispGlyphs_hpp */
@@ -0,0 +1,143 @@
+//
+//  disp_filter_test.cpp
+//
+//  SenvilleDispFilter fed the frames the display ring would hold for a
+//  diagnostic mode sweep, each property blinking between its label and value
+//  a few times, and for the set temperature flashing in normal mode.  A few
+//  percent of frames have a digit garbled.  Each label and value must settle
+//  on what was shown, nothing may settle on anything else, and the value
+//  must settle within its first showing.  Reports settle times against the
+//  fixed wait of three scan intervals scan() used to make.
+//
+//  usage: disp_filter_test [glitch percent]
+//
+
+#include "SenvilleDispFilter.hpp"
+#include "DispGlyphs.hpp"
+
+#define TEST_GLITCH_PCT 3
+#define TEST_BLINKS 3
+#define TEST_POLL_MS 200          // DISPLAY_IR_SCAN_INTERVAL of the application
+#define TEST_FIXED_WAIT_MS 600    // DISPLAY_IR_SCAN_INTERVAL * 3
+
+typedef struct FeedS {
+    SenvilleDispFilter *filter;
+    uint8_t last[DISPLAY_BYTE_SIZE];
+    unsigned long ms, nextPoll;
+    uint32_t rnd;
+    int glitchPct;
+    long wrong;
+    char want[DISP_TRACKS][DISP_MAXSTRINGPERCODE * 2];
+    unsigned long settleMs[DISP_TRACKS], settleMax[DISP_TRACKS], settled[DISP_TRACKS];
+    unsigned long settledAt[DISP_TRACKS];
+} Feed;
+
+static void settle(Feed &f, uint8_t events) {
+    for(uint8_t t = 0; t < DISP_TRACKS; t++) {
+        if(!(events & (1 << t))) continue;
+        const char *got = f.filter->getText((DispTrack)t);
+        if(strcmp(got, f.want[t]) != 0) {
+            printf("%s settled on \"%s\" at %lu ms, showing \"%s\", %u%%\n", t ? "value" : "label",
+                   got, f.ms, f.want[t], f.filter->getConfidence((DispTrack)t));
+            f.wrong++;
+            continue;
+        }
+        unsigned long ms = f.filter->getSettleMs((DispTrack)t);
+        f.settleMs[t] += ms;
+        if(ms > f.settleMax[t]) f.settleMax[t] = ms;
+        f.settled[t]++;
+        f.settledAt[t] = f.filter->getSettledAt((DispTrack)t);
+    }
+}
+
+// Show frame for ms, a frame each cycle, into the filter as the ring would have them
+static void show(Feed &f, const uint8_t *frame, unsigned long ms) {
+    for(unsigned long end = f.ms + ms; f.ms < end; f.ms += DISP_FRAME_MS) {
+        uint8_t shown[DISPLAY_BYTE_SIZE];
+        memcpy(shown, frame, DISPLAY_BYTE_SIZE);
+        f.rnd ^= f.rnd << 13;
+        f.rnd ^= f.rnd >> 17;
+        f.rnd ^= f.rnd << 5;
+        if((int)(f.rnd % 100) < f.glitchPct) shown[(f.rnd >> 8) & 0x01] ^= 0x02 << ((f.rnd >> 12) % 7);
+        if(memcmp(shown, f.last, DISPLAY_BYTE_SIZE) != 0) {
+            DispFrame d;
+            memcpy(d.bytes, shown, DISPLAY_BYTE_SIZE);
+            d.ms = f.ms;
+            memcpy(f.last, shown, DISPLAY_BYTE_SIZE);
+            settle(f, f.filter->update(d));
+        }
+        if(f.ms >= f.nextPoll) {
+            f.nextPoll += TEST_POLL_MS;
+            settle(f, f.filter->poll(f.ms));
+        }
+    }
+}
+
+static void report(const char *name, Feed &f, DispTrack t, unsigned long expected) {
+    printf("%-10s %3lu of %3lu settled  mean %4lu ms  worst %4lu ms\n", name, f.settled[t], expected,
+           f.settled[t] ? f.settleMs[t] / f.settled[t] : 0, f.settleMax[t]);
+    if(f.settled[t] != expected) f.wrong++;
+}
+
+int main(int argc, char **argv) {
+    // One value for each property, some of which read as labels too
+    static const char *values[DISP_PROPERTIES] = {
+        "24", "10", "32", "-5", "-9", "69", "00", "27", "26", "40", "55", "96", "FF",
+        "07", "b2", "A0", "12", "b0", "33", "E4", "d0", "c1", "09", "17", "AA", "b2", "5E"
+    };
+    static const char labels[] = SENVILLEAURA_PROPERTY_LABELS;
+    const uint8_t blank[DISPLAY_BYTE_SIZE] = {0xFE, 0xFE, 0x80};
+    uint8_t label[DISPLAY_BYTE_SIZE], value[DISPLAY_BYTE_SIZE];
+    SenvilleDispFilter filter(labels, sizeof(labels));
+    Feed f;
+    memset(&f, 0, sizeof(f));
+    f.filter = &filter;
+    f.glitchPct = argc > 1 ? atoi(argv[1]) : TEST_GLITCH_PCT;
+    f.rnd = 2024;
+    f.nextPoll = TEST_POLL_MS;
+
+    // Diagnostic mode, stepping through every property
+    const char *l = labels;
+    for(int i = 0; i < DISP_PROPERTIES; i++, l += strlen(l) + 1) {
+        if(!encode(l, label) || !encode(values[i], value)) {
+            printf("cannot show %s %s\n", l, values[i]);
+            return 1;
+        }
+        filter.resetTrack(DispTrackLabel);
+        strcpy(f.want[DispTrackLabel], l);
+        strcpy(f.want[DispTrackValue], values[i]);
+        unsigned long settledBefore = f.settled[DispTrackValue];
+        for(int b = 0; b < TEST_BLINKS; b++) {
+            show(f, label, TEST_SHOW_MS);
+            unsigned long valueAt = f.ms;
+            show(f, value, TEST_SHOW_MS);
+            if(b == 0 && (f.settled[DispTrackValue] == settledBefore || f.settledAt[DispTrackValue] < valueAt)) {
+                printf("%s %s did not settle in its first showing\n", l, values[i]);
+                f.wrong++;
+            }
+        }
+    }
+    report("labels", f, DispTrackLabel, DISP_PROPERTIES);
+    report("values", f, DispTrackValue, DISP_PROPERTIES);
+
+    // Normal mode, the set temperature flashing with nothing else shown
+    Feed n;
+    memset(&n, 0, sizeof(n));
+    n.filter = &filter;
+    n.glitchPct = f.glitchPct;
+    n.rnd = 7;
+    n.ms = f.ms;
+    n.nextPoll = f.nextPoll;
+    filter.reset();
+    strcpy(n.want[DispTrackValue], "22");
+    encode("22", value);
+    for(int b = 0; b < 10; b++) {
+        show(n, value, 500);
+        show(n, blank, 500);
+    }
+    report("flashing", n, DispTrackValue, 1);
+    if(filter.isSettled(DispTrackLabel)) n.wrong++;
+
+    printf("fixed wait %d ms, %ld wrong\n", TEST_FIXED_WAIT_MS, f.wrong + n.wrong);
+    return f.wrong + n.wrong ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+//
+//  disp_lut_test.cpp
+//
+//  All 256 display bytes through SenvilleAURADisp::displayBytetoAscii, as a
+//  value and as a label, against the glyph list the table was built from
+//  walked the old way, first match of the masked code.  The LSB must not
+//  matter, 0x48 must read "5" in a value and "S" in a label, and each
+//  property label must come back from its segment codes read as
+//  asciiDisplay() reads them, the first as a label and the second as a
+//  value.  Reports lookups per second for the table and the walk.
+//
+//  usage: disp_lut_test
+//
+
+#include <chrono>
+#include "DispGlyphs.hpp"
+
+#define TEST_PASSES 20000
+
+static const char *walk(uint8_t b) {
+    for(size_t i = 0; i < GLYPH_CNT; i++) {
+        if((b & 0xFE) == glyphs[i].code) return glyphs[i].ascii;
+    }
+    return "?";
+}
+
+static uint8_t codeOf(char c) {
+    for(size_t i = 0; i < GLYPH_CNT; i++) {
+        if(glyphs[i].ascii[0] == c && glyphs[i].ascii[1] == 0x00) return glyphs[i].code;
+    }
+    return 0xFF;
+}
+
+int main(int argc, char **argv) {
+    long failed = 0;
+
+    for(int b = 0; b <= 0xFF; b++) {
+        const char *value = SenvilleAURADisp::displayBytetoAscii(b, DispValue);
+        const char *label = SenvilleAURADisp::displayBytetoAscii(b, DispLabel);
+        const char *wantLabel = (b & 0xFE) == 0x48 ? "S" : walk(b);
+        if(strcmp(value, walk(b)) != 0) {
+            printf("0x%02X as value: \"%s\", wanted \"%s\"\n", b, value, walk(b));
+            failed++;
+        }
+        if(strcmp(label, wantLabel) != 0) {
+            printf("0x%02X as label: \"%s\", wanted \"%s\"\n", b, label, wantLabel);
+            failed++;
+        }
+    }
+
+    // Every label as the display would show it, LSB set on the second character
+    const char *labels = SENVILLEAURA_PROPERTY_LABELS;
+    char shown[DISP_MAXSTRINGPERCODE * 2];
+    for(int i = 0; i < DISP_PROPERTIES; i++, labels += strlen(labels) + 1) {
+        uint8_t c1 = codeOf(labels[0]), c2 = codeOf(labels[1]) | 0x01;
+        snprintf(shown, sizeof(shown), "%s%s", SenvilleAURADisp::displayBytetoAscii(c1, DispLabel),
+                 SenvilleAURADisp::displayBytetoAscii(c2, DispValue));
+        if(c1 == 0xFF || strcmp(shown, labels) != 0) {
+            printf("label %s reads \"%s\"\n", labels, shown);
+            failed++;
+        }
+    }
+
+    volatile size_t sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for(int p = 0; p < TEST_PASSES; p++)
+    for(int b = 0; b <= 0xFF; b++) sink += SenvilleAURADisp::displayBytetoAscii(b)[0];
+    auto t1 = std::chrono::steady_clock::now();
+    for(int p = 0; p < TEST_PASSES; p++)
+    for(int b = 0; b <= 0xFF; b++) sink += walk(b)[0];
+    auto t2 = std::chrono::steady_clock::now();
+    double lookups = TEST_PASSES * 256.0;
+    printf("table %12.0f lookups/s  walk %12.0f lookups/s  %ld wrong\n",
+           lookups / std::chrono::duration<double>(t1 - t0).count(),
+           lookups / std::chrono::duration<double>(t2 - t1).count(), failed);
+    return failed ? 1 : 0;
+}
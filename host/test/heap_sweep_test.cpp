@@ -0,0 +1,90 @@
+//
+//  heap_sweep_test.cpp
+//
+//  Builds and queues the frames of a full 27 step property sweep, option and
+//  follow-me commands, and fails if any of it touches the heap.  Allocations
+//  made while setting up SenvilleAURA and IRLink are not counted.
+//
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include "IRLink.hpp"
+#include "SenvilleAURA.hpp"
+
+#define SWEEP_STEPS 27
+
+static volatile bool counting = false;
+static volatile unsigned long allocs = 0;
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void *__wrap_malloc(size_t size) {
+    if(counting) allocs++;
+    return __real_malloc(size);
+}
+void *__wrap_calloc(size_t n, size_t size) {
+    if(counting) allocs++;
+    return __real_calloc(n, size);
+}
+void *__wrap_realloc(void *p, size_t size) {
+    if(counting) allocs++;
+    return __real_realloc(p, size);
+}
+}
+
+void *operator new(size_t size) {
+    if(counting) allocs++;
+    void *p = __real_malloc(size ? size : 1);
+    if(p == NULL) throw std::bad_alloc();
+    return p;
+}
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+int main() {
+    const Option options[] = {Direct, Swing, Led, Turbo, SelfClean, SilenceOn, SilenceOff, FP};
+    const FollowMeState fmStates[] = {FmStart, FmUpdateTemp, FmStop};
+    char cmd[64];
+    uint8_t msg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+    uint8_t state[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+    unsigned long failed = 0;
+
+    HostPlatform::reset();
+    SenvilleAURA senville;
+    IRLink link(senville.getIRConfig());
+    strcpy(cmd, "{Instr:1, IsOn:1, Mode:3, FanSpeed:0, SetTemp:22}");
+    if(!senville.fromJsonBuff(cmd, msg) || !senville.isValid(msg)) {
+        printf("could not set up state from %s\n", cmd);
+        return 1;
+    }
+    memcpy(state, senville.getMessage(), sizeof(state));
+
+    counting = true;
+    for(int step = 0; step < SWEEP_STEPS; step++) {
+        if(step % 3 == 2) {
+            sprintf(cmd, "{Instr:4, State:%d, MeasTemp:%d}", fmStates[(step / 3) % 3], 18 + step % 7);
+        } else {
+            sprintf(cmd, "{Instr:2, Opt:%d}", options[step % 8]);
+        }
+        if(!senville.fromJsonBuff(cmd, msg)) failed++;
+        if(!link.sendAsync(msg, SenvilleAURA::getInstructionType(msg) == Instruction::Command
+                                ? IRTxSupersede : IRTxOrdered)) failed++;
+        HostPlatform::runTimer();
+        link.loop_chkSendComplete();
+    }
+    counting = false;
+
+    if(memcmp(state, senville.getMessage(), sizeof(state)) != 0) {
+        printf("sweep changed the live state\n");
+        failed++;
+    }
+    printf("%d steps, %lu allocations, %lu failed\n", SWEEP_STEPS, allocs, failed);
+    return allocs == 0 && failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,330 @@
+//
+//  roundtrip_test.cpp
+//
+//  Every Senville command (power x mode x fan x set temperature x sleep),
+//  option and follow-me state, and NEC address x command, encoded by the
+//  brand's class, rendered by IRLink::send on the virtual Timer1 and fed
+//  back edge by edge through IRLink::handler and loop_chkMsgReceived.  Each
+//  frame must come back byte for byte, check out with the brand's isValid()
+//  and decode to the same fields.  Reports frames per second each way.
+//  A frame sent through IRLinkT while another is going out must be turned
+//  away and leave the one on air as it was, and a Senville frame too noisy
+//  to recover must leave the state decoded before it as it was, and so must
+//  the unit's echo of a Follow-Me or option frame.  Set temperatures sent as
+//  fractions or quoted numbers are taken truncated, other strings turned away,
+//  and a field out of range leaves the rest of its command to be set.
+//
+//  usage: roundtrip_test [corpus file]
+//      The corpus file gets a line per frame, the command then the frame
+//      bytes in hex, to compare against another build or a capture.
+//
+#include <chrono>
+#include <vector>
+#include "IRLink.hpp"
+#include "IRLinkT.hpp"
+#include "IRNECRemote.hpp"
+#include "SenvilleAURA.hpp"
+
+#define TEST_FRAME_GAP_US 40000
+#define TEST_FM_TEMP_LO 0
+#define TEST_FM_TEMP_HI 50
+#define TEST_NEC_ADDRS 3
+#define TEST_BUSY_AFTER_NS 5000000ULL  /* into the first frame, the second is sent */
+
+typedef struct FrameS {
+    char cmd[96];         // A full command with room for any int it holds
+    std::vector<uint8_t> bytes;
+    size_t firstGap;      // into the pulse stream
+} Frame;
+
+static std::vector<uint64_t> edgeNs;
+
+static void recordEdge(uint8_t pin, uint8_t level, uint64_t ns) {
+    if(pin == IR_PINX) edgeNs.push_back(ns);
+}
+
+// Append the pulses of msg as they leave the send pin, after a quiet gap
+static void render(IRLink &link, uint8_t *msg, std::vector<uint64_t> &gaps) {
+    edgeNs.clear();
+    HostPlatform::onPinChange(recordEdge);
+    link.send(msg, true);
+    HostPlatform::runTimer();
+    HostPlatform::onPinChange(nullptr);
+    gaps.push_back((uint64_t)TEST_FRAME_GAP_US * 1000);
+    for(size_t i = 1; i < edgeNs.size(); i++) gaps.push_back(edgeNs[i] - edgeNs[i-1]);
+}
+
+// Drive the stream into the receive pin, taking each frame as its last edge goes by
+static std::vector<std::vector<uint8_t> > replay(IRLink &link, std::vector<Frame> &frames,
+                                                  std::vector<uint64_t> &gaps, size_t frameBytes) {
+    std::vector<std::vector<uint8_t> > got(frames.size());
+    uint8_t level = HIGH, *mem;
+    HostPlatform::drivePin(IR_PINR, level);
+    link.listen();
+    for(size_t f = 0; f < frames.size(); f++) {
+        size_t end = f + 1 < frames.size() ? frames[f+1].firstGap : gaps.size();
+        for(size_t i = frames[f].firstGap; i < end; i++) {
+            HostPlatform::advanceNs(gaps[i]);
+            level = !level;
+            HostPlatform::drivePin(IR_PINR, level);
+        }
+        if((mem = link.loop_chkMsgReceived()) != NULL) got[f].assign(mem, mem + frameBytes);
+    }
+    link.listenStop();
+    return got;
+}
+
+static void report(const char *name, size_t frames, double encodeSecs, double decodeSecs, long mismatches) {
+    printf("%-9s %6zu frames  encode %9.0f frames/s  decode %9.0f frames/s  %ld mismatched\n",
+           name, frames, frames / encodeSecs, frames / decodeSecs, mismatches);
+}
+
+static void writeCorpus(FILE *out, std::vector<Frame> &frames) {
+    if(!out) return;
+    for(size_t f = 0; f < frames.size(); f++) {
+        fprintf(out, "%s ->", frames[f].cmd);
+        for(size_t i = 0; i < frames[f].bytes.size(); i++) fprintf(out, " %02X", frames[f].bytes[i]);
+        fprintf(out, "\n");
+    }
+}
+
+static long senvilleRoundTrip(FILE *corpus) {
+    const Option options[] = {Direct, Swing, Led, Turbo, SelfClean, SilenceOn, SilenceOff, FP};
+    const FollowMeState fmStates[] = {FmStart, FmUpdateTemp, FmStop};
+    const size_t frameBytes = MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS);
+    uint8_t msg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+    std::vector<Frame> frames;
+    std::vector<uint64_t> gaps;
+    long mismatches = 0;
+
+    SenvilleAURA tx, ref, rx;
+    IRLink link(tx.getIRConfig());
+
+    // Every command the field table allows, then options and follow-me from the last state
+    Frame f;
+    for(int on = 0; on <= 1; on++)
+    for(int mode = Cool; mode <= Fan; mode++)
+    for(int fan = FanAuto; fan <= High; fan++)
+    for(int temp = TEMP_LOWEST; temp <= SenvilleAURA::fields[KeySetTemp].max; temp++)
+    for(int sleep = 0; sleep <= 1; sleep++) {
+        snprintf(f.cmd, sizeof(f.cmd), "{Instr:1, IsOn:%d, Mode:%d, FanSpeed:%d, SetTemp:%d, IsSleepOn:%d}", on, mode, fan, temp, sleep);
+        frames.push_back(f);
+    }
+    for(size_t o = 0; o < sizeof(options) / sizeof(options[0]); o++) {
+        snprintf(f.cmd, sizeof(f.cmd), "{Instr:2, Opt:%d}", options[o]);
+        frames.push_back(f);
+    }
+    for(size_t s = 0; s < sizeof(fmStates) / sizeof(fmStates[0]); s++)
+    for(int temp = TEST_FM_TEMP_LO; temp <= TEST_FM_TEMP_HI; temp++) {
+        snprintf(f.cmd, sizeof(f.cmd), "{Instr:4, State:%d, MeasTemp:%d}", fmStates[s], temp);
+        frames.push_back(f);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < frames.size(); i++) {
+        if(!tx.fromJsonBuff(frames[i].cmd, msg)) {
+            printf("could not encode %s\n", frames[i].cmd);
+            mismatches++;
+        }
+        frames[i].bytes.assign(msg, msg + frameBytes);
+        frames[i].firstGap = gaps.size();
+        render(link, msg, gaps);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    std::vector<std::vector<uint8_t> > got = replay(link, frames, gaps, frameBytes);
+    auto t2 = std::chrono::steady_clock::now();
+
+    for(size_t i = 0; i < frames.size(); i++) {
+        const char *why = NULL;
+        if(got[i].size() != frameBytes) {
+            why = "not received";
+        } else if(got[i] != frames[i].bytes) {
+            why = "bytes differ";
+        } else if(!ref.isValid(frames[i].bytes.data()) || !rx.isValid(got[i].data())) {
+            why = "not valid";
+        } else {
+            for(uint8_t k = 0; k < SENVILLE_FIELD_CNT; k++) {
+                if(!(SenvilleAURA::fields[k].instrs & ref.getInstructionType())) continue;
+                if(ref.getField((SenvilleKey)k) != rx.getField((SenvilleKey)k)) why = SenvilleAURA::keyNames[k];
+            }
+        }
+        if(why) {
+            if(mismatches < 10) printf("%s: %s\n", frames[i].cmd, why);
+            mismatches++;
+        }
+    }
+    writeCorpus(corpus, frames);
+    report("Senville", frames.size(), std::chrono::duration<double>(t1 - t0).count(),
+           std::chrono::duration<double>(t2 - t1).count(), mismatches);
+    return mismatches;
+}
+
+static long necRoundTrip(FILE *corpus) {
+    const uint16_t addrs[TEST_NEC_ADDRS] = {0x6B86, 0xFF00, 0x0000};
+    const size_t frameBytes = MSGSIZE_BYTES(NEC_MESSAGE_SAMPLES,NEC_MESSAGE_BITS);
+    std::vector<Frame> frames;
+    std::vector<uint64_t> gaps;
+    long mismatches = 0;
+
+    IRNECRemote tx, rx;
+    IRLink link(tx.getIRConfig());
+    irMsg m;
+
+    Frame f;
+    for(int a = 0; a < TEST_NEC_ADDRS; a++)
+    for(int cmd = 0; cmd <= 0xFF; cmd++) {
+        snprintf(f.cmd, sizeof(f.cmd), "{Addr:%u , Cmd:%d }", addrs[a], cmd);
+        frames.push_back(f);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < frames.size(); i++) {
+        m.addr = addrs[i / 0x100];
+        m.cmd = i % 0x100;
+        tx.setMessage(m);
+        frames[i].bytes.assign(tx.rawMessage(), tx.rawMessage() + frameBytes);
+        frames[i].firstGap = gaps.size();
+        render(link, tx.rawMessage(), gaps);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    std::vector<std::vector<uint8_t> > got = replay(link, frames, gaps, frameBytes);
+    auto t2 = std::chrono::steady_clock::now();
+
+    for(size_t i = 0; i < frames.size(); i++) {
+        const char *why = NULL;
+        if(got[i].size() != frameBytes) {
+            why = "not received";
+        } else if(got[i] != frames[i].bytes) {
+            why = "bytes differ";
+        } else if(!rx.isValid(got[i].data())) {
+            why = "not valid";
+        } else if(rx.getMessage().addr != addrs[i / 0x100] || rx.getMessage().cmd != i % 0x100) {
+            why = "fields differ";
+        }
+        if(why) {
+            if(mismatches < 10) printf("%s: %s\n", frames[i].cmd, why);
+            mismatches++;
+        }
+    }
+    writeCorpus(corpus, frames);
+    report("NEC", frames.size(), std::chrono::duration<double>(t1 - t0).count(),
+           std::chrono::duration<double>(t2 - t1).count(), mismatches);
+    return mismatches;
+}
+
+// Edges between edges of the frame going out on IRLinkT, a second frame sent
+// part way through it when second is not NULL
+static std::vector<uint64_t> renderT(const uint8_t *msg, const uint8_t *second, long &mismatches) {
+    typedef IRLinkT<SenvilleAURAProtocol> SenvilleLink;
+    std::vector<uint64_t> gaps;
+    edgeNs.clear();
+    HostPlatform::onPinChange(recordEdge);
+    if(!SenvilleLink::send(msg, true)) mismatches++;
+    if(second) {
+        HostPlatform::runTimer(TEST_BUSY_AFTER_NS);
+        if(SenvilleLink::send(second, true)) {
+            printf("IRLinkT: second frame sent while the first was going out\n");
+            mismatches++;
+        }
+    }
+    HostPlatform::runTimer();
+    HostPlatform::onPinChange(nullptr);
+    for(size_t i = 1; i < edgeNs.size(); i++) gaps.push_back(edgeNs[i] - edgeNs[i-1]);
+    return gaps;
+}
+
+static long busyRoundTrip() {
+    SenvilleAURA a, b;
+    uint8_t msgA[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)], msgB[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+    long mismatches = 0;
+    a.fromJsonBuff("{IsOn:1, Instr:1, Mode:1, FanSpeed:0, SetTemp:22}", msgA);
+    b.fromJsonBuff("{IsOn:0, Instr:1, Mode:3, FanSpeed:3, SetTemp:30}", msgB);
+    std::vector<uint64_t> alone = renderT(msgA, NULL, mismatches);
+    std::vector<uint64_t> overlapped = renderT(msgA, msgB, mismatches);
+    if(alone.empty() || overlapped != alone) {
+        printf("IRLinkT: frame on air changed by a send while busy\n");
+        mismatches++;
+    }
+    return mismatches;
+}
+
+static long noisyRoundTrip() {
+    SenvilleAURA rx;
+    uint8_t msg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)], before[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+    int8_t soft[MESSAGE_SAMPLES * MESSAGE_BITS];
+    rx.fromJsonBuff("{IsOn:1, Instr:1, Mode:1, FanSpeed:0, SetTemp:22}", msg);
+    memcpy(before, rx.getMessage(), sizeof(before));
+    // A bit off in the state and no bit sure enough to chase
+    msg[MSG_CONST_STATE(0) + 2] ^= 0x10;
+    memset(soft, 0, sizeof(soft));
+    if(rx.isValidSoft(msg, soft) || memcmp(rx.getMessage(), before, sizeof(before)) != 0) {
+        printf("Senville: a frame too noisy to recover changed the state\n");
+        return 1;
+    }
+    return 0;
+}
+
+static long echoRoundTrip() {
+    SenvilleAURA rx;
+    uint8_t msg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)], before[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+    char buf[128];
+    BuffWriter out(buf, sizeof(buf));
+    rx.fromJsonBuff("{IsOn:1, Instr:1, Mode:3, FanSpeed:2, SetTemp:22}", msg);
+    rx.isValid(msg);
+    rx.toJsonDelta(out, true);
+    memcpy(before, rx.getMessage(), sizeof(before));
+    // What the unit sends back, its state masked and the run mode bits set
+    if(!rx.isValid(rx.followMeCmd(msg, FmStart, 21)) || !rx.isValid(SenvilleAURA::optionCmd(msg, Led))
+       || memcmp(rx.getMessage(), before, sizeof(before)) != 0 || rx.toJsonDelta(out) != 0) {
+        printf("Senville: a Follow-Me or option echo changed the command state\n");
+        return 1;
+    }
+    rx.fromJsonBuff("{Instr:1, SetTemp:23}", msg);
+    if(!rx.getPowerOn() || rx.getMode() != Heat || rx.getSetTemp() != 23) {
+        printf("Senville: a command after an echo was not built from the last command\n");
+        return 1;
+    }
+    return 0;
+}
+
+static long setTempRoundTrip() {
+    static const struct { const char *cmd; int setTemp; } cases[] = {
+        {"{Instr:1, IsOn:1, Mode:0, SetTemp:24.5}", 24},
+        {"{Instr:1, SetTemp:2.35e1}", 23},
+        {"{Instr:1, SetTemp:\"21\"}", 21},
+        {"{\"Instr\":1, \"SetTemp\":\"25.9\"}", 25},
+        {"{Instr:1, SetTemp:\"warm\"}", -1},
+        {"{Instr:1, SetTemp:24.}", -1},
+        {"{Instr:1, IsOn:2, SetTemp:22}", 22},
+        {"{Instr:1, SetTemp:16}", 22}
+    };
+    SenvilleAURA rx;
+    uint8_t msg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+    long mismatches = 0;
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        bool ok = rx.fromJsonBuff(cases[i].cmd, msg);
+        if(ok != (cases[i].setTemp >= 0) || (ok && rx.getSetTemp() != cases[i].setTemp)) {
+            printf("Senville: %s %s, SetTemp %d\n", cases[i].cmd, ok ? "taken" : "turned away", rx.getSetTemp());
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc, char **argv) {
+    FILE *corpus = NULL;
+    if(argc > 1 && (corpus = fopen(argv[1], "w")) == NULL) {
+        printf("could not write %s\n", argv[1]);
+        return 1;
+    }
+
+    HostPlatform::reset();
+    long mismatches = senvilleRoundTrip(corpus);
+    mismatches += necRoundTrip(corpus);
+    mismatches += busyRoundTrip();
+    mismatches += noisyRoundTrip();
+    mismatches += echoRoundTrip();
+    mismatches += setTempRoundTrip();
+    if(corpus) fclose(corpus);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,246 @@
+//
+//  sweep_test.cpp
+//
+//  SenvilleSweep against a model of the unit's display: the entry sequence
+//  puts it in diagnostic mode on T1, Option::Led and Option::Direct step
+//  forward and back with the label and value blinking, and it drops back to
+//  the set temperature after a few seconds without a command.  Commands land
+//  an airtime after they are sent and a few percent are lost, a few percent
+//  of frames are garbled, and one sweep has the unit leave diagnostic mode
+//  half way through.  Frames go through SenvilleDispFilter as scan() feeds
+//  them, and the sweep is polled on the scan interval.  Each sweep must
+//  capture the properties due in it with their values and nothing else,
+//  each within the latency budget.  Runs every property, then hot and cold
+//  ones on a unit that does not wrap from the last property round to the
+//  first and on one that does.  Reports per property and whole sweep
+//  latency, and the commands sent, against the fixed waits and single steps
+//  through every property the sweep used to make.
+//
+//  usage: sweep_test [lost command percent] [sweeps]
+//
+
+#include "SenvilleSweep.hpp"
+#include "DispGlyphs.hpp"
+
+#define TEST_LOST_PCT 5
+#define TEST_GLITCH_PCT 3
+#define TEST_SWEEPS 20
+#define TEST_DIAG_TIMEOUT_MS 5000 // unit leaves diagnostic mode after this without a command
+#define TEST_FIXED_TICK_MS 200    // DISPLAY_IR_SCAN_INTERVAL, the old sweep sent a Led on one
+#define TEST_FIXED_STEP_MS 800    //   and took the value DISPLAY_IR_SCAN_INTERVAL * 3 later
+#define TEST_SWEEP_LIMIT_MS 120000UL
+#define TEST_STEP_BUDGET_MS 2000  // worst property with no command lost, two blinks and a
+                                  //   command gap for each property stepped over
+#define TEST_EXIT_SWEEP 3         // the unit leaves diagnostic mode in this one,
+#define TEST_EXIT_AT 5            //   on reaching this property, TP
+#define TEST_HOT_COLD "T1 T2 T3 T4 TP FT Fr IF 0F Td / Tb TH LA CT ST Uo"
+
+// One value for each property, some of which read as labels too
+static const char *values[DISP_PROPERTIES] = {
+    "24", "10", "32", "-5", "-9", "69", "00", "27", "26", "40", "55", "96", "FF",
+    "07", "b2", "A0", "12", "b0", "33", "E4", "d0", "c1", "09", "17", "AA", "b2", "5E"
+};
+static const char labels[] = SENVILLEAURA_PROPERTY_LABELS;
+static uint8_t labelCodes[DISP_PROPERTIES][DISPLAY_BYTE_SIZE], valueCodes[DISP_PROPERTIES][DISPLAY_BYTE_SIZE];
+
+typedef struct UnitS {
+    bool wrap;                        // Led on the last property shows the first, Direct back
+    bool diag;
+    int8_t index;
+    unsigned long lastCmdMs, blinkMs;
+    Option history[SWEEP_ENTRY_COMMANDS];
+    Option pending;
+    unsigned long pendingMs;          // when it lands, 0 for none
+    uint32_t rnd;
+} Unit;
+
+typedef struct ScenarioS {
+    const char *name;
+    const char *spec;                 // setProperties(), empty for all of them
+    bool unitWraps, sweepWraps;
+} Scenario;
+
+static uint32_t next(uint32_t &rnd) {
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return rnd;
+}
+
+static void apply(Unit &u, Option option, unsigned long ms) {
+    u.lastCmdMs = ms;
+    memmove(u.history, u.history + 1, sizeof(u.history) - sizeof(u.history[0]));
+    u.history[SWEEP_ENTRY_COMMANDS - 1] = option;
+    if(u.diag) {
+        int to = u.index + (option == Option::Led ? 1 : -1);
+        if(u.wrap) u.index = (to + DISP_PROPERTIES) % DISP_PROPERTIES;
+        else if(to >= 0 && to < DISP_PROPERTIES) u.index = to;
+        u.blinkMs = ms;
+        return;
+    }
+    for(int i = 0; i < SWEEP_ENTRY_COMMANDS; i++) {
+        if(u.history[i] != (i < SWEEP_ENTRY_COMMANDS / 2 ? Option::Led : Option::Direct)) return;
+    }
+    u.diag = true;
+    u.index = 0;
+    u.blinkMs = ms;
+}
+
+static void show(Unit &u, unsigned long ms, uint8_t *frame) {
+    static const uint8_t setTemp[DISPLAY_BYTE_SIZE] = {0x24, 0x24, 0x80};
+    if(u.diag && ms - u.lastCmdMs >= TEST_DIAG_TIMEOUT_MS) u.diag = false;
+    if(!u.diag) {
+        memcpy(frame, setTemp, DISPLAY_BYTE_SIZE);
+    } else if(((ms - u.blinkMs) / TEST_SHOW_MS) % 2 == 0) {
+        memcpy(frame, labelCodes[u.index], DISPLAY_BYTE_SIZE);
+    } else {
+        memcpy(frame, valueCodes[u.index], DISPLAY_BYTE_SIZE);
+    }
+}
+
+// Sweeps of one scenario, the number of failures
+static unsigned long run(const Scenario &sc, int lostPct, int sweeps) {
+    Properties props[DISP_PROPERTIES];
+    SenvilleDispFilter filter(labels, sizeof(labels));
+    SenvilleSweep sweep(&filter, props);
+    if(!sweep.setProperties(sc.spec, strlen(sc.spec))) {
+        printf("%s: cannot set \"%s\"\n", sc.name, sc.spec);
+        return 1;
+    }
+    sweep.setWrap(sc.sweepWraps);
+    Unit u;
+    memset(&u, 0, sizeof(u));
+    u.wrap = sc.unitWraps;
+    u.rnd = 2024;
+    uint8_t msg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+    uint8_t last[DISPLAY_BYTE_SIZE] = {0xFE, 0xFE, 0x80};
+    unsigned long ms = 0, nextPoll = SWEEP_SCAN_INTERVAL, wrong = 0, sent = 0, airtimeMs = 0;
+    unsigned long sweepSum = 0, sweepMax = 0, stepSum = 0, steps = 0, stepMax = 0;
+    unsigned long stepCleanMax = 0, read = 0;
+
+    for(int s = 0; s < sweeps; s++) {
+        bool exited = false;
+        uint8_t settled = DispFilterNone, ev = SweepNone;
+        bool clean = true;                // no command lost toward this property
+        int8_t from = SWEEP_ENTRY_AT;     // where the last one was read
+        uint32_t due = s % SWEEP_COLD_EVERY == 0 ? sweep.getWanted() : sweep.getHot(), got = 0;
+        if(!sweep.start(ms)) {
+            printf("%s: sweep %d did not start\n", sc.name, s);
+            wrong++;
+            continue;
+        }
+        for(unsigned long end = ms + TEST_SWEEP_LIMIT_MS; ms < end && !(ev & SweepDone); ms += DISP_FRAME_MS) {
+            if(u.pendingMs && ms >= u.pendingMs) {
+                apply(u, u.pending, u.pendingMs);
+                u.pendingMs = 0;
+            }
+            if(s == TEST_EXIT_SWEEP && !exited && u.diag && u.index == TEST_EXIT_AT) {
+                u.diag = false;
+                exited = true;
+            }
+            uint8_t frame[DISPLAY_BYTE_SIZE];
+            show(u, ms, frame);
+            uint32_t r = next(u.rnd);
+            if((int)(r % 100) < TEST_GLITCH_PCT) frame[(r >> 8) & 0x01] ^= 0x02 << ((r >> 12) % 7);
+            if(memcmp(frame, last, DISPLAY_BYTE_SIZE) != 0) {
+                DispFrame d;
+                memcpy(d.bytes, frame, DISPLAY_BYTE_SIZE);
+                d.ms = ms;
+                memcpy(last, frame, DISPLAY_BYTE_SIZE);
+                settled |= sweep.update(d);
+            }
+            if(ms < nextPoll) continue;
+
+            // scan()
+            nextPoll += SWEEP_SCAN_INTERVAL;
+            settled |= filter.poll(ms);
+            ev = sweep.poll(msg, ms, settled);
+            settled = DispFilterNone;
+            if(ev & SweepCaptured) {
+                int8_t i = sweep.getCapturedIndex();
+                if(i < 0 || filter.indexOf(props[i].key) != i || strcmp(sweep.getValue(), values[i]) != 0
+                   || !((due >> i) & 0x01) || ((got >> i) & 0x01)) {
+                    printf("%s: sweep %d captured %s %s\n", sc.name, s, i < 0 ? "" : props[i].key, sweep.getValue());
+                    wrong++;
+                }
+                if(i < 0) i = from;
+                got |= 1UL << i;
+                // Stepped over on the way, the shorter way round on a unit that wraps
+                int over = abs(i - from);
+                if(sc.sweepWraps && over > DISP_PROPERTIES / 2) over = DISP_PROPERTIES - over;
+                over = over > 1 ? over - 1 : 0;
+                unsigned long stepMs = sweep.getStepMs() - over * SWEEP_CMD_GAP_MS;
+                from = i;
+                stepSum += sweep.getStepMs();
+                steps++;
+                if(sweep.getStepMs() > stepMax) stepMax = sweep.getStepMs();
+                if(clean && s != TEST_EXIT_SWEEP && stepMs > stepCleanMax) stepCleanMax = stepMs;
+                clean = true;
+            }
+            if(ev & SweepSend) {
+                Option option = (Option)msg[MSG_CMD_OPT(0)];
+                sent++;
+                airtimeMs += SenvilleAURA::frameAirtimeUs(msg) / 1000;
+                if((int)(next(u.rnd) % 100) < lostPct) {
+                    clean = false;
+                } else {
+                    u.pending = option;
+                    u.pendingMs = ms + SenvilleAURA::frameAirtimeUs(msg) / 1000;
+                }
+            }
+        }
+        if(sweep.isRunning() || got != due || sweep.getCaptured() != sweep.getPlanned() || sweep.getMissed()) {
+            printf("%s: sweep %d: %u of %u captured, %u missed%s\n", sc.name, s, sweep.getCaptured(),
+                   sweep.getPlanned(), sweep.getMissed(), sweep.isRunning() ? ", still running" : "");
+            wrong++;
+        }
+        read += sweep.getCaptured();
+        sweepSum += sweep.getSweepMs();
+        if(sweep.getSweepMs() > sweepMax) sweepMax = sweep.getSweepMs();
+        // Let the unit drop back to normal mode before the next one
+        ms += TEST_DIAG_TIMEOUT_MS + TEST_SHOW_MS;
+        nextPoll = ms;
+    }
+
+    printf("%s\n", sc.name);
+    printf("  property   mean %4lu ms  worst %5lu ms  worst with none lost %4lu ms less steps over  budget %d ms\n",
+           steps ? stepSum / steps : 0, stepMax, stepCleanMax, TEST_STEP_BUDGET_MS);
+    printf("  sweep      mean %5lu ms  worst %5lu ms  %.1f properties\n",
+           sweeps ? sweepSum / sweeps : 0, sweepMax, sweeps ? (double)read / sweeps : 0.0);
+    printf("  %.1f commands, %lu ms airtime a sweep; %lu retries, %lu re-entries, %lu wrong\n",
+           sweeps ? (double)sent / sweeps : 0.0, sweeps ? airtimeMs / sweeps : 0,
+           sweep.getRetries(), sweep.getReentries(), wrong);
+    if(stepCleanMax > TEST_STEP_BUDGET_MS) wrong++;
+    if(sweep.getReentries() == 0) wrong++;
+    return wrong;
+}
+
+int main(int argc, char **argv) {
+    int lostPct = argc > 1 ? atoi(argv[1]) : TEST_LOST_PCT;
+    int sweeps = argc > 2 ? atoi(argv[2]) : TEST_SWEEPS;
+    const char *l = labels;
+    for(int i = 0; i < DISP_PROPERTIES; i++, l += strlen(l) + 1) {
+        if(!encode(l, labelCodes[i]) || !encode(values[i], valueCodes[i])) {
+            printf("cannot show %s %s\n", l, values[i]);
+            return 1;
+        }
+    }
+
+    uint8_t msg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+    SenvilleAURA::optionCmd(msg, Option::Led);
+    unsigned long fixedMs = SWEEP_ENTRY_COMMANDS * TEST_FIXED_TICK_MS + DISP_PROPERTIES * TEST_FIXED_STEP_MS;
+    unsigned long fixedCmds = SWEEP_ENTRY_COMMANDS + DISP_PROPERTIES - 1;
+    printf("fixed waits, one step at a time: sweep %lu ms, %lu commands, %lu ms airtime\n",
+           fixedMs, fixedCmds, fixedCmds * (SenvilleAURA::frameAirtimeUs(msg) / 1000));
+
+    const Scenario scenarios[] = {
+        {"all properties", "", true, false},
+        {"hot and cold, unit does not wrap", TEST_HOT_COLD, false, false},
+        {"hot and cold, unit wraps", TEST_HOT_COLD, true, true}
+    };
+    unsigned long wrong = 0;
+    for(size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        wrong += run(scenarios[i], lostPct, sweeps);
+    }
+    return wrong ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+//
+//  crc_batch.cpp
+//
+//  Checks captured Senville frames with SenvilleAURA::checkFrame() and counts
+//  the CRC anomalies, to mine long capture logs.  Text input is the
+//  "Received message : 0xA1 82 48 FF FF 2C 5E 7D B7 0 0 D3" lines the
+//  firmware prints with DEBUG; lines without a full frame are skipped.  With
+//  -b the input is raw frames back to back, MSGSIZE_BYTES() each.
+//
+//  usage: crc_batch [-b] [-q] [file]        check a capture, stdin if no file
+//         crc_batch -g frames [bad per 1000] write a raw capture to stdout
+//
+#include <chrono>
+#include "SenvilleAURA.hpp"
+
+#define FRAME_BYTES MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)
+#define READ_BYTES (1 << 20)
+#define SHOW_ANOMALIES 20
+
+static unsigned long counts[8];
+static unsigned long frames = 0, shown = 0;
+static bool quiet = false;
+
+static void check(const uint8_t *msg, unsigned long where) {
+    uint8_t result = SenvilleAURA::checkFrame(msg);
+    counts[result]++;
+    frames++;
+    if(result == FrameOk || quiet || shown >= SHOW_ANOMALIES) return;
+    shown++;
+    printf("frame %lu:%s%s%s ", where,
+           result & FrameCRC0 ? " crc0" : "", result & FrameCRC1 ? " crc1" : "",
+           result & FrameSamplesDiffer ? " differ" : "");
+    for(uint8_t i = 0; i < FRAME_BYTES; i++) printf("%02X", msg[i]);
+    printf("\n");
+}
+
+static int hexVal(char c) {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// One line of text, the frame follows the last "0x"
+static void checkLine(const char *p, const char *end, unsigned long line) {
+    const char *start = NULL;
+    uint8_t msg[FRAME_BYTES];
+    uint8_t cnt = 0;
+    int v, d;
+    for(const char *q = p; q + 1 < end; q++) {
+        if(q[0] == '0' && q[1] == 'x') start = q + 2;
+    }
+    if(start == NULL) return;
+    for(p = start; p < end && cnt < FRAME_BYTES; ) {
+        while(p < end && *p == ' ') p++;
+        if(p >= end || (v = hexVal(*p)) < 0) break;
+        p++;
+        if(p < end && (d = hexVal(*p)) >= 0) {
+            v = v * 16 + d;
+            p++;
+        }
+        msg[cnt++] = v;
+    }
+    if(cnt == FRAME_BYTES) check(msg, line);
+}
+
+static int generate(unsigned long n, unsigned long badPerK) {
+    uint8_t msg[FRAME_BYTES];
+    srand(1);
+    for(unsigned long f = 0; f < n; f++) {
+        for(uint8_t i = 0; i < MSG_CRC(0); i++) msg[i] = rand();
+        msg[0] = 0xA0 | (msg[0] & 0x0F);
+        msg[MSG_CRC(0)] = SenvilleAURA::frameCRC(msg);
+        for(uint8_t i = 0; i < MSG_CONST_STATE(1); i++) msg[MSG_CONST_STATE(1) + i] = ~msg[i];
+        if((unsigned long)(rand() % 1000) < badPerK) msg[rand() % FRAME_BYTES] ^= 1 << (rand() % 8);
+        fwrite(msg, 1, FRAME_BYTES, stdout);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    bool raw = false;
+    const char *path = NULL;
+    for(int a = 1; a < argc; a++) {
+        if(strcmp(argv[a], "-g") == 0 && a + 1 < argc) {
+            return generate(atol(argv[a + 1]), a + 2 < argc ? atol(argv[a + 2]) : 10);
+        }
+        if(strcmp(argv[a], "-b") == 0) raw = true;
+        else if(strcmp(argv[a], "-q") == 0) quiet = true;
+        else path = argv[a];
+    }
+    FILE *in = path ? fopen(path, "rb") : stdin;
+    if(in == NULL) {
+        printf("could not open %s\n", path);
+        return 1;
+    }
+
+    static char buf[READ_BYTES + FRAME_BYTES];
+    size_t have = 0, got;
+    unsigned long line = 1;
+    double checkNs = 0;
+    while((got = fread(buf + have, 1, READ_BYTES - have, in)) > 0) {
+        have += got;
+        size_t used = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        if(raw) {
+            for(; used + FRAME_BYTES <= have; used += FRAME_BYTES) {
+                check((const uint8_t *)&buf[used], frames);
+            }
+        } else {
+            for(char *nl; (nl = (char *)memchr(&buf[used], '\n', have - used)) != NULL; used = nl + 1 - buf) {
+                checkLine(&buf[used], nl, line++);
+            }
+            if(used == 0 && have == READ_BYTES) used = have; // Over long line
+        }
+        checkNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        memmove(buf, &buf[used], have - used);
+        have -= used;
+    }
+    if(!raw && have) checkLine(buf, buf + have, line);
+    if(path) fclose(in);
+
+    printf("frames %lu, ok %lu, crc0 %lu, crc1 %lu, differ %lu",
+           frames, counts[FrameOk],
+           counts[1] + counts[3] + counts[5] + counts[7], counts[2] + counts[3] + counts[6] + counts[7],
+           counts[4] + counts[5] + counts[6] + counts[7]);
+    if(checkNs > 0) printf(", %.1f Mframes/s", frames / checkNs * 1e3);
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,216 @@
+//
+//  disp_replay.cpp
+//
+//  Replays the CN201 display traces in testdata through the bit-banged
+//  display capture.  Each trace is one period of 2048 samples at the two
+//  levels 2048 (low) and 4095 (high), as played by the signal generator in
+//  setup_display_signals_mhs.sh: display_clock.txt is a byte's CLK burst,
+//  display_data_*.txt the DATA line under it, display_led_inter.txt the
+//  LED_INTER select and display_clk_inter.txt the fastest CLK burst.  The
+//  traces become edges on the virtual pins, so SenvilleAURADisp::handler
+//  and handleSynch run from their interrupts, and every frame that comes
+//  out of the display ring is checked against the bytes read straight off
+//  the traces.  Reports the least DATA setup and hold time about a CLK
+//  rising edge, the interrupt time per CLK edge against the closest edges
+//  seen, and frames decoded per second.
+//
+//  usage: disp_replay [testdata dir] [passes]
+//
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include "SenvilleAURADisp.hpp"
+
+#define REPLAY_SAMPLES 2048
+#define REPLAY_CLK_HZ 245.47       /* s2f24547, a byte burst every 4.07 ms */
+#define REPLAY_LEVEL_HI 3072       /* between the 2048 and 4095 levels */
+#define REPLAY_PASSES 200
+#define REPLAY_ISR_BUDGET_PCT 10   /* of the closest CLK rising edges */
+#define REPLAY_MASK 0xFE           /* DISPLAY_MASK, the LSB is not kept */
+
+typedef struct TraceS {
+    std::string name;
+    std::vector<uint8_t> level;
+    int expect;                    // byte its name says, -1 if it does not say
+    uint8_t decoded;               // sampled at each CLK rising edge, first bit the LSB
+} Trace;
+
+typedef struct EdgeS {
+    uint64_t ns;
+    uint8_t pin, level;
+} Edge;
+
+static bool load(const std::string &dir, const std::string &name, Trace &t) {
+    FILE *in = fopen((dir + "/" + name).c_str(), "r");
+    if(!in) {
+        printf("could not read %s/%s\n", dir.c_str(), name.c_str());
+        return false;
+    }
+    int v;
+    t.name = name;
+    t.level.clear();
+    while(t.level.size() < REPLAY_SAMPLES && fscanf(in, "%d", &v) == 1) t.level.push_back(v >= REPLAY_LEVEL_HI);
+    fclose(in);
+    if(t.level.size() != REPLAY_SAMPLES) {
+        printf("%s: %zu samples, wanted %d\n", name.c_str(), t.level.size(), REPLAY_SAMPLES);
+        return false;
+    }
+    return true;
+}
+
+// Samples where the trace goes high, or low
+static std::vector<int> edgesOf(const Trace &t, bool rising) {
+    std::vector<int> at;
+    for(int i = 1; i < REPLAY_SAMPLES; i++) {
+        if(t.level[i] != t.level[i-1] && t.level[i] == rising) at.push_back(i);
+    }
+    return at;
+}
+
+// Edges of a trace started at ns, the DATA ones ordered ahead of a CLK edge on the same sample.
+// Times are kept doubled to make room for the order.  A trace that ends on another
+// level than it starts, LED_INTER, has an edge at the start of each period.
+static void addEdges(std::vector<Edge> &out, const Trace &t, uint8_t pin, uint64_t ns, double sampleNs) {
+    for(int i = 0; i < REPLAY_SAMPLES; i++) {
+        if(t.level[i] == t.level[i ? i-1 : REPLAY_SAMPLES-1]) continue;
+        Edge e = {(ns + (uint64_t)(i * sampleNs)) * 2 + (pin == CLK_HSPI ? 1 : 0), pin, t.level[i]};
+        out.push_back(e);
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string dir = argc > 1 ? argv[1] : "testdata";
+    long passes = argc > 2 ? atol(argv[2]) : REPLAY_PASSES;
+    const char *dataNames[] = {
+        "display_data_flat.txt", "display_data_bit1.txt", "display_data_bit2.txt", "display_data_bit3.txt",
+        "display_data_bit4.txt", "display_data_bit5.txt", "display_data_bit6.txt", "display_data_bit7.txt",
+        "display_data_bit8.txt", "display_data_01011011.txt"
+    };
+    const size_t dataCnt = sizeof(dataNames) / sizeof(dataNames[0]);
+    Trace clk, clkFast, led, data[dataCnt];
+    int failed = 0;
+
+    if(!load(dir, "display_clock.txt", clk) || !load(dir, "display_clk_inter.txt", clkFast)
+       || !load(dir, "display_led_inter.txt", led)) return 1;
+    for(size_t d = 0; d < dataCnt; d++) {
+        if(!load(dir, dataNames[d], data[d])) return 1;
+        int bit;
+        data[d].expect = -1;
+        if(sscanf(dataNames[d], "display_data_bit%d", &bit) == 1) data[d].expect = 1 << (bit - 1);
+        if(data[d].name == "display_data_flat.txt") data[d].expect = 0x00;
+    }
+
+    // A sample is a 2048th of the CLK period, LED_INTER runs at a third of its rate
+    const double periodNs = 1e9 / REPLAY_CLK_HZ;
+    const double sampleNs = periodNs / REPLAY_SAMPLES;
+    std::vector<int> clkRise = edgesOf(clk, true);
+    std::vector<int> fastRise = edgesOf(clkFast, true);
+    std::vector<int> ledRise = edgesOf(led, true);
+    if(clkRise.size() != 8 || ledRise.size() != 1) {
+        printf("%zu CLK rising edges and %zu LED_INTER, wanted 8 and 1\n", clkRise.size(), ledRise.size());
+        return 1;
+    }
+
+    // Setup and hold of DATA about each CLK rising edge, and the byte read off the traces
+    int setup = REPLAY_SAMPLES, hold = REPLAY_SAMPLES;
+    for(size_t d = 0; d < dataCnt; d++) {
+        data[d].decoded = 0;
+        for(size_t b = 0; b < clkRise.size(); b++) {
+            int c = clkRise[b], before = -1, after = REPLAY_SAMPLES;
+            for(int i = 1; i < REPLAY_SAMPLES; i++) {
+                if(data[d].level[i] == data[d].level[i-1]) continue;
+                if(i <= c) before = i;
+                else if(after == REPLAY_SAMPLES) after = i;
+            }
+            if(before >= 0 && c - before < setup) setup = c - before;
+            if(after - c < hold) hold = after - c;
+            if(data[d].level[c]) data[d].decoded |= 1 << b;
+        }
+        if(data[d].expect >= 0 && data[d].decoded != data[d].expect) {
+            printf("%s reads 0x%02X off the trace, its name says 0x%02X\n", dataNames[d], data[d].decoded, data[d].expect);
+            failed++;
+        }
+    }
+    int fastest = REPLAY_SAMPLES;
+    for(size_t i = 1; i < fastRise.size(); i++) {
+        if(fastRise[i] - fastRise[i-1] < fastest) fastest = fastRise[i] - fastRise[i-1];
+    }
+    printf("DATA setup %.1f us, hold %.1f us about CLK rising; closest CLK rising edges %.1f us\n",
+           setup * sampleNs / 1000, hold * sampleNs / 1000, fastest * sampleNs / 1000);
+    if(setup <= 0 || hold <= 0) {
+        printf("DATA changes on a CLK rising edge\n");
+        failed++;
+    }
+
+    // LED_INTER then a byte burst each CLK period, every trace in each byte of a frame
+    // over a pass.  LED_INTER rises 3.8 ms into the frame, ahead of its first burst.
+    const size_t frames = dataCnt;
+    std::vector<Edge> edges;
+    uint64_t frameNs = (uint64_t)(3 * periodNs);
+    for(size_t f = 0; f < frames; f++) {
+        uint64_t start = f * frameNs;
+        addEdges(edges, led, LED_INTER, start, 3 * sampleNs);
+        for(int k = 1; k <= DISPLAY_BYTE_SIZE; k++) {
+            uint64_t burst = start + (uint64_t)(k * periodNs);
+            addEdges(edges, clk, CLK_HSPI, burst, sampleNs);
+            addEdges(edges, data[(f * DISPLAY_BYTE_SIZE + k - 1) % dataCnt], DATA_MOSI, burst, sampleNs);
+        }
+    }
+    for(size_t i = 1; i < edges.size(); i++) {
+        for(size_t j = i; j > 0 && edges[j].ns < edges[j-1].ns; j--) std::swap(edges[j], edges[j-1]);
+    }
+
+    HostPlatform::reset();
+    HostPlatform::timeIsrs(true);
+    HostPlatform::drivePin(LED_INTER, HIGH);
+    SenvilleAURADisp disp(DispBitBang);
+    DispFrame got;
+    uint8_t want[DISPLAY_BYTE_SIZE], last[DISPLAY_BYTE_SIZE] = {REPLAY_MASK, REPLAY_MASK, REPLAY_MASK};
+    unsigned long decoded = 0, wrong = 0, clkEdges = 0;
+    uint64_t t0 = 0;
+    size_t e = 0;
+    auto w0 = std::chrono::steady_clock::now();
+    for(long p = 0; p < passes; p++, t0 += frames * frameNs) {
+        e = 0;
+        for(size_t f = 0; f < frames; f++) {
+            uint64_t end = t0 + (f + 1) * frameNs + (uint64_t)periodNs;
+            for(; e < edges.size() && t0 + edges[e].ns / 2 < end; e++) {
+                HostPlatform::advanceNs(t0 + edges[e].ns / 2 - HostPlatform::nowNs());
+                HostPlatform::drivePin(edges[e].pin, edges[e].level);
+                if(edges[e].pin == CLK_HSPI && edges[e].level) clkEdges++;
+            }
+            for(int k = 0; k < DISPLAY_BYTE_SIZE; k++) {
+                want[k] = data[(f * DISPLAY_BYTE_SIZE + k) % dataCnt].decoded & REPLAY_MASK;
+            }
+            // The ring only keeps a frame that differs from the one before
+            bool expected = memcmp(want, last, DISPLAY_BYTE_SIZE) != 0;
+            memcpy(last, want, DISPLAY_BYTE_SIZE);
+            if(!disp.nextFrame(got)) {
+                if(expected) wrong++;
+                continue;
+            }
+            decoded++;
+            if(!expected || memcmp(got.bytes, want, DISPLAY_BYTE_SIZE) != 0) {
+                if(wrong < 5) printf("frame %zu: %02X %02X %02X, wanted %02X %02X %02X\n", f,
+                                     got.bytes[0], got.bytes[1], got.bytes[2], want[0], want[1], want[2]);
+                wrong++;
+            }
+            while(disp.nextFrame(got)) wrong++;
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - w0).count();
+    disp.listenStop();
+
+    double isrNs = (double)HostPlatform::isrCpuNs() / HostPlatform::isrCount();
+    double budgetNs = fastest * sampleNs * REPLAY_ISR_BUDGET_PCT / 100;
+    printf("%lu frames decoded, %lu wrong, %.0f frames/s, %.0f CLK edges/s\n",
+           decoded, wrong, decoded / secs, clkEdges / secs);
+    printf("ISR %.0f ns per interrupt, budget %.0f ns\n", isrNs, budgetNs);
+    if(wrong || decoded == 0) failed++;
+    if(isrNs > budgetNs) {
+        printf("ISR over budget\n");
+        failed++;
+    }
+    return failed ? 1 : 0;
+}
@@ -72,7 +72,7 @@ void loop() {
   if(mem != NULL) {
 #ifdef DEBUG   
     Serial.print("Received message : 0x");
-    for(int i=0; i<MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) ; i++) {
+    for(int i=0; i<MSGSIZE_BYTES(NEC_MESSAGE_SAMPLES,NEC_MESSAGE_BITS) ; i++) {
       Serial.print(mem[i], HEX); Serial.print(" "); 
     }
     Serial.println();
@@ -80,7 +80,7 @@ void loop() {
     if(rmt->isValid(mem)) {
 #ifdef DEBUG
       Serial.print("Validated message : ");
-      rmt->toBuff(outputBuff);
+      rmt->toBuff(outputBuff, sizeof(outputBuff));
       Serial.println(outputBuff);
 #endif
       // Translate
@@ -91,7 +91,7 @@ void loop() {
 
       Serial.print("Sending message : 0x");
       mem = rmt->rawMessage();
-      for(int i=0; i<MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) ; i++) {
+      for(int i=0; i<MSGSIZE_BYTES(NEC_MESSAGE_SAMPLES,NEC_MESSAGE_BITS) ; i++) {
         Serial.print(mem[i], HEX); Serial.print(" "); 
       }
       Serial.println();
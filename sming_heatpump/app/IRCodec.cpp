@@ -0,0 +1 @@
+../../src/IRCodec.cpp
\ No newline at end of file
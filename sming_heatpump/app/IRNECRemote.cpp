@@ -0,0 +1 @@
+../../src/IRNECRemote.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/SenvilleDispFilter.cpp
\ No newline at end of file
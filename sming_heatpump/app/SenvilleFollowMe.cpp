@@ -0,0 +1 @@
+../../src/SenvilleFollowMe.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/SenvilleSweep.cpp
\ No newline at end of file
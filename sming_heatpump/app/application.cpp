@@ -4,8 +4,13 @@
 #include <Network/RbootHttpUpdater.h>
 
 #include "SenvilleAURADisp.hpp"
+#include "SenvilleDispFilter.hpp"
 #include "IRLink.hpp"
+#include "IRCodec.hpp"
+#include "IRNECRemote.hpp"
 #include "SenvilleAURA.hpp"
+#include "SenvilleFollowMe.hpp"
+#include "SenvilleSweep.hpp"
 #define DEBUG
 
 // Property is two paths separated by a space to the URL to download rom and spiff bin files from
@@ -33,18 +38,23 @@
 #define DEFAULT_CONFIG "{IsOn:0 , Instr:1 , Mode:0 , FanSpeed:0 , IsSleepOn:0 , SetTemp:22}"
 #define CONFIG_FILENAME "control.config"
 #define OTA_FILENAME "ota.txt"
+#define SWEEP_FILENAME "sweep.config"
+#define SWEEP_DEFAULT "T1 T2 T3 T4 TP FT Fr IF 0F / Tb TH LA CT ST" /* reserved ones left out */
 #define MQTT_DEVICE_NAME "esp8266_01"
 #define MQTT_CONTROL_PATH "hvac/heatpump/control"
 #define MQTT_STATUS_PATH "hvac/heatpump/status"
 #define MQTT_PROPERTIES_PATH "hvac/heatpump/properties"
 #define MQTT_DISPLAY_PATH "hvac/heatpump/display"
 #define MQTT_DEBUG_PATH "hvac/heatpump/debug"
+#define MQTT_IRSTATS_PATH "hvac/heatpump/irstats" /* any message publishes the pulse histogram to debug, "reset" also clears it */
+#define MQTT_FOLLOWME_PATH "hvac/heatpump/followme" /* {MeasTemp:21} starts or updates Follow-Me, {State:63} stops it */
+#define MQTT_SWEEP_PATH "hvac/heatpump/sweep" /* properties to read, hot labels then cold after a '/', empty for all */
 
 typedef enum UpdatePropertyE {
-  None = 0x00, Display = 0x01, UpdateControl = 0x02, All = 0xFF
+  None = 0x00, Display = 0x01, UpdateControl = 0x02, Snapshot = 0x04, All = 0xFF
 } UpdateProperty;
 
-const int DEFAULT_UPDATE_INTERVAL = 180; // 3 min
+const int DEFAULT_UPDATE_INTERVAL = 180; // 3 min, full snapshot; only changed fields in between
 #define PROPERTY_SCAN_AT_TIME 60 /* seconds */
 #define WIFI_RESTART_INTERVAL 30 /* seconds */
 #define DISPLAY_IR_SCAN_INTERVAL 200 /* 1e-3 seconds */
@@ -52,8 +62,14 @@ const int DEFAULT_UPDATE_INTERVAL = 180; // 3 min
 #define MAX_BUFFLEN 300
 
 IRLink *irReceiver;
+IRCodecRegistry *irCodecs; // brands whose frames are decoded, the unit's own is protocol 0
 SenvilleAURA *senville;
+IRCodec *senvilleCodec;
+IRNECRemote *necRemote;
+SenvilleFollowMe *followMe;
 SenvilleAURADisp *disp;
+SenvilleDispFilter *dispFilter;
+SenvilleSweep *sweep;
 uint8_t byteMsgBuf[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
 char controlBuff[MAX_BUFFLEN];
 char displayBuff[MAX_BUFFLEN];
@@ -62,11 +78,6 @@ volatile uint8_t updateFlags = UpdateProperty::None;
 boolean ready = false;
 
 CStringArray PropertyLabels;
-uint8_t capturePropertyIndex;
-uint8_t initiatePropertyCapture;
-unsigned long timeOfLabelCapture;
-#define PROPERTY_MODE_COMMANDS 6
-#define OPTION_CMD "{Instr:2, Opt:%d}"
 Properties properties[DISP_PROPERTIES];
 
 // Forward declarations
@@ -150,26 +161,31 @@ void irSendFromMsgBuffer(uint8_t *msgBuffer) {
     Serial.printf("%0X ",msgBuffer[i]);
   Serial.println();
   #endif
-  irReceiver->send(msgBuffer,true);  // NOWait=true will cause 'echo' which is desired here, it gets written back to MQTT
+  // Commands carry the whole state, a newer one replaces any still waiting.  Options step
+  // the display through its properties so each one must go out, in order.
+  // Not waiting will cause 'echo' which is desired here, it gets written back to MQTT
+  irReceiver->sendAsync(msgBuffer, SenvilleAURA::getInstructionType(msgBuffer) == Instruction::Command
+                                   ? IRTxSupersede : IRTxOrdered);
   irReceiver->listen();
-  lastUpdate = 0; // will trigger a publish event
 }
 
-void saveConfig(uint8_t *msgBuffer) {
-  String strVal;
+void irSendComplete() {
+  updateFlags |= UpdateProperty::UpdateControl; // publish what the send changed
+}
 
+void saveConfig(uint8_t *msgBuffer) {
   file_t fd = fileOpen(_F(CONFIG_FILENAME), eFO_CreateNewAlways |  eFO_ReadWrite );
   #ifdef DEBUG
   Serial.printf(_F("save fileOpen(\"%s\") = %d\r\n"), _F(CONFIG_FILENAME), fd);
   #endif
   if(fd > 0) {
     if(senville->isValid(msgBuffer)) {
-      senville->toJsonBuff((char *)controlBuff);
-      strVal = String((const char *)controlBuff);
+      BuffWriter out(controlBuff, MAX_BUFFLEN);
+      senville->toJsonBuff(out);
       #ifdef DEBUG
-          Serial.printf("write: %s\n",strVal.c_str());
+          Serial.printf("write: %s\n",out.c_str());
       #endif
-      if (fileWrite(fd, (const void *)strVal.c_str(), strVal.length()) < 0) {
+      if (fileWrite(fd, (const void *)out.c_str(), out.length()) < 0) {
         #ifdef DEBUG
         printf("\twrite errno %i\n", fileLastError(fd));
         #endif
@@ -197,10 +213,38 @@ void saveOTA(String msg) {
   }
 }
 
+void saveSweep(String spec) {
+  file_t fd = fileOpen(_F(SWEEP_FILENAME), eFO_CreateNewAlways |  eFO_ReadWrite );
+  #ifdef DEBUG
+  Serial.printf(_F("save fileOpen(\"%s\") = %d\r\n"), _F(SWEEP_FILENAME), fd);
+  #endif
+  if(fd > 0) {
+    if (fileWrite(fd, (const void *)spec.c_str(), spec.length()) < 0) {
+      #ifdef DEBUG
+      printf("\twrite errno %i\n", fileLastError(fd));
+      #endif
+    }
+    fileClose(fd);
+  }
+}
+
+// Properties the sweep reads, as last set over MQTT
+void loadSweep() {
+  int readBytes = 0;
+
+  file_t fd = fileOpen(_F(SWEEP_FILENAME), eFO_ReadOnly);
+  if(fd > 0) {
+    readBytes = fileRead(fd, controlBuff, MAX_BUFFLEN);
+    fileClose(fd);
+  }
+  if(readBytes < 0 || fd <= 0 || !sweep->setProperties(controlBuff, readBytes)) {
+    String spec = F(SWEEP_DEFAULT);
+    sweep->setProperties(spec.c_str(), spec.length());
+  }
+}
 
 void loadConfig() {
   int readBytes = 0;
-  String strVal;
 
   file_t fd = fileOpen(_F(CONFIG_FILENAME), eFO_ReadOnly);
   #ifdef DEBUG
@@ -210,13 +254,11 @@ void loadConfig() {
 	if(fd > 0) {
     readBytes = fileRead(fd, controlBuff, MAX_BUFFLEN);
 		if(readBytes > 0) {
-      strVal = String((const char *)controlBuff);
-
       #ifdef DEBUG
-          Serial.printf("Loaded: %s\n",controlBuff);
+          Serial.printf("Loaded: %.*s\n",readBytes,controlBuff);
       #endif
 
-      senville->fromJsonBuff((char *)strVal.c_str(), byteMsgBuf);
+      senville->fromJsonBuff(controlBuff, readBytes, byteMsgBuf);
       irSendFromMsgBuffer(byteMsgBuf);
 		}
     fileClose(fd);
@@ -227,45 +269,59 @@ void loadConfig() {
   }
 }
 
-void publish() {
-    String strVal;
+// Receive and send counters for the debug topic
+void statsToBuff(BuffWriter &out) {
+  out.str("{sweepTarget: ").num(sweep->getProperty())  // -1 when no sweep is running
+     .str(", lastPropertyUpdate:").unum(lastPropertyUpdate)
+     .str(", sweepEveryMs: ").num((long)(PROPERTY_SCAN_AT_TIME * 1e3))
+     .str(", irDropped: ").unum(irReceiver->getDroppedFrames())
+     .str(", irRejected: ").unum(irCodecs->getRejected())
+     .str(", irSoft: ").unum(senville->getSoftRecovered())
+     .str(", dispDropped: ").unum(disp->getDroppedFrames())
+     .str(", txDepth: ").num(irReceiver->getTxQueueDepth())
+     .str(", txMerged: ").unum(irReceiver->getTxMerged())
+     .str(", txLatencyUs: ").unum(irReceiver->getTxLatencyUs())
+     .str(", txMaxLatencyUs: ").unum(irReceiver->getTxMaxLatencyUs())
+     .str(", fmSent: ").unum(followMe->getSent())
+     .str(", fmFixedSent: ").unum(followMe->getFixedSent())
+     .str(", fmSavedMs: ").num(followMe->getSavedMs()).chr('}');
+}
 
-    if(updateFlags & UpdateProperty::UpdateControl) {
-      // Dont want to put forward option commands, they'll show up in the control property
-      if( senville->getInstructionType() != Instruction::InstrOption ) {
-        // Always get update to get sample time
-        senville->toJsonBuff((char *)controlBuff);
+// Publish what was written, or say on debug that it did not fit
+void publishOut(const String &topic, BuffWriter &out) {
+  if(out.overflow()) {
+    mqtt->publish(_F(MQTT_DEBUG_PATH), String(_F("{overflow: \"")) + topic + "\"}");
+  } else {
+    mqtt->publish(topic, String(out.c_str(), out.length()));
+  }
+}
 
-  			strVal = String((const char *)controlBuff);
-  			mqtt->publish(_F(MQTT_STATUS_PATH), strVal);
+void publish() {
+    if(updateFlags & UpdateProperty::UpdateControl) {
+      // Only the fields of the last Command frame, option and Follow-Me frames never change them
+      // Those that changed, all of them with the sample time on a snapshot
+      BuffWriter out(controlBuff, MAX_BUFFLEN);
+      if(senville->toJsonDelta(out, updateFlags & UpdateProperty::Snapshot) > 0) {
+        publishOut(_F(MQTT_STATUS_PATH), out);
       }
     }
 
     if(updateFlags & UpdateProperty::Display) {
       // Always get update to get sample time
-      disp->toBuff((char *)displayBuff);
-
-      strVal = String((const char *)displayBuff);
-      mqtt->publish(_F(MQTT_DISPLAY_PATH), strVal);
+      BuffWriter disOut(displayBuff, MAX_BUFFLEN);
+      disp->toBuff(disOut);
+      publishOut(_F(MQTT_DISPLAY_PATH), disOut);
 
-      sprintf(displayBuff,"{capturePropertyIndex: %d, lastPropertyUpdate:%ld, waitTime: %ld}"
-      , capturePropertyIndex, lastPropertyUpdate, (long)(PROPERTY_SCAN_AT_TIME * 1e3));
-      strVal = String((const char *)displayBuff);
-      mqtt->publish(_F(MQTT_DEBUG_PATH), strVal);
+      BuffWriter dbgOut(displayBuff, MAX_BUFFLEN);
+      statsToBuff(dbgOut);
+      publishOut(_F(MQTT_DEBUG_PATH), dbgOut);
 
       // Publish values at same time
-      //if( capturePropertyIndex == 0 )
+      //if( !sweep->isRunning() )
       { // Publish only when not scanning
-        sprintf(displayBuff,"{");
-        for(int i = 0; i<DISP_PROPERTIES; i++ ) {
-          int pos = strlen(displayBuff);
-          if( String((char *)properties[i].key).length()>0) {
-            sprintf(&(displayBuff)[(pos)],"%s:%d%s",(char *)properties[i].key,properties[i].value,( (i < DISP_PROPERTIES-1)?", ":""));
-          }
-        }
-        int pos = strlen(displayBuff); sprintf(&(displayBuff)[(pos)],"}");
-        strVal = String((const char *)displayBuff);
-        mqtt->publish(_F(MQTT_PROPERTIES_PATH), strVal);
+        BuffWriter propOut(displayBuff, MAX_BUFFLEN);
+        propertiesToBuff(propOut, properties);
+        publishOut(_F(MQTT_PROPERTIES_PATH), propOut);
 
         lastPropertyUpdate = millis();
       }
@@ -274,71 +330,89 @@ void publish() {
     updateFlags = UpdateProperty::None;
 }
 
+#ifdef DEBUG
+// Every frame as received, valid or not, for crc_batch
+void printReceived(IRCodec *codec, const uint8_t *msg) {
+  IRConfig *cfg = codec->getIRConfig();
+  Serial.print("Received message : 0x");
+  for(int i=0; i<MSGSIZE_BYTES(cfg->msgSamplesCnt,cfg->msgBitsCnt) ; i++)
+    Serial.printf("%0X ",msg[i]);
+  Serial.println();
+}
+#endif
+
 // Publish our message
 void scan()
 {
 	unsigned long thisUpdate = millis();
   uint8_t *mem = NULL;
 
-  // Check display hardware
-  if(disp->hasUpdate()) {
-    disp->toBuff((char *)displayBuff);
-    if(initiatePropertyCapture == 0
-      && capturePropertyIndex > 0
-      && capturePropertyIndex < DISP_PROPERTIES
-    ) {
-      char localbuf[DISPLAY_BYTE_SIZE];
-      disp->asciiDisplay((char *)localbuf);
-      capturePropertyIndex = PropertyLabels.indexOf(localbuf,true);
-      if(capturePropertyIndex >= 0) {
-        // Validate expected label
-        properties[capturePropertyIndex] = PropertiesS(displayBuff,0);
-        timeOfLabelCapture = millis();
-      } else {
-        String strVal;
-
-        strVal = String((const char *)localbuf);
-        mqtt->publish(_F(MQTT_DEBUG_PATH), strVal);
-
-        // Wait some time before reading value
-        if( (millis() - timeOfLabelCapture) > DISPLAY_IR_SCAN_INTERVAL * 3 ) {
-          // If not expected label, it is value (if not spaces), set it and increment to next property
-          if(strcmp(localbuf, _F("  ")) != 0) {
-            properties[capturePropertyIndex] = PropertiesS((char *)String(PropertyLabels[capturePropertyIndex]).c_str()
-              , localbuf );
-            // Send command to increment to next
-            sprintf(controlBuff,OPTION_CMD,Option::Led);
-            senville->fromJsonBuff(controlBuff, byteMsgBuf);
-            irSendFromMsgBuffer(byteMsgBuf);
-          }
-        }
-      }
-    }
-    updateFlags |= UpdateProperty::Display;
+  // Check display hardware, every frame since the last scan in the order shown
+  DispFrame frame;
+  uint8_t settled = DispFilterNone;
+  while(disp->nextFrame(frame)) {
+    settled |= sweep->update(frame);
+    if(disp->show(frame)) updateFlags |= UpdateProperty::Display;
+  }
+  settled |= dispFilter->poll(thisUpdate);
+  // Diagnostic mode property sweep, on to the next as soon as a value is sure
+  uint8_t sweepMsg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+  uint8_t swept = sweep->poll(sweepMsg, thisUpdate, settled);
+  if(swept & SweepCaptured) {
+    BuffWriter dbgOut(displayBuff, MAX_BUFFLEN);
+    dbgOut.str("{label:\"").str(properties[sweep->getCapturedIndex()].key)
+          .str("\", value:\"").str(sweep->getValue())
+          .str("\", confidence:").unum(sweep->getConfidence())
+          .str(", settleMs:").unum(sweep->getSettleMs())
+          .str(", stepMs:").unum(sweep->getStepMs()).chr('}');
+    publishOut(_F(MQTT_DEBUG_PATH), dbgOut);
+  }
+  if(swept & SweepSend) irSendFromMsgBuffer(sweepMsg);
+  if(swept & SweepDone) {
+    BuffWriter dbgOut(displayBuff, MAX_BUFFLEN);
+    dbgOut.str("{sweepMs:").unum(sweep->getSweepMs())
+          .str(", stepMaxMs:").unum(sweep->getStepMaxMs())
+          .str(", planned:").unum(sweep->getPlanned())
+          .str(", captured:").unum(sweep->getCaptured())
+          .str(", missed:").unum(sweep->getMissed())
+          .str(", sent:").unum(sweep->getSent())
+          .str(", retries:").unum(sweep->getRetries())
+          .str(", reentries:").unum(sweep->getReentries()).chr('}');
+    publishOut(_F(MQTT_DEBUG_PATH), dbgOut);
+    procTimer.setIntervalMs(DISPLAY_IR_SCAN_INTERVAL);
+    updateFlags |= UpdateProperty::Display; // the values with the next publish
   }
 
-  // Check IR Link hardware
-  mem = irReceiver->loop_chkMsgReceived();
-  if(mem != NULL) {
-#ifdef DEBUG
-    Serial.print("Received message : 0x");
-    for(int i=0; i<MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) ; i++)
-      Serial.printf("%0X ",mem[i]);
-    Serial.println();
-#endif
-    if(senville->isValid(mem)) {
+  irReceiver->loop_chkSendComplete();
+
+  // Follow-Me keeps clear of the property scan and anything still going out
+  uint8_t fmMsg[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+  bool irBusy = sweep->isRunning() || irReceiver->getTxQueueDepth() > 0;
+  if(followMe->poll(fmMsg, thisUpdate, irBusy) != NULL) {
+    irSendFromMsgBuffer(fmMsg);
+  }
+
+  // Check IR Link hardware, frames keep arriving while we look so take all of them
+  // Each one is checked by the brand IRLink matched from its sync pulses
+  IRCodec *codec;
+  while((mem = irCodecs->loop_chkMsgReceived(&codec)) != NULL) {
+    if(codec != senvilleCodec) {
+      // Another brand's remote, pass on what it sent
+      BuffWriter out(controlBuff, MAX_BUFFLEN);
+      codec->toJsonBuff(out);
+      publishOut(String(_F(MQTT_STATUS_PATH)) + "/" + codec->getName(), out);
+    } else {
 #ifdef DEBUG
       Serial.print("Validated message : ");
-      senville->toBuff((char *)controlBuff);
+      senville->toBuff((char *)controlBuff, MAX_BUFFLEN);
       Serial.println((char *)controlBuff);
 #endif
 #ifdef DEBUG
-      senville->toJsonBuff((char *)controlBuff);
+      senville->toJsonBuff((char *)controlBuff, MAX_BUFFLEN);
       Serial.println((char *)controlBuff);
 #endif
       updateFlags |= UpdateProperty::UpdateControl;
     }
-    irReceiver->listen();
   }
 
   // Update Homie properties
@@ -346,23 +420,14 @@ void scan()
     updateFlags = UpdateProperty::All;
   }
 #ifdef AUTO_PROPERTY_CAPTURE
-  // Initiate property capture cycle
-  if( (capturePropertyIndex == 0 || capturePropertyIndex >= DISP_PROPERTIES)
+  // Initiate property capture cycle, scanning faster until it is done
+  if( !sweep->isRunning()
     && ( (thisUpdate - lastPropertyUpdate) >= (PROPERTY_SCAN_AT_TIME * 1e3) || lastPropertyUpdate == 0 )) {
-    capturePropertyIndex = 1;
-    initiatePropertyCapture = PROPERTY_MODE_COMMANDS;
-    for(int i=0; i < DISP_PROPERTIES; i++) properties[i].value = 0; // clear out values
-  }
-  // Send command and advance to completion of sequence in each scan cycle
-  switch(initiatePropertyCapture) {
-    case 6: case 5: case 4:      sprintf(controlBuff,OPTION_CMD,Option::Led);      break;
-    case 3: case 2: case 1:      sprintf(controlBuff,OPTION_CMD,Option::Direct);   break;
-    default: break; // do nothing
-  }
-  if(initiatePropertyCapture > 0) {
-    senville->fromJsonBuff(controlBuff, byteMsgBuf);
-    irSendFromMsgBuffer(byteMsgBuf);
-    initiatePropertyCapture--;
+    if(sweep->start(thisUpdate)) {
+      procTimer.setIntervalMs(SWEEP_SCAN_INTERVAL);
+    } else {
+      lastPropertyUpdate = thisUpdate; // none due this time round
+    }
   }
 #endif
   // Re-connect if needed and publish to MQTT
@@ -374,8 +439,8 @@ void scan()
 		Serial.print(_F("Memory free="));
 		Serial.println(system_get_free_heap_size());
 #endif
+    if(updateFlags & UpdateProperty::Snapshot) lastUpdate = thisUpdate;
 		publish();
-    lastUpdate = thisUpdate;
   }
 
   disp->listen();
@@ -392,8 +457,8 @@ void onMessageReceived(String topic, String message)
 	if(topic == _F(MQTT_CONTROL_PATH)) {
     uint8_t currentMessage[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
     memcpy(currentMessage, senville->getMessage(), MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) * sizeof(uint8_t));
-    senville->fromJsonBuff((char *)message.c_str(), byteMsgBuf);
-    if( senville->getInstructionType() == Instruction::Command ) {
+    senville->fromJsonBuff(message.c_str(), message.length(), byteMsgBuf);
+    if( SenvilleAURA::getInstructionType(byteMsgBuf) == Instruction::Command ) {
       if(memcmp(currentMessage,byteMsgBuf,MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) * sizeof(uint8_t)) != 0) {
         saveConfig(byteMsgBuf);
       } // Different
@@ -401,10 +466,38 @@ void onMessageReceived(String topic, String message)
     // Always want to transmit these messages
     irSendFromMsgBuffer(byteMsgBuf);
   }
+  if(topic == _F(MQTT_IRSTATS_PATH)) {
+    for(int sym = 0; sym < IR_HIST_SYMBOLS; sym++) {
+      irReceiver->histogramToBuff(displayBuff, MAX_BUFFLEN, 0, (IRHistSym)sym);
+      if(displayBuff[0]) mqtt->publish(_F(MQTT_DEBUG_PATH), String((const char *)displayBuff));
+    }
+    if(message == _F("reset")) irReceiver->resetHistogram();
+  }
+  if(topic == _F(MQTT_FOLLOWME_PATH)) {
+    SenvilleCmd cmd;
+    if(SenvilleAURA::parseCmd(message.c_str(), message.length(), &cmd)) {
+      if(cmd.hasKey(KeyMeasTemp)) followMe->setMeasured((uint8_t)cmd.val[KeyMeasTemp]);
+      if(cmd.hasKey(KeyState) && cmd.val[KeyState] == FollowMeState::FmStop) {
+        followMe->stop();
+      } else {
+        followMe->start();
+      }
+    }
+  }
+  if(topic == _F(MQTT_SWEEP_PATH)) {
+    if(sweep->setProperties(message.c_str(), message.length())) saveSweep(message);
+    BuffWriter dbgOut(displayBuff, MAX_BUFFLEN);
+    dbgOut.str("{sweepWanted:").unum(sweep->getWanted())
+          .str(", sweepHot:").unum(sweep->getHot()).chr('}');
+    publishOut(_F(MQTT_DEBUG_PATH), dbgOut);
+  }
   if(topic == _F(MQTT_OTA_ROM_SPIFFS)) {
     irReceiver->listenStop();  // don't want these HW interrupts happening
     disp->listenStop();
     mqtt->unsubscribe(_F(MQTT_CONTROL_PATH));
+    mqtt->unsubscribe(_F(MQTT_IRSTATS_PATH));
+    mqtt->unsubscribe(_F(MQTT_FOLLOWME_PATH));
+    mqtt->unsubscribe(_F(MQTT_SWEEP_PATH));
     mqtt->unsubscribe(_F(MQTT_OTA_ROM_SPIFFS));
     delete mqtt;  mqtt = nullptr;
     saveOTA(message);
@@ -431,8 +524,8 @@ void startMqttClient()
 		Serial.println(client.getRemoteIp());
 #endif
     ready = true;
-    capturePropertyIndex = 0;
-    initiatePropertyCapture = 0;
+    updateFlags = UpdateProperty::All; // broker may have missed deltas while away
+    sweep->stop();
 
     // Start publishing loop
     procTimer.initializeMs(DISPLAY_IR_SCAN_INTERVAL, scan).start();
@@ -459,6 +552,9 @@ void startMqttClient()
 #endif
 	mqtt->connect(url, _F(MQTT_DEVICE_NAME));
 	mqtt->subscribe(_F(MQTT_CONTROL_PATH));
+	mqtt->subscribe(_F(MQTT_IRSTATS_PATH));
+	mqtt->subscribe(_F(MQTT_FOLLOWME_PATH));
+	mqtt->subscribe(_F(MQTT_SWEEP_PATH));
   mqtt->subscribe(_F(MQTT_OTA_ROM_SPIFFS));
 }
 
@@ -549,14 +645,27 @@ void GDB_IRAM_ATTR init()
   delay(3000);
 
 	// Hardware integration
-	disp = new SenvilleAURADisp();
+	disp = new SenvilleAURADisp(DispBitBang);
+	dispFilter = new SenvilleDispFilter(PropertyLabels.c_str(), PropertyLabels.length());
+	sweep = new SenvilleSweep(dispFilter, properties);
 	senville = new SenvilleAURA();
-	irReceiver = new IRLink(senville->getIRConfig());
+	necRemote = new IRNECRemote();
+	followMe = new SenvilleFollowMe(senville);
+	senvilleCodec = new IRCodecOf<SenvilleAURA>(*senville, "SenvilleAURA");
+	irReceiver = new IRLink(senvilleCodec->getIRConfig());
+	irCodecs = new IRCodecRegistry(irReceiver, senvilleCodec);
+	irCodecs->add(new IRCodecOf<IRNECRemote>(*necRemote, "NEC"));
+#ifdef DEBUG
+	irCodecs->onFrame(printReceived);
+#endif
+	irReceiver->onSendComplete(irSendComplete);
+	irReceiver->enableSoftBits();
 	updateFlags = UpdateProperty::All;
 	lastUpdate = 0;
   lastPropertyUpdate = 0;
 
   loadConfig();
+  loadSweep();
 
 	WifiStation.config(WIFI_SSID, WIFI_PWD);
 	WifiStation.enable(true);
@@ -0,0 +1 @@
+../../src/IRCodec.hpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/IRNECRemote.hpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/IRProtocol.hpp
\ No newline at end of file
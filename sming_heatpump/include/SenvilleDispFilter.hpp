@@ -0,0 +1 @@
+../../src/SenvilleDispFilter.hpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/SenvilleFollowMe.hpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/SenvilleSweep.hpp
\ No newline at end of file
@@ -0,0 +1,89 @@
+//
+//  BuffWriter.hpp
+//
+//  Appends text to a fixed char buffer, keeping the write position so each
+//  append costs only what it writes.  Numbers are formatted without printf.
+//  What does not fit is dropped, the buffer stays terminated, and overflow()
+//  reports it.
+//
+//      char buf[100];
+//      BuffWriter out(buf, sizeof(buf));
+//      out.str("{SetTemp:").num(22).chr('}');
+//      if(out.overflow()) ...
+//
+
+#ifndef BuffWriter_hpp
+#define BuffWriter_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+
+class BuffWriter {
+public:
+    BuffWriter(char *pbuf, size_t psize) : buf(pbuf), size(psize), pos(0), over(psize == 0) {
+        if(size) buf[0] = 0x00;
+    }
+
+    BuffWriter &chr(char c) {
+        if(pos + 1 < size) {
+            buf[pos++] = c;
+            buf[pos] = 0x00;
+        } else {
+            over = true;
+        }
+        return *this;
+    }
+    BuffWriter &str(const char *s) {
+        while(*s && pos + 1 < size) buf[pos++] = *s++;
+        if(*s) over = true;
+        if(size) buf[pos] = 0x00;
+        return *this;
+    }
+    BuffWriter &str(const char *s, size_t len) {
+        if(pos + len >= size) {
+            len = size ? size - 1 - pos : 0;
+            over = true;
+        }
+        for(size_t i = 0; i < len; i++) buf[pos++] = s[i];
+        if(size) buf[pos] = 0x00;
+        return *this;
+    }
+    BuffWriter &num(long v) {
+        if(v < 0) {
+            chr('-');
+            return unum(0UL - (unsigned long)v);
+        }
+        return unum((unsigned long)v);
+    }
+    BuffWriter &unum(unsigned long v) {
+        char digits[20];
+        uint8_t i = sizeof(digits);
+        do {
+            digits[--i] = '0' + v % 10;
+            v /= 10;
+        } while(v);
+        return str(&digits[i], sizeof(digits) - i);
+    }
+    // Upper case, zero padded to at least width digits
+    BuffWriter &hex(unsigned long v, uint8_t width = 1) {
+        char digits[2 * sizeof(unsigned long)];
+        uint8_t i = sizeof(digits);
+        do {
+            digits[--i] = "0123456789ABCDEF"[v & 0x0F];
+            v >>= 4;
+        } while(i > 0 && (v || sizeof(digits) - i < width));
+        return str(&digits[i], sizeof(digits) - i);
+    }
+
+    char *c_str() { return buf; }
+    size_t length() const { return pos; }
+    bool overflow() const { return over; }
+
+private:
+    char *buf;
+    size_t size;
+    size_t pos;
+    bool over;
+};
+
+#endif /* BuffWriter_hpp */
@@ -0,0 +1,52 @@
+//
+//  IRCodec.cpp
+//
+
+#include "IRCodec.hpp"
+
+IRCodecRegistry::IRCodecRegistry(IRLink *plink, IRCodec *primary) {
+    this->link = plink;
+    this->codecs[0] = primary;
+    this->codecCnt = 1;
+    this->rejected = 0;
+    this->frameCallback = NULL;
+}
+bool IRCodecRegistry::add(IRCodec *codec) {
+    uint8_t protocol = this->link->addProtocol(codec->getIRConfig());
+    if(protocol == IR_NO_PROTOCOL) return false;
+    this->codecs[protocol] = codec;
+    this->codecCnt = protocol + 1;
+    return true;
+}
+uint8_t IRCodecRegistry::getCount() {
+    return this->codecCnt;
+}
+IRCodec *IRCodecRegistry::get(uint8_t protocol) {
+    return protocol < this->codecCnt ? this->codecs[protocol] : NULL;
+}
+IRCodec *IRCodecRegistry::find(const char *name) {
+    for(uint8_t p = 0; p < this->codecCnt; p++) {
+        if(strcmp(this->codecs[p]->getName(), name) == 0) return this->codecs[p];
+    }
+    return NULL;
+}
+uint8_t *IRCodecRegistry::loop_chkMsgReceived(IRCodec **codec) {
+    uint8_t *msg, protocol;
+    while((msg = this->link->loop_chkMsgReceived(&protocol)) != NULL) {
+        IRCodec *c = this->get(protocol);
+        if(c && this->frameCallback) this->frameCallback(c, msg);
+        if(c && c->isValidSoft(msg, this->link->getSoftBits())) {
+            if(codec) *codec = c;
+            return msg;
+        }
+        this->rejected++;
+    }
+    if(codec) *codec = NULL;
+    return NULL;
+}
+unsigned long IRCodecRegistry::getRejected() {
+    return this->rejected;
+}
+void IRCodecRegistry::onFrame(IRCodecFrameCallback callback) {
+    this->frameCallback = callback;
+}
@@ -0,0 +1,79 @@
+//
+//  IRCodec.hpp
+//
+//  Brands decoded from the one receive pin.  Each brand's class, e.g.
+//  SenvilleAURA, is registered as an IRCodec with its IRConfig.  IRLink
+//  picks the protocol of each frame from its sync pulses, and the registry
+//  hands the frame to that brand's class to check and keep.
+//
+//      SenvilleAURA senville;
+//      IRNECRemote nec;
+//      IRCodecOf<SenvilleAURA> senvilleCodec(senville, "SenvilleAURA");
+//      IRCodecOf<IRNECRemote> necCodec(nec, "NEC");
+//      IRLink link(senvilleCodec.getIRConfig());  // sends as the first codec
+//      IRCodecRegistry codecs(&link, &senvilleCodec);
+//      codecs.add(&necCodec);
+//      ...
+//      while((msg = codecs.loop_chkMsgReceived(&codec)) != NULL) ...
+//
+
+#ifndef IRCodec_hpp
+#define IRCodec_hpp
+
+#include "IRLink.hpp"
+
+class IRCodec {
+public:
+    virtual ~IRCodec() {}
+    virtual const char *getName() = 0;
+    virtual IRConfig *getIRConfig() = 0;
+    // As the brand's isValidSoft(), msg is kept if so.  soft may be NULL.
+    virtual bool isValidSoft(uint8_t *msg, const int8_t *soft) = 0;
+    // The frame last kept, as the brand writes it for MQTT
+    virtual bool toJsonBuff(BuffWriter &out) = 0;
+};
+
+// Any brand class with getIRConfig(), isValidSoft(msg, soft) and toJsonBuff(BuffWriter &)
+template<class T>
+class IRCodecOf : public IRCodec {
+public:
+    IRCodecOf(T &pbrand, const char *pname) : brand(pbrand), name(pname) {}
+    const char *getName() { return name; }
+    IRConfig *getIRConfig() { return brand.getIRConfig(); }
+    bool isValidSoft(uint8_t *msg, const int8_t *soft) { return brand.isValidSoft(msg, soft); }
+    bool toJsonBuff(BuffWriter &out) { return brand.toJsonBuff(out); }
+    T &getBrand() { return brand; }
+private:
+    T &brand;
+    const char *name;
+};
+
+// Every frame as it comes in, before its codec checks it
+typedef void (*IRCodecFrameCallback)(IRCodec *codec, const uint8_t *msg);
+
+class IRCodecRegistry {
+public:
+    // primary is protocol 0 of link, the one it sends
+    IRCodecRegistry(IRLink *plink, IRCodec *primary);
+
+    // Also decode frames of codec.  False if the link has no room for another protocol.
+    bool add(IRCodec *codec);
+    uint8_t getCount();
+    IRCodec *get(uint8_t protocol);
+    IRCodec *find(const char *name);
+
+    // Next received frame its codec takes as valid, and that codec.  Frames that do
+    // not check out are counted and passed over.  NULL if there is none.
+    uint8_t *loop_chkMsgReceived(IRCodec **codec);
+    unsigned long getRejected();
+    void onFrame(IRCodecFrameCallback callback);
+
+private:
+    IRLink *link;
+    IRCodec *codecs[IR_MAX_PROTOCOLS];
+    uint8_t codecCnt;
+    unsigned long rejected;
+    IRCodecFrameCallback frameCallback;
+};
+
+#endif /* IRCodec_hpp */
@@ -17,43 +17,103 @@
 //#define DEBUG
 //#define DEBUG_BITS
 
-#if defined(__AVR__)
-    #if defined(__AVR_ATmega32U4__)
-        // TICKS PER us
-        #define IR_SEND_ADJ 2.069
-    #else
-        // TICKS PER us for MEGA 2560
-        #define IR_SEND_ADJ 2.069
-    #endif
-#else //defined(ESP8266)
-// Ticks per us for ESP8266
-#define IR_SEND_ADJ 5.148
-#endif
-
 // Receive values of pointers and state variables
 IRConfig *IRLink::config;
 volatile unsigned long IRLink::lastTime = micros();
-volatile unsigned int IRLink::ringIndex = 0;
-volatile unsigned int IRLink::syncIndex1 = 0;
-volatile unsigned int IRLink::edgeCount1 = 0;
-volatile unsigned int IRLink::edgeCount = 0;
-volatile bool IRLink::received = false;
-volatile IRMsgState IRLink::state = Preamble;
-volatile unsigned long IRLink::timings[RING_BUFFER_SIZE];
+IRMatcher IRLink::matchers[IR_MAX_PROTOCOLS];
+uint8_t IRLink::protocolCnt = 0;
+IRProtocolMask IRLink::syncBuckets[IR_SYNC_BUCKETS];
+IRProtocolMask IRLink::activeProtocols = 0;
+volatile uint8_t IRLink::frameSeq = 0;
+volatile unsigned long IRLink::droppedFrames = 0;
+volatile bool IRLink::listening = false;
+uint8_t IRLink::heldProto = IR_NO_PROTOCOL, IRLink::heldSlot = IR_NO_SLOT;
 uint8_t IRLink::pinX, IRLink::pinR; // Assignable send/receive pins
 
-uint8_t *msgReceivedPtr;
+// Send queue
+uint8_t *IRLink::txSymbols[IR_TX_QUEUE + 1];
+unsigned int IRLink::txSymbolCnt[IR_TX_QUEUE + 1];
+IRTxMode IRLink::txMode[IR_TX_QUEUE + 1];
+unsigned long IRLink::txQueuedUs[IR_TX_QUEUE + 1];
+volatile uint8_t IRLink::txHead = 0;
+volatile uint8_t IRLink::txTail = 0;
+volatile uint8_t IRLink::txDone = 0;
+uint8_t IRLink::txDoneSeen = 0;
+volatile bool IRLink::txBusy = false;
+volatile bool IRLink::txFromQueue = false;
+unsigned long IRLink::txMerged = 0;
+volatile unsigned long IRLink::txLatencyUs = 0, IRLink::txMaxLatencyUs = 0;
+IRSendCallback IRLink::txCallback = NULL;
+#define TX_SLOT(i) ((i) & (IR_TX_QUEUE - 1))
+#define TX_SPARE IR_TX_QUEUE
+
 const unsigned char byteMask[8] = {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
 
-// Received message value pointers
-#define MSGSIZE(samp,msgbits,sync,brk) ((samp) * (2 * (msgbits + ( (brk)>0 ? 1 : 0) ) + (sync)  ))
+// Send values of pointer and memory location for the symbols
+unsigned int volatile tc1_ptr;  // pulse, two per symbol
+unsigned int volatile tc1_cnt;
+IRSymbolTicks IRLink::sendTicks[IR_SYMBOLS];
+const uint8_t *tc1_symbols;     // symbols being clocked out
+const IRSymbolTicks *tc1_ticks;
 
-// Send values of pointer and memory location for pulse length times
-int volatile tc1_ptr;
+// Pulse length in send timer ticks
+#define IR_TICKS(us) ((IRTicks)(((unsigned long)(us) * IR_SEND_ADJ_X1000 + 500) / 1000))
+
+// Edge timestamps
+#ifdef IR_CYCLE_TIMESTAMPS
 #if defined(__AVR__)
-    unsigned short volatile *pulsesToSend;
+// Timer1 at 8 prescaler, extended to 32 bits by counting overflows.  Timer1 is
+// also the send timer, so it is set back up for this as a send ends.
+// Only ticks under IR_TS_MAX_TICKS are converted, more would overflow the multiply.
+#define IR_TS_US(t) ((t) * 8UL / (F_CPU / 1000000UL))
+#define IR_TS_MAX_TICKS ((uint32_t)IR_MAX_PULSE_US * (F_CPU / 1000000UL) / 8)
+volatile uint16_t tc1_overflows = 0;
+ISR(TIMER1_OVF_vect) {
+    tc1_overflows++;
+}
+static inline uint32_t irTimestamp() {
+    uint16_t ticks = TCNT1, ovf = tc1_overflows;
+    // Overflow not counted yet, interrupts are off in the edge handler
+    if((TIFR1 & _BV(TOV1)) && ticks < 0x8000) ovf++;
+    return ((uint32_t)ovf << 16) | ticks;
+}
+static inline unsigned long irTimestampUs(uint32_t ticks) {
+    return ticks >= IR_TS_MAX_TICKS ? IR_MAX_PULSE_US : IR_TS_US(ticks);
+}
+void configTimestamps() {
+    cli();
+    TCCR1A = 0;
+    TCCR1B = _BV(CS11); // normal mode, 8 prescaler
+    TIMSK1 |= _BV(TOIE1);
+    sei();
+}
 #else // defined(ESP8266)
-    uint32_t volatile *pulsesToSend;
+// CCOUNT, converted with a reciprocal as there is no divide instruction
+uint32_t usPerCycleX65536, cyclesMax;
+static inline uint32_t irTimestamp() {
+  #if defined(HOST_PLATFORM)
+    return esp_get_ccount();
+  #else
+    uint32_t ccount;
+    __asm__ __volatile__("rsr %0,ccount" : "=a"(ccount));
+    return ccount;
+  #endif
+}
+static inline unsigned long irTimestampUs(uint32_t cycles) {
+    return cycles >= cyclesMax ? IR_MAX_PULSE_US : (cycles * usPerCycleX65536) >> 16;
+}
+void configTimestamps() {
+    // CPU can be at 80 or 160MHz
+    usPerCycleX65536 = 65536UL / system_get_cpu_freq();
+    cyclesMax = (uint32_t)IR_MAX_PULSE_US * system_get_cpu_freq();
+}
+#endif
+#endif // IR_CYCLE_TIMESTAMPS
+
+#ifdef IR_PULSE_HISTOGRAM
+#define IR_HIST(m,sym,d) histPulse(m,sym,d)
+#else
+#define IR_HIST(m,sym,d)
 #endif
 
 // Only one instance of this class is supported, the last
@@ -71,10 +131,27 @@ void ISRHandler() {
 
 
 
+// Ticks of the next pulse in the symbol stream, 0 once there are none left
+#if defined(__AVR__)
+static inline IRTicks nextPulse() {
+#else // defined(ESP8266)
+static inline IRTicks ICACHE_RAM_ATTR nextPulse() {
+#endif
+    IRTicks ticks = 0;
+    while(ticks == 0 && tc1_ptr < tc1_cnt) {
+        unsigned int symbol = tc1_ptr >> 1;
+        uint8_t sym = (tc1_symbols[symbol / IR_SYMBOLS_PER_BYTE] >> ((symbol % IR_SYMBOLS_PER_BYTE) * IR_SYMBOL_BITS)) & 0x03;
+        ticks = tc1_ticks[sym][tc1_ptr & 1];
+        tc1_ptr++;
+    }
+    return ticks;
+}
+
 // Timer compare A interrup service routine
 #if defined(__AVR__)
 ISR(TIMER1_COMPA_vect){
     cli();
+    if(tc1_ptr == 0) IRLink::txFirstEdge();
     #if defined(__AVR_ATmega32U4__)
         // Toggle output value
         IR_SENDPORT ^= _BV( ATmega32U4_ProMicroWiring(IRLink::pinX));
@@ -83,31 +160,29 @@ ISR(TIMER1_COMPA_vect){
         IR_SENDPORT ^= _BV(IRLink::pinX);
     #endif
     // Set next timer value
-    OCR1A = pulsesToSend[tc1_ptr];
-    // Increment pointer in array
-    tc1_ptr++;
-    // If at end, stop
-    if ( tc1_ptr >= MSGSIZE(IRLink::config->msgSamplesCnt,IRLink::config->msgBitsCnt
-                            ,IRLink::config->msgSyncCnt
-                            ,IRLink::config->msgBreakLength.val)) {
+    IRTicks ticks = nextPulse();
+    if(ticks) OCR1A = ticks;
+    // If at end, carry on with the next frame queued or stop
+    if ( tc1_ptr >= tc1_cnt && !IRLink::txNextFrame()) {
         // disable timer compare interrupt
         TIMSK1 &= ~_BV(OCIE1A);
+    #ifdef IR_CYCLE_TIMESTAMPS
+        configTimestamps();
+    #endif
     }
     sei();
 }
 #else // defined(ESP8266)
 void ICACHE_RAM_ATTR onTimer1ISR(void *argptr){
     cli();
+    if(tc1_ptr == 0) IRLink::txFirstEdge();
     // Toggle output value
     digitalWrite(IRLink::pinX,!(digitalRead(IRLink::pinX)));  //Toggle LED Pin
     // Set next timer value
-    hw_timer1_write(pulsesToSend[tc1_ptr]);
-    // Increment pointer in array
-    tc1_ptr++;
-    // If at end, stop
-    if ( tc1_ptr >= MSGSIZE(IRLink::config->msgSamplesCnt,IRLink::config->msgBitsCnt
-                            ,IRLink::config->msgSyncCnt
-                            ,IRLink::config->msgBreakLength.val)) {
+    IRTicks ticks = nextPulse();
+    if(ticks) hw_timer1_write(ticks);
+    // If at end, carry on with the next frame queued or stop
+    if ( tc1_ptr >= tc1_cnt && !IRLink::txNextFrame()) {
         // disable timer compare interrupt
         hw_timer1_disable();
         if(IRLink::pinX == IRLink::pinR) {
@@ -119,6 +194,30 @@ void ICACHE_RAM_ATTR onTimer1ISR(void *argptr){
 }
 #endif
 
+void startSend(const uint8_t *symbols, unsigned int count, const IRSymbolTicks *ticks) {
+    cli();
+    // Set symbol pointer to first pulse
+    tc1_symbols = symbols;
+    tc1_ticks = ticks;
+    tc1_cnt = 2 * count;
+    tc1_ptr = 0;
+    IRTicks first = nextPulse();
+    tc1_ptr = 0;
+#if defined(__AVR__)
+    // Set first comparitor value to trigger in short time
+    OCR1A = first;
+    // enable timer compare interrupt
+    TIMSK1 |= _BV(OCIE1A);
+#else // defined(ESP8266)
+    //Initialize Ticker every 5 ticks/us - 1677721.4 us max
+    hw_timer1_attach_interrupt((hw_timer_source_type_t)0,onTimer1ISR, nullptr);
+    // Set first comparitor value to trigger in short time & enable interrupt
+    hw_timer1_enable(TIMER_CLKDIV_16, TIMER_EDGE_INT, TIMER_FRC1_SOURCE);
+    hw_timer1_write(first);
+#endif
+    sei();
+}
+
 void configSend() {
     cli();//stop interrupts
 #if defined(__AVR__)
@@ -164,13 +263,26 @@ IRLink::IRLink(IRConfig *_config, uint8_t ppinX, uint8_t ppinR) {
     config = _config;
     pinX = ppinX;
     pinR = ppinR;
-#if defined(__AVR__)
-    pulsesToSend = (unsigned short *)malloc(sizeof(unsigned short)*MSGSIZE(config->msgSamplesCnt,config->msgBitsCnt,config->msgSyncCnt,config->msgBreakLength.val));
-#else // defined(ESP8266)
-    pulsesToSend = (uint32_t *)malloc(sizeof(uint32_t)*MSGSIZE(config->msgSamplesCnt,config->msgBitsCnt,config->msgSyncCnt,config->msgBreakLength.val));
-#endif
+    unsigned int symbolBytes = IR_SYMBOL_BYTES(IR_SYMBOL_CNT(config->msgSamplesCnt,config->msgBitsCnt,config->msgBreakLength.val));
+    txSymbols[0] = (uint8_t *)malloc(sizeof(uint8_t) * (IR_TX_QUEUE + 1) * symbolBytes);
+    for(uint8_t i = 1; i <= IR_TX_QUEUE; i++) txSymbols[i] = txSymbols[0] + i * symbolBytes;
+    txHead = txTail = txDone = txDoneSeen = 0;
+    txMerged = txLatencyUs = txMaxLatencyUs = 0;
+    // Scale the pulses as per timer configuration once, not per send
+    sendTicks[IRSymSync][0] = IR_TICKS(config->syncLengths[0].val);
+    sendTicks[IRSymSync][1] = config->msgSyncCnt > 1 ? IR_TICKS(config->syncLengths[1].val) : 0;
+    sendTicks[IRSymZero][0] = IR_TICKS(config->bitSeparatorLength.val);
+    sendTicks[IRSymZero][1] = IR_TICKS(config->bitZeroLength.val);
+    sendTicks[IRSymOne][0] = IR_TICKS(config->bitSeparatorLength.val);
+    sendTicks[IRSymOne][1] = IR_TICKS(config->bitOneLength.val);
+    sendTicks[IRSymBreak][0] = IR_TICKS(config->bitSeparatorLength.val);
+    sendTicks[IRSymBreak][1] = IR_TICKS(config->msgBreakLength.val);
 
-    msgReceivedPtr = (uint8_t *)malloc(sizeof(uint8_t) * MSGSIZE_BYTES(config->msgSamplesCnt,config->msgBitsCnt));
+    protocolCnt = 0;
+    activeProtocols = 0;
+    memset(syncBuckets, 0, sizeof(syncBuckets));
+    droppedFrames = 0;
+    addProtocol(config);
 #ifdef DEBUG
     Serial.print("IRLink::IRLink");
 #endif
@@ -180,234 +292,508 @@ IRLink::IRLink(IRConfig *_config, uint8_t ppinX, uint8_t ppinR) {
     }
 }
 IRLink::~IRLink() {
-    if(pulsesToSend) free((void *)pulsesToSend);
-    if(msgReceivedPtr) free((void *)msgReceivedPtr);
+    // Let the queue drain, the interrupt still points into it
+    while(txBusy) delay(1);
+    // Slots are swapped about, the block starts at the lowest one
+    uint8_t *block = txSymbols[0];
+    for(uint8_t i = 1; i <= IR_TX_QUEUE; i++) if(txSymbols[i] < block) block = txSymbols[i];
+    if(block) free((void *)block);
+    txSymbols[0] = NULL;
+    listenStop();
+    for(uint8_t p = 0; p < protocolCnt; p++) {
+        if(matchers[p].frameSlots[0]) free((void *)matchers[p].frameSlots[0]);
+        matchers[p].frameSlots[0] = NULL;
+        if(matchers[p].softSlots[0]) free((void *)matchers[p].softSlots[0]);
+        matchers[p].softSlots[0] = NULL;
+#ifdef IR_PULSE_HISTOGRAM
+        if(matchers[p].hist) free((void *)matchers[p].hist);
+        matchers[p].hist = NULL;
+#endif
+    }
+    protocolCnt = 0;
+    activeProtocols = 0;
+    memset(syncBuckets, 0, sizeof(syncBuckets));
     lastInstance = 0;
 }
+uint8_t IRLink::addProtocol(IRConfig *protoConfig) {
+    if(protocolCnt >= IR_MAX_PROTOCOLS) return IR_NO_PROTOCOL;
+    IRMatcher &m = matchers[protocolCnt];
+    m.config = protoConfig;
+    m.frameSlots[0] = (uint8_t *)malloc(sizeof(uint8_t) * IR_FRAME_SLOTS * MSGSIZE_BYTES(protoConfig->msgSamplesCnt,protoConfig->msgBitsCnt));
+    for(uint8_t i = 0; i < IR_FRAME_SLOTS; i++) {
+        m.frameSlots[i] = m.frameSlots[0] + i * MSGSIZE_BYTES(protoConfig->msgSamplesCnt,protoConfig->msgBitsCnt);
+        m.slotState[i] = SlotFree;
+    }
+    m.fillSlot = IR_NO_SLOT;
+    m.fillPtr = NULL;
+    for(uint8_t i = 0; i < IR_FRAME_SLOTS; i++) m.softSlots[i] = NULL;
+    m.softPtr = NULL;
+#ifdef IR_PULSE_HISTOGRAM
+    m.hist = (uint16_t *)malloc(sizeof(uint16_t) * IR_HIST_SYMBOLS * IR_HIST_BINS);
+    if(m.hist) memset(m.hist, 0, sizeof(uint16_t) * IR_HIST_SYMBOLS * IR_HIST_BINS);
+    for(uint8_t i = 0; i < IR_HIST_SYMBOLS; i++) {
+        unsigned long val = histSymbol(protoConfig, (IRHistSym)i)->val;
+        m.histScale[i] = val ? ((100L / IR_HIST_STEP_PCT) << 16) / val : 0;
+    }
+#endif
+    resetDecoder(m);
+    // Publish to the interrupt handler last, then pulses of its first sync length reach it
+    unsigned long syncLo = protoConfig->syncLengths[0].lo >> IR_SYNC_BUCKET_SHIFT;
+    unsigned long syncHi = protoConfig->syncLengths[0].hi >> IR_SYNC_BUCKET_SHIFT;
+    cli();
+    for(unsigned long b = syncLo; b <= syncHi && b < IR_SYNC_BUCKETS; b++) syncBuckets[b] |= (1 << protocolCnt);
+    if(syncHi >= IR_SYNC_BUCKETS) syncBuckets[IR_SYNC_BUCKETS - 1] |= (1 << protocolCnt);
+    protocolCnt++;
+    sei();
+    return protocolCnt - 1;
+}
+bool IRLink::enableSoftBits(uint8_t protocol) {
+    if(protocol >= protocolCnt) return false;
+    IRMatcher &m = matchers[protocol];
+    IRConfig *cfg = m.config;
+    unsigned int bits = (unsigned int)cfg->msgSamplesCnt * cfg->msgBitsCnt;
+    if(m.softSlots[0]) return true;
+    int8_t *soft = (int8_t *)malloc(sizeof(int8_t) * IR_FRAME_SLOTS * bits);
+    if(!soft) return false;
+    unsigned short half = (cfg->bitOneLength.val - cfg->bitZeroLength.val) / 2;
+    m.softMid = cfg->bitZeroLength.val + half;
+    m.softScale = half ? (127U << 8) / half : 0;
+    m.softLo = cfg->bitZeroLength.lo / 2;
+    m.softHi = cfg->bitOneLength.hi + cfg->bitOneLength.hi / 2;
+    m.softSepHi = m.softMid;
+    cli();
+    for(uint8_t i = 0; i < IR_FRAME_SLOTS; i++) m.softSlots[i] = soft + i * bits;
+    m.softPtr = m.fillSlot != IR_NO_SLOT ? m.softSlots[m.fillSlot] : NULL;
+    sei();
+    return true;
+}
+int8_t *IRLink::getSoftBits() {
+    if(heldProto >= protocolCnt || heldSlot == IR_NO_SLOT) return NULL;
+    return matchers[heldProto].softSlots[0] ? matchers[heldProto].softSlots[heldSlot] : NULL;
+}
+IRConfig *IRLink::getProtocol(uint8_t protocol) {
+    return protocol < protocolCnt ? matchers[protocol].config : NULL;
+}
 void IRLink::listen() {
     lastInstance = this;
-    // clear buffer
-    for(unsigned int i = 0; i<RING_BUFFER_SIZE; i++) timings[i] = 0;
-    // Clear msgReceivedPtr
-    if(msgReceivedPtr != NULL) for(int i=0; i<MSGSIZE_BYTES(config->msgSamplesCnt,config->msgBitsCnt); i++) msgReceivedPtr[i] = 0;
+#ifdef IR_CYCLE_TIMESTAMPS
+    // On AVR the timer is taken until the send ends
+    if(!txBusy) configTimestamps();
+#endif
+    // Already listening, carry on with any frame in progress
+    if(!listening) {
+        for(uint8_t p = 0; p < protocolCnt; p++) resetDecoder(matchers[p]);
+#ifdef IR_CYCLE_TIMESTAMPS
+        lastTime = irTimestamp();
+#else
+        lastTime = micros();
+#endif
+    }
+    listening = true;
     attachInterrupt(digitalPinToInterrupt(pinR), ISRHandler, CHANGE);
     pinMode(pinR, INPUT);
 }
 void IRLink::listenStop() {
+    listening = false;
     detachInterrupt(digitalPinToInterrupt(pinR));
 }
 void IRLink::send(uint8_t *msg, bool noWait) {
-    short ptr, slptr;
-    unsigned int duration = 0;
-
-    for(ptr = 0; ptr < MSGSIZE(config->msgSamplesCnt,config->msgBitsCnt,config->msgSyncCnt,config->msgBreakLength.val); ptr++ ) {
-        // The synch pulses
-        for(slptr = 0; slptr < config->msgSyncCnt; slptr++) {
-            if(ptr % (MSGSIZE(1,config->msgBitsCnt,config->msgSyncCnt,config->msgBreakLength.val)) == slptr) {
-                pulsesToSend[ptr] = config->syncLengths[slptr].val;
-#ifdef DEBUG_BITS
-                Serial.print("synch "); Serial.print(pulsesToSend[ptr]);
-                Serial.print(" ptr "); Serial.print(ptr);
-                Serial.print(" slptr "); Serial.println(slptr);
-                Serial.print(" == "); Serial.println(MSGSIZE(1,config->msgBitsCnt,config->msgSyncCnt,config->msgBreakLength.val));
-#endif
-            }
-        }
-        // Msg body
-        if( ptr % (MSGSIZE(1,config->msgBitsCnt,config->msgSyncCnt,config->msgBreakLength.val))
-           >= config->msgSyncCnt
-           && ptr % (MSGSIZE(1,config->msgBitsCnt,config->msgSyncCnt,config->msgBreakLength.val))
-           < (MSGSIZE(1,config->msgBitsCnt,config->msgSyncCnt,0))
-           ) {
-            if(ptr%2) { // odd bit pulse
-                short hptr = (short)(ptr/2 - (config->msgSyncCnt/2) * ( 1 + ptr / MSGSIZE(1,config->msgBitsCnt,config->msgSyncCnt,config->msgBreakLength.val)) - (ptr / MSGSIZE(1,config->msgBitsCnt,config->msgSyncCnt,config->msgBreakLength.val)) );
-                pulsesToSend[ptr] = (msg[(short)(hptr / BITS_IN_BYTE)] & byteMask[(short)(hptr % BITS_IN_BYTE)]
-                                     ? config->bitOneLength.val : config->bitZeroLength.val );
-#ifdef DEBUG_BITS
-                Serial.print("val "); Serial.print(pulsesToSend[ptr]);
-                Serial.print(" ptr "); Serial.print(ptr);
-                Serial.print(" hptr "); Serial.print(hptr);
-                Serial.print(" byt "); Serial.print((short)(hptr / BITS_IN_BYTE));
-                Serial.print(" bit "); Serial.println((short)(hptr % BITS_IN_BYTE));
-#endif
-            } else { // even is separator pulse
-                pulsesToSend[ptr] = config->bitSeparatorLength.val;
-#ifdef DEBUG_BITS
-                Serial.print("spc "); Serial.print(pulsesToSend[ptr]);
-                Serial.print(" ptr "); Serial.println(ptr);
-#endif
-            }
+    sendAsync(msg, IRTxOrdered);
+    if(!noWait) {
+        while(txBusy) delay(1);
+    }
+}
+
+bool IRLink::sendAsync(uint8_t *msg, IRTxMode mode) {
+    bool queued = true, start = false;
+
+    // Encode outside of the interrupt lock into the spare slot, then swap it in
+    txSymbolCnt[TX_SPARE] = encode(msg, txSymbols[TX_SPARE]);
+    txMode[TX_SPARE] = mode;
+    txQueuedUs[TX_SPARE] = micros();
+
+    cli();
+    uint8_t waiting = txTail - txHead - (txFromQueue ? 1 : 0);
+    uint8_t slot = TX_SLOT(txTail - 1);
+    if(mode == IRTxSupersede && waiting > 0 && txMode[slot] == IRTxSupersede) {
+        // Last frame waiting is older state, replace it where it stands
+        txMerged++;
+    } else if((uint8_t)(txTail - txHead) < IR_TX_QUEUE) {
+        slot = TX_SLOT(txTail);
+        txTail++;
+    } else {
+        queued = false;
+    }
+    if(queued) {
+        uint8_t *symbols = txSymbols[slot];
+        txSymbols[slot] = txSymbols[TX_SPARE];
+        txSymbols[TX_SPARE] = symbols;
+        txSymbolCnt[slot] = txSymbolCnt[TX_SPARE];
+        txMode[slot] = txMode[TX_SPARE];
+        txQueuedUs[slot] = txQueuedUs[TX_SPARE];
+        if(!txBusy) {
+            txBusy = true;
+            txFromQueue = true;
+            start = true;
         }
-        // Msg break
-        if(config->msgBreakLength.val>0 && ptr > 0
-           && ptr % (MSGSIZE(1,config->msgBitsCnt,config->msgSyncCnt,config->msgBreakLength.val))
-           >= MSGSIZE(1,config->msgBitsCnt,config->msgSyncCnt,0)
-           ) {
-               if(ptr%2) { // odd bit pulse
-                   pulsesToSend[ptr] = config->msgBreakLength.val;
-#ifdef DEBUG
-                   Serial.print("brk "); Serial.print(pulsesToSend[ptr]);
-                   Serial.print(" ptr "); Serial.println(ptr);
-#endif
-               } else { // even is separator pulse
-                   pulsesToSend[ptr] = config->bitSeparatorLength.val;
+    }
+    sei();
 #ifdef DEBUG
-                   Serial.print("spc "); Serial.print(pulsesToSend[ptr]);
-                   Serial.print(" ptr "); Serial.println(ptr);
+    if(!queued) Serial.println("send queue full");
 #endif
-               }
-        }
+    if(start) {
+        configSend();
+        startSend(txSymbols[TX_SLOT(txHead)], txSymbolCnt[TX_SLOT(txHead)], sendTicks);
     }
-    // Scale the values as per timer configuration
-    for(ptr = 0; ptr < MSGSIZE(config->msgSamplesCnt,config->msgBitsCnt,config->msgSyncCnt,config->msgBreakLength.val); ptr++ ) {
-        duration += pulsesToSend[ptr];
-        pulsesToSend[ptr] = (pulsesToSend[ptr] * IR_SEND_ADJ) + 0.5;
+    return queued;
+}
+
+// Each sample is the synch pulses, a symbol per bit then the break
+unsigned int IRLink::encode(uint8_t *msg, uint8_t *symbols) {
+    unsigned int sym = 0, bit = 0;
+    uint8_t samp, b;
+
+    for(samp = 0; samp < config->msgSamplesCnt; samp++) {
+        putSymbol(symbols, sym++, IRSymSync);
+        for(b = 0; b < config->msgBitsCnt; b++, bit++) {
+            putSymbol(symbols, sym++, (msg[bit / BITS_IN_BYTE] & byteMask[bit % BITS_IN_BYTE]) ? IRSymOne : IRSymZero);
+        }
+        if(config->msgBreakLength.val > 0) putSymbol(symbols, sym++, IRSymBreak);
     }
 #ifdef DEBUG
-    Serial.print("pulses "); Serial.println(MSGSIZE(config->msgSamplesCnt,config->msgBitsCnt,config->msgSyncCnt,config->msgBreakLength.val));
-    Serial.print("pulse dur "); Serial.println(duration);
+    Serial.print("symbols "); Serial.println(sym);
 #endif
-    configSend();
+    return sym;
+}
+
+void IRLink::txFirstEdge() {
+    if(!txFromQueue) return;
+    txLatencyUs = micros() - txQueuedUs[TX_SLOT(txHead)];
+    if(txLatencyUs > txMaxLatencyUs) txMaxLatencyUs = txLatencyUs;
+}
+
+bool IRLink::txNextFrame() {
+    if(txFromQueue) {
+        txHead++;
+        txDone++;
+    }
+    if(txHead != txTail) {
+        // The break of the frame just sent is already on the timer, the next
+        // interrupt starts this frame's first pulse
+        tc1_symbols = txSymbols[TX_SLOT(txHead)];
+        tc1_cnt = 2 * txSymbolCnt[TX_SLOT(txHead)];
+        tc1_ptr = 0;
+        tc1_ticks = sendTicks;
+        txFromQueue = true;
+        return true;
+    }
+    txFromQueue = false;
+    txBusy = false;
+    return false;
+}
+
+void IRLink::loop_chkSendComplete() {
+    while(txDoneSeen != txDone) {
+        txDoneSeen++;
+        if(txCallback) txCallback();
+    }
+}
+
+void IRLink::onSendComplete(IRSendCallback callback) {
+    txCallback = callback;
+}
+
+uint8_t IRLink::getTxQueueDepth() {
+    return txTail - txHead;
+}
+unsigned long IRLink::getTxMerged() {
+    return txMerged;
+}
+unsigned long IRLink::getTxLatencyUs() {
+    return txLatencyUs;
+}
+unsigned long IRLink::getTxMaxLatencyUs() {
+    return txMaxLatencyUs;
+}
+
+bool IRLink::sendSymbols(const uint8_t *symbols, unsigned int count, const IRSymbolTicks *ticks,
+                         unsigned long durationUs, bool noWait) {
+    if(count == 0) return true;
     cli();
-    // Set array pointer to first byte
-    tc1_ptr = 0;
-#if defined(__AVR__)
-    // Set first comparitor value to trigger in short time
-    OCR1A =  (config->syncLengths[0].val * IR_SEND_ADJ) + 0.5;
-    // enable timer compare interrupt
-    TIMSK1 |= _BV(OCIE1A);
-#else // defined(ESP8266)
-    //Initialize Ticker every 5 ticks/us - 1677721.4 us max
-    hw_timer1_attach_interrupt((hw_timer_source_type_t)0,onTimer1ISR, nullptr);
-    // Set first comparitor value to trigger in short time & enable interrupt
-    hw_timer1_enable(TIMER_CLKDIV_16, TIMER_EDGE_INT, TIMER_FRC1_SOURCE);
-    hw_timer1_write((config->syncLengths[0].val * IR_SEND_ADJ) + 0.5);
-#endif
+    bool busy = txBusy;
+    txBusy = true;
     sei();
-    if(!noWait) delay(duration / 100);
+    if(busy) return false;
+    configSend();
+    startSend(symbols, count, ticks);
+    if(!noWait) delay(durationUs / 100);
+    return true;
+}
+
+bool IRLink::isSending() {
+    return txBusy;
+}
+
+void IRLink::resetDecoder(IRMatcher &m) {
+    m.state = Preamble;
+    m.syncPos = 0;
+    m.edgeCount = 0;
+    m.bitInMsg = 0;
+    m.bitPulse = false;
 }
 
-// detect if a sync signal is present
-bool IRLink::isSync(unsigned int idx) {
-    // Test for each expected preamble value
-    for(unsigned int i= 0; i < this->config->msgSyncCnt; i++) {
-        unsigned long v =  timings[(idx+RING_BUFFER_SIZE-this->config->msgSyncCnt+i+1) % RING_BUFFER_SIZE];
-        if( v < this->config->syncLengths[i].lo || v > this->config->syncLengths[i].hi ) {
-            return false;
+// Take a free slot for the next frame, there is none while the loop has not
+// picked up the frames already decoded into both
+void IRLink::claimSlot(IRMatcher &m) {
+    for(uint8_t i = 0; i < IR_FRAME_SLOTS; i++) {
+        if(m.slotState[i] == SlotFree) {
+            m.slotState[i] = SlotFill;
+            m.fillSlot = i;
+            m.fillPtr = m.frameSlots[i];
+            m.softPtr = m.softSlots[0] ? m.softSlots[i] : NULL;
+            return;
         }
     }
-    return true;
-};
+    m.fillSlot = IR_NO_SLOT;
+    m.fillPtr = NULL;
+    m.softPtr = NULL;
+}
+
+// Advance the sync match with this pulse, on a mismatch it may still start a new one
+void IRLink::huntSync(IRMatcher &m, unsigned long duration) {
+    if(m.config->syncLengths[m.syncPos].inRange(duration)) {
+        IR_HIST(m, m.syncPos == 0 ? IRHistSync0 : IRHistSync1, duration);
+        m.syncPos++;
+    } else {
+        m.syncPos = m.config->syncLengths[0].inRange(duration) ? 1 : 0;
+    }
+    if(m.syncPos == m.config->msgSyncCnt) {
+        m.state = Message;
+        m.syncPos = 0;
+        m.edgeCount = 0;
+        m.bitPulse = false;
+        if(m.bitInMsg == 0 && m.fillSlot == IR_NO_SLOT) claimSlot(m);
+    }
+}
+
+void IRLink::matchPulse(IRMatcher &m, unsigned long duration) {
+    IRConfig *cfg = m.config;
+
+    switch(m.state) {
+        case Gap:
+            // Separator and break, then the sync of the next sample is expected
+            m.edgeCount++;
+            if(m.edgeCount <= 2) IR_HIST(m, m.edgeCount == 1 ? IRHistSep : IRHistBreak, duration);
+            if(m.edgeCount > cfg->msgSyncCnt + 2) {
+                resetDecoder(m);
+            }
+            huntSync(m, duration);
+            break;
+        case Preamble:
+            huntSync(m, duration);
+            break;
+        case Message:
+            if(!m.bitPulse) {
+                if(m.edgeCount > 0 || !cfg->syncLengths[cfg->msgSyncCnt-1].inRange(duration)) {
+                    IR_HIST(m, IRHistSep, duration);
+                }
+                if(cfg->bitSeparatorLength.inRange(duration)
+                   || (m.softSlots[0] && duration >= m.softLo && duration < m.softSepHi)) {
+                    m.bitPulse = true;
+                    m.edgeCount++;
+                } else if(m.edgeCount == 0
+                          && cfg->syncLengths[cfg->msgSyncCnt-1].inRange(duration)) {
+                    // Last sync pulse matched twice, the message starts after this one
+                } else { // Non-compliant message, start over
+                    resetDecoder(m);
+                    huntSync(m, duration);
+                }
+                break;
+            }
+            m.bitPulse = false;
+            m.edgeCount++;
+            IR_HIST(m, 2 * duration >= (unsigned long)cfg->bitZeroLength.val + cfg->bitOneLength.val
+                       ? IRHistOne : IRHistZero, duration);
+            // Start each byte clear, then set the one bits.  No slot, the frame is decoded
+            // only to be counted as dropped.
+            if(m.fillPtr && (m.bitInMsg % BITS_IN_BYTE) == 0) m.fillPtr[m.bitInMsg / BITS_IN_BYTE] = 0;
+            if(m.softSlots[0]) {
+                // Soft decision, anything near enough is a bit with a confidence
+                if(duration < m.softLo || duration > m.softHi) {
+                    resetDecoder(m);
+                    huntSync(m, duration);
+                    break;
+                }
+                long conf = (((long)duration - m.softMid) * m.softScale) >> 8;
+                if(conf > 127) conf = 127;
+                if(conf < -127) conf = -127;
+                if(m.softPtr) m.softPtr[m.bitInMsg] = (int8_t)conf;
+                if(m.fillPtr && duration >= m.softMid) m.fillPtr[m.bitInMsg / BITS_IN_BYTE] |= byteMask[m.bitInMsg % BITS_IN_BYTE];
+            } else if(cfg->bitOneLength.inRange(duration)) {
+                if(m.fillPtr) m.fillPtr[m.bitInMsg / BITS_IN_BYTE] |= byteMask[m.bitInMsg % BITS_IN_BYTE];
+            } else if(!cfg->bitZeroLength.inRange(duration)) { // Non-compliant message, start over
+                resetDecoder(m);
+                huntSync(m, duration);
+                break;
+            }
+            m.bitInMsg++;
+            if((m.bitInMsg % cfg->msgBitsCnt) == 0) {
+                if(m.bitInMsg >= (unsigned int)cfg->msgBitsCnt * cfg->msgSamplesCnt) {
+                    // Hand the slot to the loop and keep listening
+                    if(m.fillSlot != IR_NO_SLOT) {
+                        m.slotState[m.fillSlot] = SlotReady;
+                        m.slotOrder[m.fillSlot] = frameSeq++;
+                        claimSlot(m);
+                    } else {
+                        droppedFrames++;
+                    }
+                    resetDecoder(m);
+                } else {
+                    m.state = Gap;
+                    m.edgeCount = 0;
+                }
+            }
+            break;
+    }
+}
+
+IRPulseLengthUs *IRLink::histSymbol(IRConfig *cfg, IRHistSym sym) {
+    switch(sym) {
+        case IRHistSync0: return &cfg->syncLengths[0];
+        case IRHistSync1: return &cfg->syncLengths[cfg->msgSyncCnt > 1 ? 1 : 0];
+        case IRHistSep:   return &cfg->bitSeparatorLength;
+        case IRHistZero:  return &cfg->bitZeroLength;
+        case IRHistOne:   return &cfg->bitOneLength;
+        default:          return &cfg->msgBreakLength;
+    }
+}
+
+// Bin the deviation from the nominal length, one multiply as this runs per edge
+void IRLink::histPulse(IRMatcher &m, IRHistSym sym, unsigned long duration) {
+#ifdef IR_PULSE_HISTOGRAM
+    if(!m.hist || !m.histScale[sym]) return;
+    long dev = (long)(duration > IR_MAX_PULSE_US ? IR_MAX_PULSE_US : duration) - (long)histSymbol(m.config, sym)->val;
+    long bin = ((dev * m.histScale[sym] + 0x8000L) >> 16) + IR_HIST_BINS / 2;
+    if(bin < 0) bin = 0;
+    if(bin >= IR_HIST_BINS) bin = IR_HIST_BINS - 1;
+    uint16_t &n = m.hist[sym * IR_HIST_BINS + bin];
+    if(n < 0xFFFF) n++;
+#endif
+}
+
+uint16_t *IRLink::getHistogram(uint8_t protocol) {
+#ifdef IR_PULSE_HISTOGRAM
+    return protocol < protocolCnt ? matchers[protocol].hist : NULL;
+#else
+    return NULL;
+#endif
+}
+
+bool IRLink::histogramToBuff(BuffWriter &out, uint8_t protocol, IRHistSym sym) {
+    uint16_t *hist = getHistogram(protocol);
+    if(!hist) return !out.overflow();
+    IRPulseLengthUs *len = histSymbol(matchers[protocol].config, sym);
+    out.str("{proto:").unum(protocol).str(", sym:").unum(sym)
+       .str(", val:").unum(len->val).str(", lo:").unum(len->lo).str(", hi:").unum(len->hi)
+       .str(", stepPct:").unum(IR_HIST_STEP_PCT).str(", n:[");
+    for(uint8_t i = 0; i < IR_HIST_BINS; i++) {
+        if(i) out.chr(',');
+        out.unum(hist[sym * IR_HIST_BINS + i]);
+    }
+    out.str("]}");
+    return !out.overflow();
+}
+char *IRLink::histogramToBuff(char *buf, size_t size, uint8_t protocol, IRHistSym sym) {
+    BuffWriter out(buf, size);
+    histogramToBuff(out, protocol, sym);
+    return buf;
+}
+
+void IRLink::resetHistogram() {
+#ifdef IR_PULSE_HISTOGRAM
+    for(uint8_t p = 0; p < protocolCnt; p++) {
+        cli();
+        if(matchers[p].hist) memset(matchers[p].hist, 0, sizeof(uint16_t) * IR_HIST_SYMBOLS * IR_HIST_BINS);
+        sei();
+    }
+#endif
+}
 
 /* Interrupt handler */
 void IRLink::handler() {
     unsigned long duration = 0;
 
-    // ignore if we haven't processed the previous received signal
-    if (received == true)  return;
     // calculating timing since last change
+#ifdef IR_CYCLE_TIMESTAMPS
+    uint32_t time = irTimestamp();
+    duration = irTimestampUs(time - (uint32_t)lastTime);
+#else
     unsigned long time = micros();
     duration = diffRollSafeUnsignedLong(lastTime,time);
+#endif
 
     lastTime = time;
 
-    // store data in ring buffer
-    ringIndex = (ringIndex + 1) % RING_BUFFER_SIZE;
-    timings[ringIndex] = duration;
-
-    switch(state) {
-        case Preamble:
-            if(isSync(ringIndex)) {
-                syncIndex1 = (ringIndex+RING_BUFFER_SIZE-this->config->msgSyncCnt+1+1) % RING_BUFFER_SIZE;
-                state = Message;
-                edgeCount1 = 0;
-                edgeCount = this->config->msgSyncCnt;
-                return;
-            }
-            break;
-        case Message:
-            edgeCount++;
-            // A sync in message state is a second re-transmession of message
-            if (edgeCount1 || isSync((ringIndex - 1) % RING_BUFFER_SIZE)) {
-                edgeCount1++;
-                if (edgeCount > (this->config->msgBitsCnt * 2 * config->msgSamplesCnt + this->config->msgSyncCnt) )
-                {
-                    // and wait for msg to be picked up
-                    this->listenStop();
-                    received = true;
-                    return;
-                }
-            }
-            break;
+    // Protocols part way through a frame, and those this could be the first sync of.
+    // The others would only pass the pulse over.
+    IRProtocolMask run = activeProtocols | getSyncCandidates(duration);
+    for(uint8_t p = 0; run; p++, run >>= 1) {
+        if(!(run & 0x01)) continue;
+        IRMatcher &m = matchers[p];
+        matchPulse(m, duration);
+        if(m.state != Preamble || m.syncPos > 0) {
+            activeProtocols |= (1 << p);
+        } else {
+            activeProtocols &= ~(1 << p);
+        }
     }
 };
 
-uint8_t *IRLink::loop_chkMsgReceived() {
+uint8_t *IRLink::loop_chkMsgReceived(uint8_t *protocol) {
     byte *result = NULL;
-    unsigned int bitInMsg = 0;
+    uint8_t next = IR_NO_SLOT, nextProto = IR_NO_PROTOCOL;
 
-    if (received == true) {
-#ifdef DEBUG
-         Serial.print("preamble: ");
-         for(unsigned int i= 0; i < config->msgSyncCnt; i++) {
-             unsigned long v =  timings[(syncIndex1+RING_BUFFER_SIZE-config->msgSyncCnt+i+1) % RING_BUFFER_SIZE];
-             Serial.print(v); Serial.print(" ");
-         }
-         Serial.print("edgeCount: ");
-         Serial.print(edgeCount);
-         Serial.print(" edgeCount1: ");
-         Serial.println(edgeCount1);
-#endif
-        // Value output
-        for(unsigned int i=config->msgSyncCnt; i<(edgeCount-config->msgSyncCnt); i+=2) {
-            unsigned long t0 = timings[(syncIndex1+RING_BUFFER_SIZE-config->msgSyncCnt+i+1) % RING_BUFFER_SIZE]
-                ,         t1 = timings[(syncIndex1+RING_BUFFER_SIZE-config->msgSyncCnt+i+1+1) % RING_BUFFER_SIZE];
-
-#ifdef DEBUG
-            Serial.print(" ");
-            Serial.print(i);
-            Serial.print(" t0 ");
-            Serial.print(t0);
-            Serial.print(" t1 ");
-            Serial.print(t1);
-            Serial.println("");
-#endif
-            if (t1>(this->config->bitZeroLength.lo) && t1<(this->config->msgBreakLength.hi)) { // Highest and lowest possible of all
-                if (t1>this->config->bitZeroLength.lo && t1<this->config->bitZeroLength.hi) {
-                    // Do nothing as buffer is initialized to zero
-                    bitInMsg++;
-                }
-                if (t1>this->config->bitOneLength.lo && t1<this->config->bitOneLength.hi) {
-                    msgReceivedPtr[(short)(bitInMsg / BITS_IN_BYTE)] |=
-                        byteMask[(short)(bitInMsg % BITS_IN_BYTE)];
-                    bitInMsg++;
-                }
-                // All sync durations are longer than
-                if ((t1>this->config->msgBreakLength.lo && t1<this->config->msgBreakLength.hi) /* At synch signal == eot*/
-                    || (i >= (edgeCount1 - 1)) /* at end of message length */
-                ) {
-                    if( bitInMsg == this->config->msgBitsCnt) {
-                        result = msgReceivedPtr; // Set the return pointer, we got something
-                        // Advance to next valid space pulse
-                        i += config->msgSyncCnt;
-                    }
-                }
-            } else { // Non-compliant message, reset, start listening again
-                bitInMsg = 0;
-                result = NULL;
-                this->listen();
+    cli();
+    // Release the frame handed out last time, then take the oldest ready one of any protocol
+    for(uint8_t p = 0; p < protocolCnt; p++) {
+        IRMatcher &m = matchers[p];
+        for(uint8_t i = 0; i < IR_FRAME_SLOTS; i++) {
+            if(m.slotState[i] == SlotHeld) m.slotState[i] = SlotFree;
+            if(m.slotState[i] == SlotReady
+               && (next == IR_NO_SLOT
+                   || (uint8_t)(m.slotOrder[i] - matchers[nextProto].slotOrder[next]) > 0x7F)) {
+                next = i;
+                nextProto = p;
             }
         }
-        received = false;
-        state = Preamble;
-        lastTime = micros();
     }
+    if(next != IR_NO_SLOT) {
+        matchers[nextProto].slotState[next] = SlotHeld;
+        result = matchers[nextProto].frameSlots[next];
+    }
+    heldProto = nextProto;
+    heldSlot = next;
+    sei();
+    if(protocol) *protocol = nextProto;
+#ifdef DEBUG
+    if(result != NULL) {
+        Serial.print("protocol: ");
+        Serial.print(nextProto);
+        Serial.print(" dropped: ");
+        Serial.println(droppedFrames);
+    }
+#endif
     return result;
 }
 
-uint8_t IRLink::reverse(uint8_t b) {
-   b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
-   b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
-   b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
-   return b;
+unsigned long IRLink::getDroppedFrames() {
+    return droppedFrames;
 }
+
+#define IR_REV4(n)  IRLink::reverseBits(n), IRLink::reverseBits((n)+1), IRLink::reverseBits((n)+2), IRLink::reverseBits((n)+3)
+#define IR_REV16(n) IR_REV4(n), IR_REV4((n)+4), IR_REV4((n)+8), IR_REV4((n)+12)
+#define IR_REV64(n) IR_REV16(n), IR_REV16((n)+16), IR_REV16((n)+32), IR_REV16((n)+48)
+const uint8_t IRLink::reverseTable[256] IR_REVERSE_TABLE = {
+    IR_REV64(0), IR_REV64(64), IR_REV64(128), IR_REV64(192)
+};
+static_assert(IRLink::reverseBits(0x01) == 0x80 && IRLink::reverseBits(0xA4) == 0x25, "reverseBits");
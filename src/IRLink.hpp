@@ -11,19 +11,37 @@
 #else
 #include "Arduino.h"
 #endif
+#include "BuffWriter.hpp"
+
+// Send timer ticks per 1000 us, and the longest pulse the timer can count
+#if defined(__AVR__)
+    #define IR_SEND_ADJ_X1000 2069
+    #define IR_MAX_TICKS 0xFFFF /* OCR1A */
+    typedef unsigned short IRTicks;
+#else // defined(ESP8266)
+    #define IR_SEND_ADJ_X1000 5148
+    #define IR_MAX_TICKS 0x7FFFFF /* 23-bit FRC1 */
+    typedef uint32_t IRTicks;
+#endif
+
+// Bit reversal table kept in flash on AVR, where 256 bytes is much of the RAM
+#if defined(__AVR__)
+    #include <avr/pgmspace.h>
+    #define IR_REVERSE_TABLE PROGMEM
+    #define IR_REVERSE_READ(b) pgm_read_byte(&IRLink::reverseTable[(b)])
+#else // defined(ESP8266)
+    #define IR_REVERSE_TABLE
+    #define IR_REVERSE_READ(b) (IRLink::reverseTable[(b)])
+#endif
 
 #if defined(__AVR__)
-    // ring buffer size has to be large enough to fit
-    // data between two successive sync signals
     #if defined(__AVR_ATmega32U4__)
-        #define RING_BUFFER_SIZE  100 /* NOT MUCH ROOM! */
         #define ATmega32U4_ProMicroWiring(p) ( (p==0?2:(p==1?3:(p==2?1:(p==3?0:4)))) )
         #define IR_DDRPRT DDRD
         #define IR_SENDPORT PORTD
         #define IR_PINR 2
         #define IR_PINX 2
     #else
-        #define RING_BUFFER_SIZE  550
         #define IR_DDRPRT DDRA
         #define IR_SENDPORT PORTA
         #define IR_PINR PA3
@@ -32,15 +50,70 @@
 #else // defined(ESP8266)
     #define 	ESP_MAX_INTERRUPTS   16
     #define 	digitalPinToInterrupt(p)   ( (p) < ESP_MAX_INTERRUPTS ? (p) : -1 )
-    #define RING_BUFFER_SIZE  200
     #define IR_PINR 12 /*GPI12 - Pin D6*/
     #define IR_PINX 5 /*GPIO5 - Pin D1*/
 #endif
 
 #define TOLERANCE_PERCENT 0.25f
 
+// Timestamp edges from the CPU cycle counter (CCOUNT) on ESP8266, or a free
+// running Timer1 on AVR, rather than micros()
+//#define IR_CYCLE_TIMESTAMPS
+#define IR_MAX_PULSE_US 65000 // longer pulses are all reported as this
+
+// Histogram of received pulse widths per symbol, as a deviation from the
+// symbol's nominal length.  Bins are IR_HIST_STEP_PCT wide, centred on 0,
+// and the end bins take anything further out.  Costs RAM, so off on AVR.
+#if !defined(__AVR__)
+#define IR_PULSE_HISTOGRAM
+#endif
+#define IR_HIST_BINS 17
+#define IR_HIST_STEP_PCT 5
+typedef enum IRHistSymE {IRHistSync0, IRHistSync1, IRHistSep, IRHistZero, IRHistOne, IRHistBreak} IRHistSym;
+#define IR_HIST_SYMBOLS 6
+
 #define MAX_SYNCS 2
 
+// Received frames are double buffered, handler() keeps decoding into one
+// slot while the loop works on the other
+#define IR_FRAME_SLOTS 2
+#define IR_NO_SLOT 0xFF
+
+// Protocols decoded side by side from the one receive pin, each one has its
+// own matcher and frame slots.  A matcher is only given a pulse while it is
+// part way through a frame, or if the pulse could be its first sync going by
+// a table of sync lengths, so the cost per edge stays flat as protocols are added.
+#if defined(__AVR__)
+#define IR_MAX_PROTOCOLS 4
+#else
+#define IR_MAX_PROTOCOLS 8
+#endif
+#define IR_NO_PROTOCOL 0xFF
+typedef uint8_t IRProtocolMask; // Bit per protocol
+static_assert(IR_MAX_PROTOCOLS <= 8, "IRProtocolMask holds a bit per protocol");
+#define IR_SYNC_BUCKET_SHIFT 10 /* 1024 us per bucket */
+#define IR_SYNC_BUCKETS 64      /* to IR_MAX_PULSE_US, the last takes anything longer */
+
+// A frame is sent as a stream of 2-bit symbols, each one a pair of pulses
+// looked up in a per-protocol table of timer ticks.  A 0 tick entry is no
+// pulse, e.g. the second sync of a one sync protocol.
+typedef enum IRSymbolE {IRSymSync = 0, IRSymZero = 1, IRSymOne = 2, IRSymBreak = 3} IRSymbol;
+#define IR_SYMBOLS 4
+#define IR_SYMBOL_BITS 2
+#define IR_SYMBOLS_PER_BYTE (BITS_IN_BYTE / IR_SYMBOL_BITS)
+#define IR_SYMBOL_CNT(samp,msgbits,brk) ((samp) * (1 + (msgbits) + ((brk) > 0 ? 1 : 0)))
+#define IR_SYMBOL_BYTES(cnt) (((cnt) + IR_SYMBOLS_PER_BYTE - 1) / IR_SYMBOLS_PER_BYTE)
+typedef IRTicks IRSymbolTicks[2];
+
+// Frames waiting to be sent, a power of two.  Frames queued IRTxSupersede
+// replace the last frame still waiting if it is IRTxSupersede too, e.g. a
+// newer full state Command.  IRTxOrdered frames are always sent, in order.
+#define IR_TX_QUEUE 4
+typedef enum IRTxModeE {IRTxOrdered = 0, IRTxSupersede = 1} IRTxMode;
+
+// Called from loop_chkSendComplete() for each frame that has left the send pin
+typedef void (*IRSendCallback)();
+
 // Memory allocation function for containing message sent/received
 // Note: remainder test is for non-8-bit multiple message sizes
 #define MSGSIZE_BYTES(samp,msgbits) ((samp) * ((msgbits) % BITS_IN_BYTE > 0 ? 1 : 0) + (samp) * (msgbits) / BITS_IN_BYTE )
@@ -60,6 +133,14 @@ typedef struct IRPulseLengthUsS {
         hi = CALC_HI(_val);
         val = _val;
     }
+    IRPulseLengthUsS(unsigned short _val, unsigned short _lo, unsigned short _hi) {
+        lo = _lo;
+        hi = _hi;
+        val = _val;
+    }
+    bool inRange(unsigned long v) const {
+        return v >= lo && v <= hi;
+    }
     char *display(char *buf, int &pos) {
       #ifdef DEBUG
         pos = strlen(buf); sprintf(&(buf)[(pos)],"%d ",val);
@@ -103,18 +184,80 @@ typedef struct IRConfigS {
     }
 } IRConfig;
 
-typedef enum IRMsgStateE {Preamble, Message} IRMsgState;
+// Preamble - hunting for the sync pulses
+// Message  - separator/bit pulse pairs of a sample
+// Gap      - separator and break between samples, then the next sync
+typedef enum IRMsgStateE {Preamble, Message, Gap} IRMsgState;
+
+typedef enum IRSlotStateE {SlotFree, SlotFill, SlotReady, SlotHeld} IRSlotState;
+
+// Streaming decoder for one protocol, a pulse is classified as soon as its closing edge arrives
+typedef struct IRMatcherS {
+    IRConfig *config;
+    uint8_t *frameSlots[IR_FRAME_SLOTS];
+    volatile IRSlotState slotState[IR_FRAME_SLOTS];
+    volatile uint8_t slotOrder[IR_FRAME_SLOTS]; // arrival order of ready frames
+    uint8_t *fillPtr;        // slot being decoded into, NULL if none free
+    uint8_t fillSlot;        // IR_NO_SLOT if none free
+    unsigned int bitInMsg;   // bits written to fillPtr, all samples
+    uint8_t syncPos;         // sync pulses matched so far
+    uint8_t edgeCount;       // pulses since the sync (Message) or last bit (Gap)
+    bool bitPulse;           // next pulse is a bit, otherwise a separator
+    IRMsgState state;
+    int8_t *softSlots[IR_FRAME_SLOTS]; // confidence per bit, NULL unless enableSoftBits()
+    int8_t *softPtr;
+    unsigned short softMid;  // halfway between zero and one
+    unsigned short softScale; // confidence per us from softMid, << 8
+    unsigned short softLo, softHi, softSepHi; // outside the windows but still taken as a bit/separator
+#ifdef IR_PULSE_HISTOGRAM
+    uint16_t *hist;          // IR_HIST_SYMBOLS rows of IR_HIST_BINS
+    long histScale[IR_HIST_SYMBOLS]; // histogram steps per us of deviation, << 16
+#endif
+} IRMatcher;
 
 class IRLink {
 public:
     IRLink(IRConfig *_config, uint8_t ppinX = IR_PINX, uint8_t ppinR = IR_PINR);
     ~IRLink();
 
+    // Also recognise this protocol on the receive pin, _config is protocol 0.
+    // Returns the protocol number frames are tagged with, IR_NO_PROTOCOL if the table is full
+    uint8_t addProtocol(IRConfig *protoConfig);
+    IRConfig *getProtocol(uint8_t protocol);
+    // Protocols whose first sync pulse could be this long
+    static IRProtocolMask getSyncCandidates(unsigned long durationUs) {
+        return syncBuckets[durationUs >> IR_SYNC_BUCKET_SHIFT < IR_SYNC_BUCKETS
+                           ? durationUs >> IR_SYNC_BUCKET_SHIFT : IR_SYNC_BUCKETS - 1];
+    }
+
     // NOTE: caller owns memory pointed to and it is presumed to have enough
     // valid data to satisfy the IRConfig defintion of the message
     // Wait is for message to be sent.  Otherwise, if you call listen() right away, you'll get a
     // feedback loop (good for memory leak testing!)
+    // Queues msg behind any frame being sent, see sendAsync().
     void send(uint8_t *msg, bool noWait = false);
+    // Encodes msg into the send queue and returns, the timer interrupt starts each
+    // queued frame as the previous one ends.  False if the queue is full.
+    bool sendAsync(uint8_t *msg, IRTxMode mode = IRTxOrdered);
+    // Run the completion callback for frames sent since the last call
+    void loop_chkSendComplete();
+    void onSendComplete(IRSendCallback callback);
+    // Clock out count symbols (IRSymbol, packed 4 to a byte from the low bits) on the send
+    // pin, each expanded by the timer interrupt to the pulse pair ticks[symbol].  durationUs
+    // is the length of the whole frame, used to wait for it unless noWait.
+    // False, and nothing sent, while a frame is still going out.
+    static bool sendSymbols(const uint8_t *symbols, unsigned int count, const IRSymbolTicks *ticks,
+                            unsigned long durationUs, bool noWait);
+    static bool isSending();                 // send timer running, a frame going out
+    // From the send timer interrupt at the end of a frame, chains the next queued
+    // frame onto the running timer.  False if there is none.
+    static bool txNextFrame();
+    // From the send timer interrupt as a frame's first edge goes out
+    static void txFirstEdge();
+    static void putSymbol(uint8_t *symbols, unsigned int i, IRSymbol sym) {
+        uint8_t shift = (i % IR_SYMBOLS_PER_BYTE) * IR_SYMBOL_BITS;
+        symbols[i / IR_SYMBOLS_PER_BYTE] = (symbols[i / IR_SYMBOLS_PER_BYTE] & ~(0x03 << shift)) | (sym << shift);
+    }
 
     void listen(); // pin is re-defined for listening
     void listenStop(); // Stops interrupts, important for serial communication etc.
@@ -122,26 +265,83 @@ public:
     /// REturns NULL if no measurement otherwise memory buffer pointer to newly received message
     /// NOTE: DO NOT release this memory!  It is allocated once on class creation.
     /// (this is a change from prior code)
-    uint8_t *loop_chkMsgReceived();
+    /// Bits are decoded by handler() as each pulse arrives, so the message is complete
+    /// as soon as its last edge is seen.  Receiving carries on into the other frame slot
+    /// while the caller works on this one; the pointer stays valid until the next call.
+    /// If given, protocol is set to the number of the protocol that matched.
+    uint8_t *loop_chkMsgReceived(uint8_t *protocol = NULL);
     void handler();
 
+    // Keep a confidence for every bit of this protocol's frames, -127 (surely 0) to
+    // 127 (surely 1) from where the pulse fell between the zero and one lengths.
+    // Bit pulses a little outside both windows are then kept, at low confidence,
+    // rather than dropping the frame.  False if out of memory.
+    bool enableSoftBits(uint8_t protocol = 0);
+    // Confidences of the frame last returned by loop_chkMsgReceived(), NULL if not enabled
+    int8_t *getSoftBits();
+
+    // Frames lost because both slots were still waiting on loop_chkMsgReceived()
+    unsigned long getDroppedFrames();
+
+    // Pulse width histogram of a protocol, IR_HIST_SYMBOLS rows of IR_HIST_BINS counts,
+    // NULL without IR_PULSE_HISTOGRAM.  histogramToBuff() writes one row as JSON.
+    uint16_t *getHistogram(uint8_t protocol);
+    bool histogramToBuff(BuffWriter &out, uint8_t protocol, IRHistSym sym);
+    char *histogramToBuff(char *buf, size_t size, uint8_t protocol, IRHistSym sym);
+    void resetHistogram();
+
+    // Send queue: frames waiting or going out, frames replaced by a newer one,
+    // and time from sendAsync() to the frame's first edge (last and worst)
+    uint8_t getTxQueueDepth();
+    unsigned long getTxMerged();
+    unsigned long getTxLatencyUs();
+    unsigned long getTxMaxLatencyUs();
+
     static IRConfig *config;
+    static IRSymbolTicks sendTicks[IR_SYMBOLS]; // config pulse pairs in send timer ticks
     static uint8_t pinX, pinR; // Assignable send/receive pins
 
     // Utillity methods
-    static uint8_t reverse(uint8_t b);
+    static inline uint8_t reverse(uint8_t b) { return IR_REVERSE_READ(b); }
+    // As reverse(), for constants and building the table
+    static constexpr uint8_t reverseBits(uint8_t b) {
+        return (uint8_t)(((b & 0x01) << 7) | ((b & 0x02) << 5) | ((b & 0x04) << 3) | ((b & 0x08) << 1)
+                       | ((b & 0x10) >> 1) | ((b & 0x20) >> 3) | ((b & 0x40) >> 5) | ((b & 0x80) >> 7));
+    }
+    static const uint8_t reverseTable[256];
 private:
-    static volatile unsigned long timings[RING_BUFFER_SIZE];
     static volatile unsigned long lastTime;
-    static volatile unsigned int ringIndex;
-    static volatile unsigned int syncIndex1;  // index of the first sync signal
-    static volatile unsigned int edgeCount;
-    static volatile unsigned int edgeCount1; // Count of separate messages repeated
-    static volatile bool received; // Receive a single message
-    static volatile IRMsgState state;
-
-    bool isSyncInMsg(unsigned int idx);
-    bool isSync(unsigned int idx);
+    static IRMatcher matchers[IR_MAX_PROTOCOLS];
+    static uint8_t protocolCnt;
+    static IRProtocolMask syncBuckets[IR_SYNC_BUCKETS]; // protocols by first sync length
+    static IRProtocolMask activeProtocols; // matchers part way through a frame
+    static volatile uint8_t frameSeq;
+    static volatile unsigned long droppedFrames;
+    static volatile bool listening;
+    static uint8_t heldProto, heldSlot; // frame with the loop
+
+    static uint8_t *txSymbols[IR_TX_QUEUE + 1]; // encoded frames, the last one is encoded into next
+    static unsigned int txSymbolCnt[IR_TX_QUEUE + 1];
+    static IRTxMode txMode[IR_TX_QUEUE + 1];
+    static unsigned long txQueuedUs[IR_TX_QUEUE + 1];
+    static volatile uint8_t txHead;          // frame going out, free running
+    static volatile uint8_t txTail;          // next free, free running
+    static volatile uint8_t txDone;          // frames sent, free running
+    static uint8_t txDoneSeen;
+    static volatile bool txBusy;             // send timer running
+    static volatile bool txFromQueue;        // and the frame is txHead
+    static unsigned long txMerged;
+    static volatile unsigned long txLatencyUs, txMaxLatencyUs;
+    static IRSendCallback txCallback;
+
+    static unsigned int encode(uint8_t *msg, uint8_t *symbols);
+
+    static void resetDecoder(IRMatcher &m);
+    static void claimSlot(IRMatcher &m);
+    static void huntSync(IRMatcher &m, unsigned long duration);
+    static void matchPulse(IRMatcher &m, unsigned long duration);
+    static void histPulse(IRMatcher &m, IRHistSym sym, unsigned long duration);
+    static IRPulseLengthUs *histSymbol(IRConfig *cfg, IRHistSym sym);
 };
 
 #endif /* IRLink_hpp */
@@ -0,0 +1,256 @@
+//
+//  IRLinkT.hpp
+//
+//  IRLink specialised at compile time on one protocol, see IRProtocol.hpp.
+//  Tolerance windows, frame size and send ticks are constants of the protocol
+//  so handler() compares against immediates, and received frames go into a
+//  ring of Frames slots (a power of two) indexed by mask.
+//
+//  Each IRLinkT<P> has its own static state, so two protocols can be decoded
+//  from one pin by feeding the same pulse to both :
+//
+//      void bothHandler() {
+//          unsigned long d = IRLinkT<SenvilleAURAProtocol>::pulseLength();
+//          IRLinkT<SenvilleAURAProtocol>::pulse(d);
+//          IRLinkT<NECProtocol>::pulse(d);
+//      }
+//      IRLinkT<SenvilleAURAProtocol>::listen(bothHandler);
+//
+//  Sending shares the one Timer1 with IRLink through IRLink::sendSymbols().
+//
+
+#ifndef IRLinkT_hpp
+#define IRLinkT_hpp
+
+#include "IRLink.hpp"
+#include "IRProtocol.hpp"
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+// Largest receive ring, all frames of a protocol, in bytes
+#define IR_RING_MAX_BYTES 256
+
+template<class P, uint8_t Frames = IR_FRAME_SLOTS>
+class IRLinkT {
+public:
+    enum {
+        FrameBytes = MSGSIZE_BYTES(P::Samples, P::Bits),
+        FrameMask = Frames - 1,
+        SymbolCnt = IRFrameSize<P>::symbols(),
+        SymbolBytes = IR_SYMBOL_BYTES(IRFrameSize<P>::symbols()),
+        HasBreak = P::Break::val() > 0
+    };
+
+    static_assert(Frames > 0 && (Frames & (Frames - 1)) == 0, "IRLinkT frame ring size must be a power of two");
+    static_assert(Frames <= 128, "IRLinkT frame ring is counted in uint8_t");
+    static_assert((unsigned long)FrameBytes * Frames <= IR_RING_MAX_BYTES, "IRLinkT frame ring is larger than IR_RING_MAX_BYTES");
+    static_assert(P::Syncs >= 1 && P::Syncs <= MAX_SYNCS, "protocol sync count must be 1..MAX_SYNCS");
+    static_assert(P::Bits > 0 && P::Samples > 0, "protocol has no bits");
+    static_assert(P::Zero::hi() < P::One::lo() || P::One::hi() < P::Zero::lo(), "protocol zero and one windows overlap");
+    static_assert(P::Sync0::ticks() <= IR_MAX_TICKS && P::Sync1::ticks() <= IR_MAX_TICKS
+                  && P::Sep::ticks() <= IR_MAX_TICKS && P::Zero::ticks() <= IR_MAX_TICKS
+                  && P::One::ticks() <= IR_MAX_TICKS && P::Break::ticks() <= IR_MAX_TICKS,
+                  "protocol pulse is longer than the send timer can count");
+
+    IRLinkT(uint8_t ppinX = IR_PINX, uint8_t ppinR = IR_PINR) {
+        IRLink::pinX = ppinX;
+        IRLink::pinR = ppinR;
+        if(ppinX != ppinR) {
+            pinMode(ppinX, OUTPUT);
+            digitalWrite(ppinX,HIGH);
+        }
+    }
+
+    // Runtime description of P, e.g. for IRLink::addProtocol()
+    static IRConfig *getIRConfig() {
+        static IRConfig config = IRProtocolConfig<P>();
+        return &config;
+    }
+
+    // msg holds FrameBytes, see IRLink::send().  False if a frame is still going out.
+    static bool send(const uint8_t *msg, bool noWait = false) {
+        unsigned int sym = 0, bit = 0;
+        // symbols may be the frame on the timer now, keep it until that is out
+        if(IRLink::isSending()) return false;
+        for(uint8_t samp = 0; samp < P::Samples; samp++) {
+            IRLink::putSymbol(symbols, sym++, IRSymSync);
+            for(uint8_t b = 0; b < P::Bits; b++, bit++) {
+                IRLink::putSymbol(symbols, sym++, (msg[bit / BITS_IN_BYTE] & (0x80 >> (bit % BITS_IN_BYTE)))
+                                                  ? IRSymOne : IRSymZero);
+            }
+            if(HasBreak) IRLink::putSymbol(symbols, sym++, IRSymBreak);
+        }
+        return IRLink::sendSymbols(symbols, sym, sendTicks, IRFrameSize<P>::durationUs(), noWait);
+    }
+
+    // isr is the pin change handler, handler() unless several protocols share the pin
+    static void listen(void (*isr)() = handler) {
+        if(!listening) {
+            resetDecoder();
+            lastTime = micros();
+        }
+        listening = true;
+        attachInterrupt(digitalPinToInterrupt(IRLink::pinR), isr, CHANGE);
+        pinMode(IRLink::pinR, INPUT);
+    }
+    static void listenStop() {
+        listening = false;
+        detachInterrupt(digitalPinToInterrupt(IRLink::pinR));
+    }
+
+    /// Returns NULL if no frame otherwise the oldest one received.  It stays valid
+    /// until the next call, which hands its slot back to the ring.
+    static uint8_t *loop_chkMsgReceived() {
+        uint8_t *result = NULL;
+        cli();
+        if(held) {
+            tail++;
+            held = false;
+        }
+        if(head != tail) {
+            result = frames[tail & FrameMask];
+            held = true;
+        }
+        sei();
+        return result;
+    }
+
+    // Frames lost because the ring was full
+    static unsigned long getDroppedFrames() {
+        return droppedFrames;
+    }
+
+    // Time since the last edge, us
+    static unsigned long pulseLength() {
+        unsigned long time = micros();
+        unsigned long duration = diffRollSafeUnsignedLong(lastTime,time);
+        lastTime = time;
+        return duration;
+    }
+
+    static void IRAM_ATTR handler() {
+        pulse(pulseLength());
+    }
+
+    // Decode one pulse, as IRLink::matchPulse() with the windows of P
+    static void pulse(unsigned long duration) {
+        switch(state) {
+            case Gap:
+                // Separator and break, then the sync of the next sample is expected
+                if(++edgeCount > P::Syncs + 2) {
+                    resetDecoder();
+                }
+                huntSync(duration);
+                break;
+            case Preamble:
+                huntSync(duration);
+                break;
+            case Message:
+                if(!bitPulse) {
+                    if(P::Sep::inRange(duration)) {
+                        bitPulse = true;
+                        edgeCount++;
+                    } else if(edgeCount == 0 && syncInRange(P::Syncs - 1, duration)) {
+                        // Last sync pulse matched twice, the message starts after this one
+                    } else { // Non-compliant message, start over
+                        resetDecoder();
+                        huntSync(duration);
+                    }
+                    break;
+                }
+                bitPulse = false;
+                edgeCount++;
+                if(fillPtr && (bitInMsg % BITS_IN_BYTE) == 0) fillPtr[bitInMsg / BITS_IN_BYTE] = 0;
+                if(P::One::inRange(duration)) {
+                    if(fillPtr) fillPtr[bitInMsg / BITS_IN_BYTE] |= 0x80 >> (bitInMsg % BITS_IN_BYTE);
+                } else if(!P::Zero::inRange(duration)) { // Non-compliant message, start over
+                    resetDecoder();
+                    huntSync(duration);
+                    break;
+                }
+                bitInMsg++;
+                if((bitInMsg % P::Bits) == 0) {
+                    if(bitInMsg >= (unsigned int)P::Bits * P::Samples) {
+                        // Publish the frame to the loop
+                        if(fillPtr) head++;
+                        else droppedFrames++;
+                        resetDecoder();
+                    } else {
+                        state = Gap;
+                        edgeCount = 0;
+                    }
+                }
+                break;
+        }
+    }
+
+private:
+    static uint8_t frames[Frames][FrameBytes];
+    static volatile uint8_t head;   // frames decoded, free running
+    static volatile uint8_t tail;   // frames handed back by the loop, free running
+    static bool held;               // frame at tail is with the loop
+    static uint8_t symbols[SymbolBytes];
+    static const IRSymbolTicks sendTicks[IR_SYMBOLS];
+
+    static volatile unsigned long lastTime;
+    static volatile unsigned long droppedFrames;
+    static volatile bool listening;
+    static uint8_t *fillPtr;        // NULL if the ring was full when the frame started
+    static unsigned int bitInMsg;
+    static uint8_t syncPos;
+    static uint8_t edgeCount;
+    static bool bitPulse;
+    static IRMsgState state;
+
+    static bool syncInRange(uint8_t i, unsigned long duration) {
+        return i == 0 ? P::Sync0::inRange(duration) : P::Sync1::inRange(duration);
+    }
+    static void resetDecoder() {
+        state = Preamble;
+        syncPos = 0;
+        edgeCount = 0;
+        bitInMsg = 0;
+        bitPulse = false;
+    }
+    static void huntSync(unsigned long duration) {
+        if(syncInRange(syncPos, duration)) {
+            syncPos++;
+        } else {
+            syncPos = P::Sync0::inRange(duration) ? 1 : 0;
+        }
+        if(syncPos == P::Syncs) {
+            state = Message;
+            syncPos = 0;
+            edgeCount = 0;
+            bitPulse = false;
+            if(bitInMsg == 0) {
+                fillPtr = (uint8_t)(head - tail) < Frames ? frames[head & FrameMask] : NULL;
+            }
+        }
+    }
+};
+
+template<class P, uint8_t F> uint8_t IRLinkT<P,F>::frames[F][IRLinkT<P,F>::FrameBytes];
+template<class P, uint8_t F> volatile uint8_t IRLinkT<P,F>::head = 0;
+template<class P, uint8_t F> volatile uint8_t IRLinkT<P,F>::tail = 0;
+template<class P, uint8_t F> bool IRLinkT<P,F>::held = false;
+template<class P, uint8_t F> uint8_t IRLinkT<P,F>::symbols[IRLinkT<P,F>::SymbolBytes];
+template<class P, uint8_t F> const IRSymbolTicks IRLinkT<P,F>::sendTicks[IR_SYMBOLS] = {
+    {(IRTicks)P::Sync0::ticks(), (IRTicks)(P::Syncs > 1 ? P::Sync1::ticks() : 0)},
+    {(IRTicks)P::Sep::ticks(), (IRTicks)P::Zero::ticks()},
+    {(IRTicks)P::Sep::ticks(), (IRTicks)P::One::ticks()},
+    {(IRTicks)P::Sep::ticks(), (IRTicks)P::Break::ticks()}
+};
+template<class P, uint8_t F> volatile unsigned long IRLinkT<P,F>::lastTime = 0;
+template<class P, uint8_t F> volatile unsigned long IRLinkT<P,F>::droppedFrames = 0;
+template<class P, uint8_t F> volatile bool IRLinkT<P,F>::listening = false;
+template<class P, uint8_t F> uint8_t *IRLinkT<P,F>::fillPtr = NULL;
+template<class P, uint8_t F> unsigned int IRLinkT<P,F>::bitInMsg = 0;
+template<class P, uint8_t F> uint8_t IRLinkT<P,F>::syncPos = 0;
+template<class P, uint8_t F> uint8_t IRLinkT<P,F>::edgeCount = 0;
+template<class P, uint8_t F> bool IRLinkT<P,F>::bitPulse = false;
+template<class P, uint8_t F> IRMsgState IRLinkT<P,F>::state = Preamble;
+
+#endif /* IRLinkT_hpp */
@@ -6,16 +6,7 @@
 IRConfig IRNECRemote::config;
 
 IRNECRemote::IRNECRemote() {
-    config.msgSamplesCnt = MESSAGE_SAMPLES;
-    config.msgBitsCnt = MESSAGE_BITS;
-    config.msgSyncCnt = MESSAGE_SYNC_BITS;
-    config.syncLengths[0] = IRPulseLengthUsS(SYNC_PREAMBLE_0);
-    config.syncLengths[1] = IRPulseLengthUsS(SYNC_PREAMBLE_1);
-
-    config.bitSeparatorLength = IRPulseLengthUsS(SEP_LENGTH0);
-    config.bitZeroLength = IRPulseLengthUsS(BIT0_LENGTH);
-    config.bitOneLength = IRPulseLengthUsS(BIT1_LENGTH);
-    config.msgBreakLength = IRPulseLengthUsS(EOT_LENGTH);
+    config = IRProtocolConfig<NECProtocol>();
 };
 IRConfig *IRNECRemote::getIRConfig() {
     return (IRConfig *)&config;
@@ -25,13 +16,16 @@ IRConfig *IRNECRemote::getIRConfig() {
 bool IRNECRemote::isValid(uint8_t *msg, bool setCRC) {
     // Test that each pair of bytes is inverse of the next
     if( (msg[2] & 0xFF) == (~msg[3] & 0xff)) {
-        memmove(message, msg, MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) * sizeof(uint8_t));
+        memmove(message, msg, MSGSIZE_BYTES(NEC_MESSAGE_SAMPLES,NEC_MESSAGE_BITS) * sizeof(uint8_t));
         message[0] = IRLink::reverse(message[0]);
         message[1] = IRLink::reverse(message[1]);
         return true;
     }
     return false;
 }
+bool IRNECRemote::isValidSoft(uint8_t *msg, const int8_t * /*soft*/) {
+    return this->isValid(msg);
+}
 // Return message content
 irMsg IRNECRemote::getMessage() {
     irMsg v;
@@ -49,12 +43,18 @@ uint8_t *IRNECRemote::rawMessage() {
     return message;
 }
 
-char *IRNECRemote::toBuff(char *buf) {
+bool IRNECRemote::toBuff(BuffWriter &out) {
     irMsg m = this->getMessage();
-    int pos = 0;
-    sprintf(buf,"0x");
-    pos = strlen(buf); sprintf(&(buf)[(pos)],"%04hX ", m.addr);
-    pos = strlen(buf); sprintf(&(buf)[(pos)],"%02hX ", m.cmd);
-    pos = strlen(buf);
+    out.str("0x").hex(m.addr, 4).chr(' ').hex(m.cmd, 2).chr(' ');
+    return !out.overflow();
+}
+char *IRNECRemote::toBuff(char *buf, size_t size) {
+    BuffWriter out(buf, size);
+    this->toBuff(out);
     return buf;
 }
+bool IRNECRemote::toJsonBuff(BuffWriter &out) {
+    irMsg m = this->getMessage();
+    out.str("{Addr:").unum(m.addr).str(" , Cmd:").unum(m.cmd).str(" }");
+    return !out.overflow();
+}
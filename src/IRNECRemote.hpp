@@ -9,22 +9,26 @@
 #endif
 
 #include "IRLink.hpp"
+#include "IRProtocol.hpp"
 
 // Command message
-#define MESSAGE_SAMPLES 1
-#define MESSAGE_BITS 32 /*  Message is 4-bytes, first byte is Addr, second byte is Addr inverted,
+#define NEC_MESSAGE_SAMPLES 1
+#define NEC_MESSAGE_BITS 32 /*  Message is 4-bytes, first byte is Addr, second byte is Addr inverted,
                             third byte is Cmd, fourth byte is Cmd inverted.  This count includes spaces. */
-#define MESSAGE_SYNC_BITS 2
-#define SYNC_PREAMBLE_0  9000.0
-#define SYNC_PREAMBLE_1  4560.0
+#define NEC_MESSAGE_SYNC_BITS 2
 
-#define SEP_LENGTH0  560.0
-#define BIT0_LENGTH  560.0
-#define BIT1_LENGTH 1680.0
-#define EOT_LENGTH  40000.0
-
-// Repeat message -- different preamble then an EOT pulse
-#define SYNC_PREAMBLE_1A  2280.0
+// Pulse timings, us
+struct NECProtocol {
+    enum { Samples = NEC_MESSAGE_SAMPLES, Bits = NEC_MESSAGE_BITS, Syncs = NEC_MESSAGE_SYNC_BITS, TolerancePct = 25 };
+    typedef IRPulse< 9000,TolerancePct> Sync0;
+    typedef IRPulse< 4560,TolerancePct> Sync1;
+    typedef IRPulse<  560,TolerancePct> Sep;
+    typedef IRPulse<  560,TolerancePct> Zero;
+    typedef IRPulse< 1680,TolerancePct> One;
+    typedef IRPulse<40000,TolerancePct> Break;
+    // Repeat message -- different preamble then an EOT pulse
+    typedef IRPulse< 2280,TolerancePct> SyncRepeat1;
+};
 
 typedef struct irMsgS {
     uint16_t addr;
@@ -70,7 +74,7 @@ typedef struct irMsgS {
 class IRNECRemote {
 private:
     static IRConfig config;
-    uint8_t message[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+    uint8_t message[MSGSIZE_BYTES(NEC_MESSAGE_SAMPLES,NEC_MESSAGE_BITS)];
 
 public:
     IRNECRemote();
@@ -79,12 +83,16 @@ public:
 
     // If msg is valid, it is copied locally into the class
     bool isValid(uint8_t *msg, bool setCRC = false);
+    // As above, there is nothing to decide from the bit confidences
+    bool isValidSoft(uint8_t *msg, const int8_t *soft);
     irMsg getMessage();
     void setMessage(irMsg m);
 
     uint8_t *rawMessage();
 
-    char *toBuff(char *buf);
+    bool toBuff(BuffWriter &out);
+    char *toBuff(char *buf, size_t size);
+    bool toJsonBuff(BuffWriter &out);
 };
 
 #endif //IRNECRemote_hpp
@@ -0,0 +1,96 @@
+//
+//  IRProtocol.hpp
+//
+//  Compile time description of an IR protocol.  A protocol is a traits struct,
+//  e.g. SenvilleAURAProtocol, with its counts as enum values and each pulse as
+//  an IRPulse<> type so the tolerance windows and send timer ticks are integer
+//  constants rather than float products worked out per edge.
+//
+//  struct MyProtocol {
+//      enum { Samples = 1, Bits = 32, Syncs = 2, TolerancePct = 25 };
+//      typedef IRPulse<9000,TolerancePct> Sync0;
+//      typedef IRPulse<4560,TolerancePct> Sync1;  // IRPulse<0> if Syncs is 1
+//      typedef IRPulse<560,TolerancePct>  Sep;
+//      typedef IRPulse<560,TolerancePct>  Zero;
+//      typedef IRPulse<1680,TolerancePct> One;
+//      typedef IRPulse<40000,TolerancePct> Break; // IRPulse<0> if there is none
+//  };
+//
+
+#ifndef IRProtocol_hpp
+#define IRProtocol_hpp
+
+#include "IRLink.hpp"
+
+template<unsigned long Us, unsigned int TolPct = 25>
+struct IRPulse {
+    static constexpr unsigned long val() { return Us; }
+    static constexpr unsigned long lo() { return Us * (100 - TolPct) / 100; }
+    static constexpr unsigned long hi() { return Us * (100 + TolPct) / 100; }
+    // Send timer ticks, rounded
+    static constexpr unsigned long ticks() { return (Us * IR_SEND_ADJ_X1000 + 500) / 1000; }
+    static bool inRange(unsigned long v) { return v >= lo() && v <= hi(); }
+    static IRPulseLengthUs length() { return IRPulseLengthUsS(Us, lo(), hi()); }
+};
+
+// Bytes and send symbols in one frame of protocol P
+template<class P>
+struct IRFrameSize {
+    static constexpr unsigned int bytes() { return MSGSIZE_BYTES(P::Samples, P::Bits); }
+    static constexpr unsigned int symbols() { return IR_SYMBOL_CNT(P::Samples, P::Bits, P::Break::val()); }
+    static constexpr unsigned long durationUs() {
+        // Bits are counted as ones, the longest the frame can take
+        return P::Samples * (P::Sync0::val() + (P::Syncs > 1 ? P::Sync1::val() : 0)
+                             + P::Bits * (P::Sep::val() + P::One::val())
+                             + (P::Break::val() > 0 ? P::Sep::val() + P::Break::val() : 0));
+    }
+};
+
+// A value in one sample of a frame, value = ((byte & Mask) >> Shift) + Offset
+template<uint8_t Byte, uint8_t Mask, uint8_t Shift = 0, int Offset = 0>
+struct IRField {
+    static uint8_t get(const uint8_t *sample) { return ((sample[Byte] & Mask) >> Shift) + Offset; }
+    static void set(uint8_t *sample, long v) {
+        sample[Byte] = (sample[Byte] & ~Mask) | ((uint8_t)((v - Offset) << Shift) & Mask);
+    }
+};
+
+enum IRFieldFlags : uint8_t {
+    IRFieldReadOnly = 0x01, // Decoded only, e.g. the instruction
+    IRFieldCmdOnly  = 0x02, // Goes into a command frame, not the kept state
+    IRFieldNeedsOn  = 0x04, // Left as is while the unit is off
+    IRFieldZeroElse = 0x08  // Set to its lowest value outside its modes, rather than left
+};
+
+// IRField at run time, plus what a brand's JSON and validation need of it.  A brand
+// lists its fields once as an X-macro, see SENVILLE_FIELDS, to get both.
+typedef struct IRFieldDescS {
+    uint8_t byte, mask, shift;
+    int16_t offset, max;    // Valid values are offset to max
+    uint8_t instrs;         // Instructions the field is part of
+    uint8_t modes;          // Bit per mode it can be set in
+    uint8_t flags;          // IRFieldFlags
+    uint8_t get(const uint8_t *sample) const { return ((sample[byte] & mask) >> shift) + offset; }
+    void set(uint8_t *sample, long v) const {
+        sample[byte] = (sample[byte] & ~mask) | ((uint8_t)((v - offset) << shift) & mask);
+    }
+    bool valid(long v) const { return v >= offset && v <= max; }
+} IRFieldDesc;
+
+// Runtime description, for IRLink and anything else still taking an IRConfig
+template<class P>
+IRConfig IRProtocolConfig() {
+    IRConfig c;
+    c.msgSamplesCnt = P::Samples;
+    c.msgBitsCnt = P::Bits;
+    c.msgSyncCnt = P::Syncs;
+    c.syncLengths[0] = P::Sync0::length();
+    c.syncLengths[1] = P::Sync1::length();
+    c.bitSeparatorLength = P::Sep::length();
+    c.bitZeroLength = P::Zero::length();
+    c.bitOneLength = P::One::length();
+    c.msgBreakLength = P::Break::length();
+    return c;
+}
+
+#endif /* IRProtocol_hpp */
@@ -2,43 +2,69 @@
 //  SenvilleAURA.cpp
 //
 #include <stdlib.h>
+#include <limits.h>
 #include "SenvilleAURA.hpp"
-#include <ArduinoJson.h>
 //#define SHOW_RAWDATA
 //#define DEBUG
 
-#define JSON_PARSEBUFFER 512
-
-// Json command/stat strings
-#define CMD_ISON    "IsOn"
-#define CMD_INSTR   "Instr"
-#define CMD_MODE    "Mode"
-#define CMD_FSPD    "FanSpeed"
-#define CMD_SLP     "IsSleepOn"
-#define CMD_STMP    "SetTemp"
+// Json stat strings
 #define STAT_SMPLID "SampleId"
 #define STAT_ONTME  "OnTimeMs"
-#define CMD_MTMP    "MeasTemp"
-#define CMD_STATE   "State"
-#define CMD_MTMP    "MeasTemp"
-#define CMD_MTMP    "MeasTemp"
-#define CMD_OPT     "Opt"
 #define STAT_RAW    "Unknown"
 
-uint8_t calcChecksum(const uint8_t state[],
-                                  const uint16_t length) {
-    uint8_t checksum = 0;
-#ifdef DEBUG
-    Serial.print("len ");
-    Serial.println(length);
-#endif
-    for (uint8_t i = 0; i < length; i++) {
-            checksum += IRLink::reverse(state[i]);
-#ifdef DEBUG
-        Serial.printf("crc val %0X\n",state[i]);
-#endif
+#define SENVILLE_FIELD_DESC(name, json, byte, mask, shift, offset, max, instrs, modes, flags) \
+    {byte, mask, shift, offset, max, instrs, modes, flags},
+#define SENVILLE_KEY_NAME(name, json, ...) json,
+const IRFieldDesc SenvilleAURA::fields[SENVILLE_FIELD_CNT] = { SENVILLE_FIELDS(SENVILLE_FIELD_DESC) };
+const char *SenvilleAURA::keyNames[SENVILLE_KEYS] = { SENVILLE_FIELDS(SENVILLE_KEY_NAME) SENVILLE_STATS(SENVILLE_KEY_NAME) };
+
+// SenvilleKey by SENVILLE_KEY_HASH(), worked out at compile time.  The hash is
+// perfect over the keys of SENVILLE_FIELDS and SENVILLE_STATS, so a name is
+// looked up with one compare; a new key that collides fails the build.
+#define SENVILLE_KEY_SLOT(name, json, ...) SENVILLE_KEY_HASH(sizeof(json) - 1, json[0], json[sizeof(json) - 2]),
+static constexpr uint8_t cmdKeySlot[SENVILLE_KEYS] = { SENVILLE_FIELDS(SENVILLE_KEY_SLOT) SENVILLE_STATS(SENVILLE_KEY_SLOT) };
+typedef struct KeyHashS {
+    uint8_t key[SENVILLE_KEY_SLOTS];  // SenvilleKey in its slot, 0xff for none
+} KeyHash;
+static constexpr bool keyHashPerfect() {
+    for(uint8_t i = 0; i < SENVILLE_KEYS; i++) {
+        for(uint8_t j = i + 1; j < SENVILLE_KEYS; j++) if(cmdKeySlot[i] == cmdKeySlot[j]) return false;
     }
-    return checksum - 0x01;
+    return true;
+}
+static constexpr KeyHash buildKeyHash() {
+    KeyHash h = {};
+    for(uint8_t i = 0; i < SENVILLE_KEY_SLOTS; i++) h.key[i] = 0xff;
+    for(uint8_t k = 0; k < SENVILLE_KEYS; k++) h.key[cmdKeySlot[k]] = k;
+    return h;
+}
+static_assert(keyHashPerfect(), "two keys share a SENVILLE_KEY_HASH() slot, change the hash");
+static constexpr KeyHash cmdKeyHash = buildKeyHash();
+static uint8_t findKey(const char *key, size_t len) {
+    uint8_t k = cmdKeyHash.key[SENVILLE_KEY_HASH(len, key[0], key[len-1])];
+    if(k != 0xff && strncmp(SenvilleAURA::keyNames[k], key, len) == 0 && SenvilleAURA::keyNames[k][len] == 0x00) return k;
+    return 0xff;
+}
+
+// Sum of the bit reversed state bytes less one, inverted and reversed back
+uint8_t SenvilleAURA::frameCRC(const uint8_t *sample, uint8_t invert) {
+    uint8_t checksum = 0xFF;
+    for (uint8_t i = 0; i < MSG_CRC(0); i++) {
+        checksum += IRLink::reverse(sample[i] ^ invert);
+    }
+    return IRLink::reverse(~checksum);
+}
+uint8_t SenvilleAURA::checkFrame(const uint8_t *msg) {
+    uint8_t result = FrameOk;
+    if(frameCRC(msg) != msg[MSG_CRC(0)]) result |= FrameCRC0;
+    if(frameCRC(&msg[MSG_CONST_STATE(1)], 0xFF) != (uint8_t)~msg[MSG_CRC(1)]) result |= FrameCRC1;
+    for(uint8_t i = 0; i < MSG_CONST_STATE(1); i++) {
+        if((uint8_t)(msg[i] ^ msg[MSG_CONST_STATE(1) + i]) != 0xFF) {
+            result |= FrameSamplesDiffer;
+            break;
+        }
+    }
+    return result;
 }
 
 ////////
@@ -46,25 +72,25 @@ uint8_t calcChecksum(const uint8_t state[],
 ////////
 IRConfig SenvilleAURA::config;
 
-uint8_t SenvilleAURA::calcCRC(short _sample) {
-    return IRLink::reverse(~(calcChecksum(&message[MSG_CONST_STATE(_sample)], MSG_CONST_STATE(1)-1)));
+uint8_t SenvilleAURA::calcCRC(const uint8_t *msg, short _sample) {
+    return frameCRC(&msg[MSG_CONST_STATE(_sample)]);
+}
+uint8_t *SenvilleAURA::finishFrame(uint8_t *msg) {
+    msg[MSG_CRC(0)] = frameCRC(msg);
+    for(int ptr=0; ptr < MSG_CONST_STATE(1); ptr++ )
+        msg[MSG_CONST_STATE(1)+ptr] = ~msg[ptr];
+    return msg;
 }
 SenvilleAURA::SenvilleAURA() {
-    config.msgSamplesCnt = MESSAGE_SAMPLES;
-    config.msgBitsCnt = MESSAGE_BITS;
-    config.msgSyncCnt = MESSAGE_SYNC_BITS;
-    config.syncLengths[0] = IRPulseLengthUsS(SYNC_PREAMBLE_0);
-    config.syncLengths[1] = IRPulseLengthUsS(SYNC_PREAMBLE_1);
-
-    config.bitSeparatorLength = IRPulseLengthUsS(SEP_LENGTH0);
-    config.bitZeroLength = IRPulseLengthUsS(BIT0_LENGTH);
-    config.bitOneLength = IRPulseLengthUsS(BIT1_LENGTH);
-    config.msgBreakLength = IRPulseLengthUsS(EOT_LENGTH);
+    config = IRProtocolConfig<SenvilleAURAProtocol>();
 
     this->sampleId = 0;
     this->lastSampleMs = 0;
     this->setTempDegC = 0;
     this->validSamplePtr = 0;
+    this->softRecovered = 0;
+    this->publishedHas = 0;
+    memset(this->command, 0, sizeof(this->command));
 };
 IRConfig *SenvilleAURA::getIRConfig() {
     return (IRConfig *)&config;
@@ -80,173 +106,303 @@ bool SenvilleAURA::isValid(uint8_t *msg, bool setCRC) {
         if(!msg[MSG_CONST_STATE(this->validSamplePtr)] & 0xA0)
             return false;
     }
-#ifdef DEBUG
-    Serial.print("cnt "); Serial.println(MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) * sizeof(uint8_t) );
-#endif
-    memmove(message, msg, MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) * sizeof(uint8_t));
 #ifdef DEBUG
     Serial.print("ptr "); Serial.println(this->validSamplePtr);
 #endif
-    calcCRC = SenvilleAURA::calcCRC(this->validSamplePtr);
+    calcCRC = SenvilleAURA::calcCRC(msg, this->validSamplePtr);
 #ifdef DEBUG
     Serial.printf("crc %0X\n",calcCRC);
 #endif
+    // The state is only taken from a frame that checks out
     if(setCRC || calcCRC == msg[MSG_CRC(this->validSamplePtr)]) {
+        memmove(message, msg, MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) * sizeof(uint8_t));
         if(setCRC) message[MSG_CRC(this->validSamplePtr)] = calcCRC;
+        if(this->getInstructionType() == Instruction::Command) {
+            memcpy(command, this->sample(), MSG_CONST_STATE(1) * sizeof(uint8_t));
+            finishFrame(command);
+        }
         this->sampleId++;
         this->lastSampleMs = millis();
         return true;
     }
     return false;
 }
-uint8_t *SenvilleAURA::getMessage() {
-    // If second msg is being used, copy to first spot
-    if(this->validSamplePtr) {
-        memmove(message, &message[MSG_CONST_STATE(this->validSamplePtr)],
-            MSG_CONST_STATE(1) * sizeof(uint8_t));
+bool SenvilleAURA::isValidSoft(uint8_t *msg, const int8_t *soft) {
+    if(this->isValid(msg)) return true;
+    if(soft == NULL || !this->softDecide(msg, soft)) return false;
+    this->softRecovered++;
+    return this->isValid(msg);
+}
+
+// The second sample is the first inverted, so each bit is sent once as is and
+// once inverted.  Decide it from the difference of the two confidences, then
+// the CRC has the last word, with the least sure bits also tried flipped.
+bool SenvilleAURA::softDecide(uint8_t *msg, const int8_t *soft) {
+    uint8_t base[MSG_CONST_STATE(1)], trial[MSG_CONST_STATE(1)];
+    uint8_t weak[SOFT_CHASE_BITS];
+    int weakConf[SOFT_CHASE_BITS];
+    uint8_t weakCnt = 0, i;
+
+    memset(base, 0, sizeof(base));
+    for(uint8_t bit = 0; bit < MESSAGE_BITS; bit++) {
+        int conf = (int)soft[bit] - (int)soft[MESSAGE_BITS + bit];
+        if(conf > 0) base[bit / BITS_IN_BYTE] |= 0x80 >> (bit % BITS_IN_BYTE);
+        if(conf < 0) conf = -conf;
+        if(conf >= SOFT_WEAK) continue;
+        // Keep the least sure, replacing the surest of those kept
+        if(weakCnt < SOFT_CHASE_BITS) {
+            i = weakCnt++;
+        } else {
+            i = 0;
+            for(uint8_t j = 1; j < SOFT_CHASE_BITS; j++) if(weakConf[j] > weakConf[i]) i = j;
+            if(weakConf[i] <= conf) continue;
+        }
+        weak[i] = bit;
+        weakConf[i] = conf;
     }
-    // copy from first to second spot and also reversing the bits
-    for(int ptr=0; ptr < MSG_CONST_STATE(1); ptr++ )
-        message[MSG_CONST_STATE(1)+ptr] = ~message[ptr];
-    // Update the CRCs
-    message[MSG_CRC(0)] = SenvilleAURA::calcCRC(0);
-    message[MSG_CRC(1)] = ~message[MSG_CRC(0)];
-    return message;
-}
-#define APND_CHARBUFF(pos,buf,arg0,arg1) (pos) = strlen(buf); sprintf(&(buf)[(pos)],arg0,arg1);
-char *SenvilleAURA::toBuff(char *buf) {
-    int pos = 0;
-    sprintf(buf,"0x");
+
+    for(uint8_t flips = 0; flips < (1 << weakCnt); flips++) {
+        memcpy(trial, base, sizeof(base));
+        for(i = 0; i < weakCnt; i++) {
+            if(flips & (1 << i)) trial[weak[i] / BITS_IN_BYTE] ^= 0x80 >> (weak[i] % BITS_IN_BYTE);
+        }
+        if((trial[MSG_CONST_STATE(0)] & 0xF0) == 0xA0 && calcCRC(trial, 0) == trial[MSG_CRC(0)]) {
+            for(i = 0; i < MSG_CONST_STATE(1); i++) {
+                msg[i] = trial[i];
+                msg[MSG_CONST_STATE(1) + i] = ~trial[i];
+            }
+            return true;
+        }
+    }
+    return false;
+}
+unsigned long SenvilleAURA::getSoftRecovered() {
+    return this->softRecovered;
+}
+uint8_t *SenvilleAURA::getMessage() {
+    // The setters only change the first sample, update the CRC and the second
+    return finishFrame(command);
+}
+bool SenvilleAURA::toBuff(BuffWriter &out) {
+    out.str("0x");
     for(uint8_t ptr = 0; ptr < MSG_CONST_STATE(1); ptr++) {
-        APND_CHARBUFF(pos,buf,"%0X ", message[ptr])
+        out.hex(message[ptr]).chr(' ');
     }
-    pos = strlen(buf);
-    sprintf(&buf[pos], "%ld %ld", this->sampleId, this->lastSampleMs);
+    out.num(this->sampleId).chr(' ').num(this->lastSampleMs);
+    return !out.overflow();
+}
+char *SenvilleAURA::toBuff(char *buf, size_t size) {
+    BuffWriter out(buf, size);
+    this->toBuff(out);
     return buf;
 }
-char *SenvilleAURA::toJsonBuff(char *buf) {
-    int pos = 0, i;
-    buf[0] = 0x00;
-    // Always use first sample as bytes are inverted in second sample
-    this->getMessage(); // want side effect here
-    this->validSamplePtr = 0;
-
-    switch(this->getInstructionType()) {
+bool SenvilleAURA::toJsonBuff(BuffWriter &out) {
+    return this->toJsonBuff(out, this->sample());
+}
+bool SenvilleAURA::toJsonBuff(BuffWriter &out, const uint8_t *s) {
+    Instruction instr = getInstructionType(s);
+    const char *sep = "{";
+    switch(instr) {
         case Instruction::Command:
-            APND_CHARBUFF(pos,buf,"{" CMD_ISON ":%d ", this->getPowerOn())
-            APND_CHARBUFF(pos,buf,", " CMD_INSTR ":%d ", this->getInstructionType())
-            APND_CHARBUFF(pos,buf,", " CMD_MODE ":%d ", this->getMode())
-            APND_CHARBUFF(pos,buf,", " CMD_FSPD ":%d ", this->getFanSpeed())
-            APND_CHARBUFF(pos,buf,", " CMD_SLP ":%d ", this->getSleepOn())
-            APND_CHARBUFF(pos,buf,", " CMD_STMP ":%d ", this->getSetTemp())
-            APND_CHARBUFF(pos,buf,", " STAT_SMPLID ":%ld ", this->getSeqId())
-            break;
         case Instruction::FollowMe:
-            APND_CHARBUFF(pos,buf,"{" CMD_ISON ":%d ", this->getPowerOn())
-            APND_CHARBUFF(pos,buf,", " CMD_INSTR ":%d ", this->getInstructionType())
-            APND_CHARBUFF(pos,buf,", " CMD_MODE ":%d ", this->getMode())
-            APND_CHARBUFF(pos,buf,", " CMD_FSPD ":%d ", this->getFanSpeed())
-            APND_CHARBUFF(pos,buf,", " CMD_SLP ":%d ", this->getSleepOn())
-            APND_CHARBUFF(pos,buf,", " CMD_MTMP ":%d ", this->getFollowMeTemp())
-            APND_CHARBUFF(pos,buf,", " CMD_STATE ":%d ", this->getFollowMeState())
-            APND_CHARBUFF(pos,buf,", " STAT_SMPLID ":%ld ", this->getSeqId())
-            break;
         case Instruction::InstrOption:
-            APND_CHARBUFF(pos,buf,"{" CMD_INSTR ":%d ", this->getInstructionType())
-            APND_CHARBUFF(pos,buf,", " CMD_OPT ":%d ", this->getOption())
-            APND_CHARBUFF(pos,buf,", " STAT_SMPLID ":%ld ", this->getSeqId())
-            APND_CHARBUFF(pos,buf,", " STAT_ONTME ":%ld ", this->getOnTimeMs())
+            for(uint8_t k = 0; k < SENVILLE_FIELD_CNT; k++) {
+                if(!(fields[k].instrs & instr)) continue;
+                out.str(sep).str(keyNames[k]).chr(':').num(fields[k].get(s));
+                sep = " , ";
+            }
+            out.str(" , " STAT_SMPLID ":").num(this->getSeqId());
+            if(instr == Instruction::InstrOption) out.str(" , " STAT_ONTME ":").num(this->getOnTimeMs());
+            out.chr(' ');
             break;
         default: // Unsupported
 #ifdef SHOW_RAWDATA
-            APND_CHARBUFF(pos,buf,"{" STAT_RAW ":0x%s", "")
+            out.str("{" STAT_RAW ":0x");
             for(int i=0; i<MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) ; i++) {
-                APND_CHARBUFF(pos,buf,"%0X ",message[i])
+                out.hex(message[i]).chr(' ');
             }
-            APND_CHARBUFF(pos,buf,", " STAT_SMPLID ":%ld ", this->getSeqId())
-            APND_CHARBUFF(pos,buf,", " STAT_ONTME ":%ld ", this->getOnTimeMs())
+            out.str(", " STAT_SMPLID ":").num(this->getSeqId());
+            out.str(" , " STAT_ONTME ":").num(this->getOnTimeMs()).chr(' ');
 #endif
             break;
     }
-    APND_CHARBUFF(pos,buf,"}%s", "")
+    out.chr('}');
+    return !out.overflow();
+}
+char *SenvilleAURA::toJsonBuff(char *buf, size_t size) {
+    BuffWriter out(buf, size);
+    this->toJsonBuff(out);
     return buf;
 }
-bool SenvilleAURA::fromJsonBuff(char *buf, uint8_t *sendBuf) {
-    bool isOn, slp;
-    Mode mde;
-    FanSpeed fsp;
-    SenvilleAURA *sFlw, *sOpt;
-    uint8_t mTmp;
-    FollowMeState fms;
-    Option opt;
+uint8_t SenvilleAURA::toJsonDelta(BuffWriter &out, bool full) {
+    Instruction instr = getInstructionType(command);
+    long value[SENVILLE_FIELD_CNT];
+    uint16_t changed = 0;
+    uint8_t cnt = 0;
+    for(uint8_t k = 0; k < SENVILLE_FIELD_CNT; k++) {
+        if(!(fields[k].instrs & instr)) continue;
+        value[k] = fields[k].get(command);
+        if(full || !((this->publishedHas >> k) & 0x01) || this->published[k] != value[k]) {
+            changed |= (1 << k);
+            cnt++;
+        }
+    }
+    if(full) {
+        this->toJsonBuff(out, command);
+    } else if(cnt > 0) {
+        const char *sep = "{";
+        for(uint8_t k = 0; k < SENVILLE_FIELD_CNT; k++) {
+            if(!((changed >> k) & 0x01)) continue;
+            out.str(sep).str(keyNames[k]).chr(':').num(value[k]);
+            sep = " , ";
+        }
+        out.str(" }");
+    }
+    if(out.overflow()) return cnt;
+    for(uint8_t k = 0; k < SENVILLE_FIELD_CNT; k++) {
+        if(!((changed >> k) & 0x01)) continue;
+        this->published[k] = value[k];
+        this->publishedHas |= (1 << k);
+    }
+    return cnt;
+}
+#define CMD_SKIPWS(p,end) while((p) < (end) && (*(p) == ' ' || *(p) == '\t' || *(p) == '\r' || *(p) == '\n')) (p)++;
+#define CMD_DIGITS 9 // Significant digits kept, the rest only scale the value
+// A JSON number at p, a fraction and exponent truncated toward zero as ArduinoJson's
+// as<uint8_t>() did.  p is left after it, false if there is none.
+static bool parseNumber(const char *&p, const char *end, long *value) {
+    long v = 0;
+    int scale = 0, exp = 0;
+    uint8_t digits = 0;
+    bool neg = (p < end && *p == '-'), expNeg;
+
+    if(neg) p++;
+    if(p >= end || *p < '0' || *p > '9') return false;
+    for(; p < end && *p >= '0' && *p <= '9'; p++) {
+        if(digits < CMD_DIGITS) { v = v * 10 + (*p - '0'); if(v) digits++; }
+        else scale++;
+    }
+    if(p < end && *p == '.') {
+        if(++p >= end || *p < '0' || *p > '9') return false;
+        for(; p < end && *p >= '0' && *p <= '9'; p++) {
+            if(digits < CMD_DIGITS) { v = v * 10 + (*p - '0'); if(v) digits++; scale--; }
+        }
+    }
+    if(p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        expNeg = (p < end && *p == '-');
+        if(p < end && (*p == '-' || *p == '+')) p++;
+        if(p >= end || *p < '0' || *p > '9') return false;
+        for(; p < end && *p >= '0' && *p <= '9'; p++) if(exp < 100) exp = exp * 10 + (*p - '0');
+        scale += expNeg ? -exp : exp;
+    }
+    for(; scale < 0 && v; scale++) v /= 10;
+    for(; scale > 0 && v; scale--) v = v < LONG_MAX / 10 ? v * 10 : LONG_MAX;
+    *value = neg ? -v : v;
+    return true;
+}
+bool SenvilleAURA::parseCmd(const char *buf, size_t len, SenvilleCmd *cmd) {
+    const char *p = buf, *end = buf + len, *key, *str;
+    size_t keyLen;
+    uint8_t k;
+    long value;
+    bool number;
+
+    cmd->has = 0;
+    CMD_SKIPWS(p,end)
+    if(p >= end || *p++ != '{') return false;
+    CMD_SKIPWS(p,end)
+    if(p < end && *p == '}') return true;
+    while(p < end) {
+        // Key, quoted or not
+        if(*p == '"') {
+            key = ++p;
+            while(p < end && *p != '"') p++;
+            if(p >= end) return false;
+            keyLen = p++ - key;
+        } else {
+            key = p;
+            while(p < end && *p != ':' && *p != ' ' && *p != '\t') p++;
+            keyLen = p - key;
+        }
+        CMD_SKIPWS(p,end)
+        if(keyLen == 0 || p >= end || *p++ != ':') return false;
+        CMD_SKIPWS(p,end)
+        if(p >= end) return false;
+        // Value
+        value = 0;
+        number = true;
+        if(*p >= 'a' && *p <= 'z') { // true, false or null
+            value = (*p == 't');
+            while(p < end && *p >= 'a' && *p <= 'z') p++;
+        } else if(*p == '"') { // Taken as a number if it is one
+            str = ++p;
+            while(p < end && *p != '"') p++;
+            if(p >= end) return false;
+            number = parseNumber(str, p, &value) && str == p;
+            p++;
+        } else if(!parseNumber(p, end, &value)) {
+            return false;
+        }
+        k = findKey(key, keyLen);
+        if(k < SENVILLE_KEYS) {
+            if(!number) return false; // Not to be taken as 0
+            cmd->has |= 0x01 << k;
+            cmd->val[k] = value;
+        }
+        CMD_SKIPWS(p,end)
+        if(p >= end) return false;
+        if(*p == '}') return true;
+        if(*p++ != ',') return false;
+        CMD_SKIPWS(p,end)
+    }
+    return false;
+}
+bool SenvilleAURA::fromJsonBuff(const char *buf, uint8_t *sendBuf) {
+    return this->fromJsonBuff(buf, strlen(buf), sendBuf);
+}
+bool SenvilleAURA::fromJsonBuff(const char *buf, size_t len, uint8_t *sendBuf) {
     Instruction thisInstr;
-    StaticJsonDocument<JSON_PARSEBUFFER> root;
-    DeserializationError error = deserializeJson(root, buf);
+    SenvilleCmd cmd;
 
     // Test if parsing succeeds.
-    if (error) {
+    if(!SenvilleAURA::parseCmd(buf, len, &cmd)) {
       #ifdef DEBUG
-      Serial.print("parseObject("); Serial.print(buf); Serial.print(") failed with code ");
-      Serial.println(error.c_str());
+      Serial.print("parseCmd("); Serial.print(buf); Serial.println(") failed");
       #endif
       return false;
     }
 
-    // Always use first sample as bytes are inverted in second sample
-    this->getMessage(); // want side effect here
-    this->validSamplePtr = 0;
-
-    if(root.containsKey(CMD_INSTR)) {
-        thisInstr = static_cast<Instruction>(root[CMD_INSTR].as<uint8_t>());
+    if(cmd.hasKey(KeyInstr)) {
+        thisInstr = static_cast<Instruction>((uint8_t)cmd.val[KeyInstr]);
         this->setInstructionType(Instruction::Command);
+        // Fields of the instruction, one out of range is skipped and the rest still set
+        for(uint8_t k = 0; k < SENVILLE_FIELD_CNT; k++) {
+            if(cmd.hasKey((SenvilleKey)k) && (fields[k].instrs & thisInstr)
+               && !(fields[k].flags & (IRFieldReadOnly | IRFieldCmdOnly))) {
+                this->setField((SenvilleKey)k, cmd.val[k]);
+            }
+        }
         switch(thisInstr) {
             case Instruction::Command:
+                memmove(sendBuf, this->getMessage(), MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) * sizeof(uint8_t));
+                this->sampleId++;
+                this->lastSampleMs = millis();
+                return true;
             case Instruction::FollowMe:
-                if(root.containsKey(CMD_ISON)) {
-                    isOn = root[CMD_ISON].as<bool>();
-                    this->setPowerOn(isOn);
-                }
-                if(root.containsKey(CMD_MODE)) {
-                    mde = static_cast<Mode>(root[CMD_MODE].as<uint8_t>());
-                    this->setMode(mde);
-                }
-                if(root.containsKey(CMD_FSPD)) {
-                    fsp = static_cast<FanSpeed>(root[CMD_FSPD].as<uint8_t>());
-                    this->setFanSpeed(fsp);
-                }
-                if(root.containsKey(CMD_SLP)) {
-                    slp = root[CMD_SLP].as<bool>();
-                    this->setSleepOn(slp);
-                }
-                if(thisInstr == Instruction::Command) {
-                    if(root.containsKey(CMD_STMP)) {
-                        uint8_t tmp = static_cast<Option>(root[CMD_STMP].as<uint8_t>());
-                        this->setSetTemp(tmp);
-                    }
-                    memmove(sendBuf, this->getMessage(), MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) * sizeof(uint8_t));
+                if(cmd.hasKey(KeyMeasTemp) && cmd.hasKey(KeyState)) {
+                    this->followMeCmd(sendBuf, static_cast<FollowMeState>((uint8_t)cmd.val[KeyState]),
+                                      (uint8_t)cmd.val[KeyMeasTemp]);
                     this->sampleId++;
                     this->lastSampleMs = millis();
                     return true;
-                } else {
-                    if(root.containsKey(CMD_MTMP) && root.containsKey(CMD_STATE)) {
-                        mTmp = root[CMD_MTMP].as<uint8_t>();
-                        fms = static_cast<FollowMeState>(root[CMD_STATE].as<uint8_t>());
-                        sFlw = this->followMeCmd(this, fms, mTmp);
-                        memmove(sendBuf, sFlw->getMessage(), MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) * sizeof(uint8_t));
-                        this->sampleId++;
-                        this->lastSampleMs = millis();
-                        return true;
-                    }
                 }
                 break;
-            default: // An InstrOption - NOTE: optionCmd() creates new instance to not effect buffer values
-                if(root.containsKey(CMD_OPT)) {
-                    opt = static_cast<Option>(root[CMD_OPT].as<uint8_t>());
-                    sOpt = this->optionCmd(opt);
-                    memmove(sendBuf, sOpt->getMessage(), MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) * sizeof(uint8_t));
+            default: // An InstrOption - NOTE: optionCmd() writes sendBuf only, to not effect buffer values
+                if(cmd.hasKey(KeyOpt) && fields[KeyOpt].valid(cmd.val[KeyOpt])) {
+                    this->optionCmd(sendBuf, static_cast<Option>((uint8_t)cmd.val[KeyOpt]));
                     this->sampleId++;
                     this->lastSampleMs = millis();
-                    delete sOpt;
                     return true;
                 }
                 break;
@@ -258,74 +414,75 @@ bool SenvilleAURA::fromJsonBuff(char *buf, uint8_t *sendBuf) {
 /////////
 //
 ////////
+long SenvilleAURA::getField(SenvilleKey k) {
+    return k < SENVILLE_FIELD_CNT ? fields[k].get(this->sample()) : 0;
+}
+bool SenvilleAURA::setField(SenvilleKey k, long v) {
+    if(k >= SENVILLE_FIELD_CNT || (fields[k].flags & IRFieldReadOnly) || !fields[k].valid(v)) return false;
+    const IRFieldDesc &f = fields[k];
+    uint8_t *s = command;
+    if(!(f.modes & MODE_BIT(FieldMode::get(s)))) {
+        if(!(f.flags & IRFieldZeroElse)) return true;
+        v = f.offset;
+    }
+    if((f.flags & IRFieldNeedsOn) && !FieldIsOn::get(s)) return true;
+    f.set(s, v);
+    return true;
+}
 Instruction SenvilleAURA::getInstructionType() {
-    return static_cast<Instruction>(message[MSG_CONST_STATE(this->validSamplePtr)] & 0x07);
+    return static_cast<Instruction>(FieldInstr::get(this->sample()));
+}
+Instruction SenvilleAURA::getInstructionType(const uint8_t *msg) {
+    return static_cast<Instruction>(FieldInstr::get(msg));
 }
 void SenvilleAURA::setInstructionType(Instruction instr) {
-    message[MSG_CONST_STATE(this->validSamplePtr)] = 0xA0 | ((uint8_t)instr);
+    command[MSG_CONST_STATE(0)] = 0xA0 | ((uint8_t)instr);
 }
 bool SenvilleAURA::getPowerOn() {
-    return 0x80 & message[MSG_CMD_OPT(this->validSamplePtr)];
+    return FieldIsOn::get(command);
 }
 void SenvilleAURA::setPowerOn(bool newState) {
-    message[MSG_CMD_OPT(this->validSamplePtr)]
-    = (newState? message[MSG_CMD_OPT(this->validSamplePtr)] | 0x80
-       : message[MSG_CMD_OPT(this->validSamplePtr)] & 0x7F );
+    this->setField(KeyIsOn, newState);
 }
 Mode SenvilleAURA::getMode() {
-    return static_cast<Mode>((message[MSG_CMD_OPT(this->validSamplePtr)] & 0x07));
+    return static_cast<Mode>(FieldMode::get(command));
 }
 void SenvilleAURA::setMode(Mode val) {
-    message[MSG_CMD_OPT(this->validSamplePtr)] &= 0xF8;
-    message[MSG_CMD_OPT(this->validSamplePtr)] |= (0x07 & (uint8_t)val);
+    this->setField(KeyMode, val);
 }
 FanSpeed SenvilleAURA::getFanSpeed() {
-    return static_cast<FanSpeed>((message[MSG_CMD_OPT(this->validSamplePtr)] & 0x18) >> 3);
+    return static_cast<FanSpeed>(FieldFanSpeed::get(command));
 }
 void SenvilleAURA::setFanSpeed(FanSpeed val) {
-    Mode m = this->getMode();
-    if( m == Mode::ModeAuto || m == Mode::Dry ) val = FanSpeed::FanAuto;
-    message[MSG_CMD_OPT(this->validSamplePtr)] &= 0xE7;
-    message[MSG_CMD_OPT(this->validSamplePtr)] |= ((val << 3) & 0x18);
+    this->setField(KeyFanSpeed, val);
 }
 bool SenvilleAURA::getSleepOn(){
-    return message[MSG_CMD_OPT(this->validSamplePtr)] & 0x40;
+    return FieldIsSleepOn::get(command);
 }
 void SenvilleAURA::setSleepOn(bool newState) {
-    Mode m = this->getMode();
-    if( m == Mode::Fan || m == Mode::Dry || !this->getPowerOn() ) return;
-    message[MSG_CMD_OPT(this->validSamplePtr)]
-        = (newState? message[MSG_CMD_OPT(this->validSamplePtr)]
-           | 0x40 : message[MSG_CMD_OPT(this->validSamplePtr)] & 0xBF );
+    this->setField(KeyIsSleepOn, newState);
 }
 Option SenvilleAURA::getOption() {
   #ifdef DEBUG
     Serial.print(" raw getOption(");
-    Serial.print(message[MSG_CMD_OPT(this->validSamplePtr)] & 0x1F, HEX);
+    Serial.print(FieldOpt::get(this->sample()), HEX);
     Serial.print(")");
   #endif
-    return static_cast<Option>( message[MSG_CMD_OPT(this->validSamplePtr)] & 0x1F );
+    return static_cast<Option>(FieldOpt::get(this->sample()));
 }
-// NB: returned pointer must be deleted by caller
-SenvilleAURA *SenvilleAURA::optionCmd(Option val) {
-    SenvilleAURA *obj = new SenvilleAURA();
-    uint8_t *msg = obj->getMessage();
+uint8_t *SenvilleAURA::optionCmd(uint8_t *msg, Option val) {
     msg[MSG_CONST_STATE(0)] = 0xA0 | (uint8_t)Instruction::InstrOption;
     msg[MSG_CMD_OPT(0)] = val;
     msg[MSG_RUNMODE(0)] = 0xff;
     msg[MSG_TIMESTART(0)] = 0xff;
     msg[MSG_TIMESTOP(0)] = 0xff;
-    obj->isValid(msg, true);
-    return obj;
+    return finishFrame(msg);
 }
 uint8_t  SenvilleAURA::getSetTemp() {
-    return (message[MSG_RUNMODE(this->validSamplePtr)] & 0x0f) + TEMP_LOWEST;
+    return FieldSetTemp::get(command);
 }
 void SenvilleAURA::setSetTemp(uint8_t val) {
-    Mode m = this->getMode();
-    if( m == Mode::Fan ) return;
-    message[MSG_RUNMODE(this->validSamplePtr)] &= 0xF0;
-    message[MSG_RUNMODE(this->validSamplePtr)] |= (val-TEMP_LOWEST) & 0x0F;
+    this->setField(KeySetTemp, val);
 }
 uint8_t  SenvilleAURA::getTimeOff() {
     return 0; // Not implemented
@@ -337,22 +494,33 @@ uint8_t  SenvilleAURA::getTimeOn() {
 void SenvilleAURA::setTimeOn(uint8_t hour) {}
 
 uint8_t SenvilleAURA::getFollowMeTemp() {
-    return message[MSG_TIMESTOP(this->validSamplePtr)];
+    return FieldMeasTemp::get(this->sample());
 }
 FollowMeState SenvilleAURA::getFollowMeState() {
-    return static_cast<FollowMeState>(message[MSG_TIMESTART(this->validSamplePtr)]);
+    return static_cast<FollowMeState>(FieldState::get(this->sample()));
 }
 //   Note: Heat pump expects an update in measured temperature every 3 minutes
-SenvilleAURA *SenvilleAURA::followMeCmd(SenvilleAURA *fromState, FollowMeState newState,
-                                               uint8_t measuredTemp) {
-    uint8_t *msg = fromState->getMessage();
+uint8_t *SenvilleAURA::followMeCmd(uint8_t *msg, FollowMeState newState, uint8_t measuredTemp) {
+    memcpy(msg, command, MSG_CONST_STATE(1) * sizeof(uint8_t));
     msg[MSG_CONST_STATE(0)] = 0xA0 | (uint8_t)Instruction::FollowMe;
     msg[MSG_CMD_OPT(0)] &= 0x10;
     msg[MSG_RUNMODE(0)] |= 0x44;
-    msg[MSG_TIMESTART(0)] = newState;
-    msg[MSG_TIMESTOP(0)] = measuredTemp;
-    fromState->isValid(msg, true);
-    return fromState;
+    FieldState::set(msg, newState);
+    FieldMeasTemp::set(msg, measuredTemp);
+    return finishFrame(msg);
+}
+unsigned int SenvilleAURA::getMessageDuration() {
+    return (frameAirtimeUs(this->message) + 500) / 1000;
+}
+unsigned long SenvilleAURA::frameAirtimeUs(const uint8_t *msg) {
+    typedef SenvilleAURAProtocol P;
+    unsigned long ones = 0;
+    for(int i = 0; i < MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS); i++) {
+        for(uint8_t b = msg[i]; b; b &= b - 1) ones++;
+    }
+    return MESSAGE_SAMPLES * (P::Sync0::val() + P::Sync1::val() + P::Sep::val() + P::Break::val())
+           + (unsigned long)MESSAGE_SAMPLES * MESSAGE_BITS * (P::Sep::val() + P::Zero::val())
+           + ones * (P::One::val() - P::Zero::val());
 }
 unsigned long  SenvilleAURA::getOnTimeMs() {
     return this->lastSampleMs;
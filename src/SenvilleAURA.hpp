@@ -13,6 +13,7 @@
 #include <SmingCore.h>
 #endif
 #include "IRLink.hpp"
+#include "IRProtocol.hpp"
 
 /* Notes on waveform configured below :
  *  - There is no significance to high or low values, it is all about pulse durations.
@@ -41,23 +42,72 @@
 #define MESSAGE_SAMPLES 2
 #define MESSAGE_BITS 48 // Message is ten nibbles, fits into 5 bytes, plus CRC
 #define MESSAGE_SYNC_BITS 2
-#define SYNC_PREAMBLE_0  4100.0
-#define SYNC_PREAMBLE_1  4320.0
 
-#undef TOLERANCE_PERCENT
-#define TOLERANCE_PERCENT 0.21f
-#define SEP_LENGTH0  500.0
-#define BIT0_LENGTH  500.0
-#define BIT1_LENGTH 1560.0
-#define EOT_LENGTH  5120.0
+// Pulse timings, us
+struct SenvilleAURAProtocol {
+    enum { Samples = MESSAGE_SAMPLES, Bits = MESSAGE_BITS, Syncs = MESSAGE_SYNC_BITS, TolerancePct = 21 };
+    typedef IRPulse<4100,TolerancePct> Sync0;
+    typedef IRPulse<4320,TolerancePct> Sync1;
+    typedef IRPulse< 500,TolerancePct> Sep;
+    typedef IRPulse< 500,TolerancePct> Zero;
+    typedef IRPulse<1560,TolerancePct> One;
+    typedef IRPulse<5120,TolerancePct> Break;
+};
 
 #define TEMP_LOWEST 17
 
+// Soft decision: least sure bits of the pair decision also tried flipped, if
+// their summed confidence (of 254) is below SOFT_WEAK
+#define SOFT_CHASE_BITS 2
+#define SOFT_WEAK 64
+
 enum Instruction : uint8_t {Command = 0x01, InstrOption = 0x02, FollowMe = 0x04};
 enum Mode : uint8_t {Cool = 0 , Dry = 1, ModeAuto = 2, Heat = 3, Fan = 4};
 enum FanSpeed : uint8_t {FanAuto = 0, Low = 1, Med = 2, High = 3};
 enum Option : uint8_t {Direct = 1, Swing = 2, Led = 8, Turbo = 9, SelfClean = 13, SilenceOn = 18, SilenceOff = 19, FP = 15};
 enum FollowMeState  : uint8_t {FmStart = 0xFF, FmUpdateTemp = 0x7F, FmStop = 0x3F};
+// SenvilleAURA::checkFrame() flags
+enum FrameCheck : uint8_t {FrameOk = 0x00, FrameCRC0 = 0x01, FrameCRC1 = 0x02, FrameSamplesDiffer = 0x04};
+
+#define MODE_BIT(m) (1 << (m))
+#define MODES_ALL 0x1F
+#define INSTR_CMD_FM (Command | FollowMe)
+#define INSTR_ALL (Command | InstrOption | FollowMe)
+
+// Fields of a sample, in JSON order.  Each is (name, JSON key, byte in the sample, mask, shift,
+// value offset, largest value, instructions it is part of, modes it can be set in, IRFieldFlags).
+// SenvilleAURA gets a Field<name> accessor, a Key<name> and a row of senvilleFields[] for each.
+#define SENVILLE_FIELDS(X) \
+    X(IsOn,      "IsOn",      MSG_CMD_OPT(0),     0x80, 7, 0,           1,                INSTR_CMD_FM, MODES_ALL, 0) \
+    X(Instr,     "Instr",     MSG_CONST_STATE(0), 0x07, 0, 0,           FollowMe,         INSTR_ALL, MODES_ALL, IRFieldReadOnly) \
+    X(Mode,      "Mode",      MSG_CMD_OPT(0),     0x07, 0, 0,           Fan,              INSTR_CMD_FM, MODES_ALL, 0) \
+    X(FanSpeed,  "FanSpeed",  MSG_CMD_OPT(0),     0x18, 3, 0,           High,             INSTR_CMD_FM, \
+      MODE_BIT(Cool) | MODE_BIT(Heat) | MODE_BIT(Fan), IRFieldZeroElse) \
+    X(IsSleepOn, "IsSleepOn", MSG_CMD_OPT(0),     0x40, 6, 0,           1,                INSTR_CMD_FM, \
+      MODE_BIT(Cool) | MODE_BIT(ModeAuto) | MODE_BIT(Heat), IRFieldNeedsOn) \
+    X(SetTemp,   "SetTemp",   MSG_RUNMODE(0),     0x0F, 0, TEMP_LOWEST, TEMP_LOWEST + 15, Command, MODES_ALL & ~MODE_BIT(Fan), 0) \
+    X(MeasTemp,  "MeasTemp",  MSG_TIMESTOP(0),    0xFF, 0, 0,           0xFF,             FollowMe, MODES_ALL, IRFieldCmdOnly) \
+    X(State,     "State",     MSG_TIMESTART(0),   0xFF, 0, 0,           0xFF,             FollowMe, MODES_ALL, IRFieldCmdOnly) \
+    X(Opt,       "Opt",       MSG_CMD_OPT(0),     0x1F, 0, 0,           0x1F,             InstrOption, MODES_ALL, IRFieldCmdOnly)
+// Keys reported but not in the frame
+#define SENVILLE_STATS(X) \
+    X(SampleId, "SampleId") \
+    X(OnTimeMs, "OnTimeMs")
+
+#define SENVILLE_KEY_ENUM(name, ...) Key##name,
+#define SENVILLE_FIELD_COUNT(name, ...) + 1
+// Keys of a command, see SenvilleAURA::parseCmd()
+enum SenvilleKey : uint8_t { SENVILLE_FIELDS(SENVILLE_KEY_ENUM) SENVILLE_STATS(SENVILLE_KEY_ENUM) SENVILLE_KEYS };
+constexpr uint8_t SENVILLE_FIELD_CNT = 0 SENVILLE_FIELDS(SENVILLE_FIELD_COUNT);
+#define SENVILLE_KEY_SLOTS 32 // By SENVILLE_KEY_HASH(), a slot to each key
+#define SENVILLE_KEY_HASH(len,first,last) ((3 * (len) + (first) + (last)) & (SENVILLE_KEY_SLOTS - 1))
+
+typedef struct SenvilleCmdS {
+    uint16_t has; // Bit per SenvilleKey found
+    long val[SENVILLE_KEYS];
+    bool hasKey(SenvilleKey k) const { return (has >> k) & 0x01; }
+} SenvilleCmd;
+static_assert(SENVILLE_KEYS <= 16, "SenvilleCmd::has holds a bit per key");
 
 class SenvilleAURA {
     // Sample index is 0 or 1
@@ -85,35 +135,96 @@ class SenvilleAURA {
      *        1******1 on timmer set from 0 to 24h
      *  [5] > ******** CRC
      */
+public:
+    #define SENVILLE_FIELD_TYPE(name, json, byte, mask, shift, offset, ...) \
+        typedef IRField<byte, mask, shift, offset> Field##name;
+    SENVILLE_FIELDS(SENVILLE_FIELD_TYPE)
+    // Indexed by SenvilleKey, names also of the stats
+    static const IRFieldDesc fields[SENVILLE_FIELD_CNT];
+    static const char *keyNames[SENVILLE_KEYS];
 private:
     static IRConfig config;
     unsigned long sampleId;
     unsigned long lastSampleMs;
     unsigned short setTempDegC;
     short validSamplePtr;
+    // Last frame that checked out, of any instruction
     uint8_t message[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
+    // Last Command frame, first sample first; Follow-Me and option frames, the unit's
+    // echo of ours included, carry a masked copy of the state so never change it
+    uint8_t command[MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS)];
 
-    uint8_t calcCRC(short _sample);
+    unsigned long softRecovered;
+    // Field values last written by toJsonDelta(), bit per field in publishedHas
+    long published[SENVILLE_FIELD_CNT];
+    uint16_t publishedHas;
+
+    static uint8_t calcCRC(const uint8_t *msg, short _sample);
+    // CRC of the first sample then the second sample as its inverse
+    static uint8_t *finishFrame(uint8_t *msg);
+    bool softDecide(uint8_t *msg, const int8_t *soft);
 
     void setInstructionType(Instruction instr);
+    uint8_t *sample() { return &message[MSG_CONST_STATE(this->validSamplePtr)]; }
+    // Fields of the instruction of sample s
+    bool toJsonBuff(BuffWriter &out, const uint8_t *s);
 
 public:
     SenvilleAURA();
 
     IRConfig *getIRConfig();
 
-    // If msg is valid, it is copied locally into the class
+    // If msg is valid, it is copied locally into the class, a Command also as the state
     bool isValid(uint8_t *msg, bool setCRC = false);
+    // As above, but if neither sample checks out the bits are decided again from the
+    // confidences of both samples, see IRLink::getSoftBits().  msg is corrected if so.
+    bool isValidSoft(uint8_t *msg, const int8_t *soft);
+    // The command state as a frame to send
     uint8_t *getMessage();
+    // Time the kept message takes on the wire, ms
     unsigned int getMessageDuration();
+    // Time a frame takes on the wire, us
+    static unsigned long frameAirtimeUs(const uint8_t *msg);
+    // CRC of one sample, its bytes xor invert first (0xFF for the second sample)
+    static uint8_t frameCRC(const uint8_t *sample, uint8_t invert = 0x00);
+    // FrameCheck flags of a raw frame, FrameOk if both CRCs match and the samples agree
+    static uint8_t checkFrame(const uint8_t *msg);
+    // Frames only valid after the soft decision
+    unsigned long getSoftRecovered();
 
-    char *toBuff(char *buf);
-    char *toJsonBuff(char *buf);
+    // Of the last frame received.  False if out ran out of room, what fits is written
+    bool toBuff(BuffWriter &out);
+    bool toJsonBuff(BuffWriter &out);
+    char *toBuff(char *buf, size_t size);
+    char *toJsonBuff(char *buf, size_t size);
+    // Fields of the command state that differ from what the last toJsonDelta() wrote, as
+    // {key:value , ... } without the stats.  With full it writes all of them as toJsonBuff().
+    // Returns the fields written, 0 and nothing written if none changed.  What did not
+    // fit in out is not taken as written.
+    uint8_t toJsonDelta(BuffWriter &out, bool full = false);
+    // The next toJsonDelta() writes every field
+    void clearPublished() { this->publishedHas = 0; }
     // Returns true if successfully parsed and sendBuf is populated for transmission
-    bool fromJsonBuff(char *buf, uint8_t *sendBuf);
+    // A field out of range is left as it was, the others are still set
+    bool fromJsonBuff(const char *buf, uint8_t *sendBuf);
+    bool fromJsonBuff(const char *buf, size_t len, uint8_t *sendBuf);
+    // One pass over a flat JSON object of the keys in SenvilleKey, quoted or bare as
+    // toJsonBuff() writes them, buf need not be terminated.  Other keys are skipped.
+    // Fractions are truncated, a quoted value taken if it is a number; a key of ours
+    // with any other string fails the whole command.
+    static bool parseCmd(const char *buf, size_t len, SenvilleCmd *cmd);
+
+    // Any field by key of the last frame received.  setField() sets the command state as
+    // the named setters below; false if v is not a value of the field, or the field is
+    // read only; true if the mode or power left it as is.
+    long getField(SenvilleKey k);
+    bool setField(SenvilleKey k, long v);
 
-    // Control Options
+    // Control Options, the getters of the command state but for the instruction,
+    // option and Follow-Me ones which are of the last frame received
     Instruction getInstructionType();
+    // Of a raw frame, e.g. one about to be sent
+    static Instruction getInstructionType(const uint8_t *msg);
 
     bool getPowerOn();
     void setPowerOn(bool newState);
@@ -131,13 +242,13 @@ public:
     void setSleepOn(bool newState);
 
     Option getOption();
-    // Make option command - Creates a new command
+    // Make option command - written into msg, MSGSIZE_BYTES(MESSAGE_SAMPLES,MESSAGE_BITS) bytes
     // Direct, Swing, Led, SilenceOn/SilenceOff - Cool, Dry, Heat, Fan, Auto
     // Turbo - Cool, Heat, Auto
     // Self Clean - Cool, Auto
     // FP - Only works when initially in heat mode, display shows 'FP' when active
     //      Cancels when On/Off, Sleep, FP, Mode, Fan speed, Up/Dn pressed
-    static SenvilleAURA *optionCmd(Option val);
+    static uint8_t *optionCmd(uint8_t *msg, Option val);
 
     // No temp control in fan mode
     uint8_t  getSetTemp();
@@ -152,9 +263,9 @@ public:
     uint8_t getFollowMeTemp();
     FollowMeState getFollowMeState();
     // Make option command - Follow Me, there are three states, new, update temp, and stop
-    //   Note: Heat pump expects an update in measured temperature every 3 minutes
-    static SenvilleAURA *followMeCmd(SenvilleAURA *fromState, FollowMeState newState,
-                                     uint8_t measuredTemp);
+    //   Written into msg from the command state, which is left as it is
+    //   Note: Heat pump expects an update in measured temperature every 3 minutes, see SenvilleFollowMe
+    uint8_t *followMeCmd(uint8_t *msg, FollowMeState newState, uint8_t measuredTemp);
 
     unsigned long  getOnTimeMs();
     unsigned long  getSeqId();
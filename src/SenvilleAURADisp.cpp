@@ -14,10 +14,17 @@
 #define 	ESP_MAX_INTERRUPTS   16
 #define 	digitalPinToInterrupt(p)   ( (p) < ESP_MAX_INTERRUPTS ? (p) : -1 )
 #endif
+// HSPI slave capture, with the SDK register definitions Sming brings
+#if defined(SMING)
+#include <espinc/spi_register.h>
+#define DISP_HSPI_CAPTURE
+#endif
 
 #define BITSINBYTE 8
 // The LSB of the display toggles between 1/0 with each scan but isn't connected to output
 #define DISPLAY_MASK 0xFE
+#define DISP_CODES 128
+#define DISP_CODE_5S 0x48
 
 #define STAT_DISPRAW    "dispRaw"
 #define STAT_DISP       "disp"
@@ -33,42 +40,39 @@ volatile uint8_t SenvilleAURADisp::rdByte;
 
 // Message values
 volatile uint8_t SenvilleAURADisp::displayBuff[DISPLAY_BYTE_SIZE];
-volatile uint8_t SenvilleAURADisp::displayBuffLast[DISPLAY_BYTE_SIZE];
+uint8_t SenvilleAURADisp::displayBuffLast[DISPLAY_BYTE_SIZE];
 volatile uint8_t SenvilleAURADisp::displayPtr;
 
-const DisplayMapAscii SenvilleAURADisp::displayMap[] = {
-      displyMapAsciiS(0xFE, " ")
-    , displyMapAsciiS(0x9C, "-1")
-    , displyMapAsciiS(0xFC, "-")
-    , displyMapAsciiS(0x02, "0")
-    , displyMapAsciiS(0x9E, "1")
-    , displyMapAsciiS(0x24, "2")
-    , displyMapAsciiS(0x0C, "3")
-    , displyMapAsciiS(0x98, "4")
-    , displyMapAsciiS(0x48, "5")
-    , displyMapAsciiS(0x40, "6")
-    , displyMapAsciiS(0x1E, "7")
-    , displyMapAsciiS(0x00, "8")
-    , displyMapAsciiS(0x08, "9")
-    , displyMapAsciiS(0x10, "A")
-    , displyMapAsciiS(0x62, "C")
-    , displyMapAsciiS(0x60, "E")
-    , displyMapAsciiS(0x70, "F")
-    , displyMapAsciiS(0x90, "H")
-    , displyMapAsciiS(0xF2, "I")
-    , displyMapAsciiS(0xE2, "L")
-    , displyMapAsciiS(0x30, "P")
-    , displyMapAsciiS(0x48, "S")
-    , displyMapAsciiS(0x72, "T")
-    , displyMapAsciiS(0x82, "U")
-    , displyMapAsciiS(0xC0, "b")
-    , displyMapAsciiS(0xE4, "c")
-    , displyMapAsciiS(0x84, "d")
-    , displyMapAsciiS(0x20, "e")
-    , displyMapAsciiS(0x9E, "i")
-    , displyMapAsciiS(0xC4, "o")
-    , displyMapAsciiS(0xF4, "r")
-    , displyMapAsciiS(0xC6, "u")
+// Changes waiting for the loop
+DispFrame SenvilleAURADisp::ring[DISP_RING_FRAMES];
+volatile uint8_t SenvilleAURADisp::ringHead = 0;
+volatile uint8_t SenvilleAURADisp::ringTail = 0;
+volatile unsigned long SenvilleAURADisp::ringDropped = 0;
+volatile bool SenvilleAURADisp::listening = false;
+
+DispCapture SenvilleAURADisp::capture = DispBitBang;
+volatile bool SenvilleAURADisp::hspiArmed = false;
+
+// Segment code to ascii, indexed by code >> 1 as the LSB is never lit.  Codes
+// seen on no display read as "?".  Where a glyph is both a digit and a letter
+// this holds the digit; labels take the letter, see displayBytetoAscii().
+static constexpr char displayChars[DISP_CODES][DISP_MAXSTRINGPERCODE] = {
+    /* 0x00 */ "8",  "0",  "?",  "?",  "9",  "?",  "3",  "?",
+    /* 0x10 */ "A",  "?",  "?",  "?",  "?",  "?",  "?",  "7",
+    /* 0x20 */ "e",  "?",  "2",  "?",  "?",  "?",  "?",  "?",
+    /* 0x30 */ "P",  "?",  "?",  "?",  "?",  "?",  "?",  "?",
+    /* 0x40 */ "6",  "?",  "?",  "?",  "5",  "?",  "?",  "?",
+    /* 0x50 */ "?",  "?",  "?",  "?",  "?",  "?",  "?",  "?",
+    /* 0x60 */ "E",  "C",  "?",  "?",  "?",  "?",  "?",  "?",
+    /* 0x70 */ "F",  "T",  "?",  "?",  "?",  "?",  "?",  "?",
+    /* 0x80 */ "?",  "U",  "d",  "?",  "?",  "?",  "?",  "?",
+    /* 0x90 */ "H",  "?",  "?",  "?",  "4",  "?",  "-1", "1",
+    /* 0xA0 */ "?",  "?",  "?",  "?",  "?",  "?",  "?",  "?",
+    /* 0xB0 */ "?",  "?",  "?",  "?",  "?",  "?",  "?",  "?",
+    /* 0xC0 */ "b",  "?",  "o",  "u",  "?",  "?",  "?",  "?",
+    /* 0xD0 */ "?",  "?",  "?",  "?",  "?",  "?",  "?",  "?",
+    /* 0xE0 */ "?",  "L",  "c",  "?",  "?",  "?",  "?",  "?",
+    /* 0xF0 */ "?",  "I",  "r",  "?",  "?",  "?",  "-",  " "
 };
 
 // Only one instance of this class is supported, the last
@@ -80,28 +84,41 @@ void IRAM_ATTR ISRDispHandler() {
 void IRAM_ATTR ISRSyncHandler() {
     if(lastInst) lastInst->handleSynch();
 }
-// return display value as char* of 7bit ascii string
-const char *displayBytetoAscii(uint8_t b) {
-    for(int i=0; i<( sizeof(SenvilleAURADisp::displayMap)/sizeof(DisplayMapAscii) ); i++ ) {
-        if(b == SenvilleAURADisp::displayMap[i].dispCode)
-            return SenvilleAURADisp::displayMap[i].asciiVal;
-    }
-    return "?"; // Unmapped values are equated to a Question mark
+// return display value as char* of 7bit ascii string.  0x48 is "5" or "S" and
+// 0x9E "1" or "i".  No label has an "i" (T1, A1, b1 are ones) and only the first
+// character of one is ever an S, ST against b5.
+const char *SenvilleAURADisp::displayBytetoAscii(uint8_t b, DispContext context) {
+    if(context == DispLabel && (b & DISPLAY_MASK) == DISP_CODE_5S) return "S";
+    return displayChars[b >> 1];
 }
 //////
 // Class methods
 //////
-SenvilleAURADisp::SenvilleAURADisp() {
+SenvilleAURADisp::SenvilleAURADisp(DispCapture pcapture) {
     lastInst = this;
     displayPtr = 0;
     bitPtr = 0;
     rdByte = 0;
+    ringHead = ringTail = 0;
+    ringDropped = 0;
+    memset(displayBuffLast, DISPLAY_MASK, sizeof(displayBuffLast));
+    memset(&shown, 0, sizeof(shown));
+    memset(shown.bytes, DISPLAY_MASK, sizeof(shown.bytes));
+#ifdef DISP_HSPI_CAPTURE
+    capture = pcapture;
+#else
+    capture = DispBitBang;
+#endif
     pinMode(CLK_HSPI, INPUT);
     pinMode(LED_INTER, INPUT);
     pinMode(DATA_MOSI, INPUT);
+    if(capture == DispHspi) {
+        hspiSlaveInit();
+    } else {
     #ifdef DEBUG
-    pinMode(DEBUG_PIN, OUTPUT);
+        pinMode(DEBUG_PIN, OUTPUT);
     #endif
+    }
     this->listen();
 }
 SenvilleAURADisp::~SenvilleAURADisp() {
@@ -110,53 +127,128 @@ SenvilleAURADisp::~SenvilleAURADisp() {
 
 void SenvilleAURADisp::listen() {
     //define pin modes
+    if(listening) return;
+    listening = true;
+    displayPtr = 0;
+    bitPtr = 0;
+    if(capture == DispHspi) {
+        attachInterrupt(digitalPinToInterrupt(LED_INTER), ISRSyncHandler, RISING);
+        return;
+    }
     attachInterrupt(digitalPinToInterrupt(CLK_HSPI), ISRDispHandler, RISING);
     attachInterrupt(digitalPinToInterrupt(LED_INTER), ISRSyncHandler, RISING);
-    displayPtr = 0;
     #ifdef DEBUG
     digitalWrite(DEBUG_PIN,HIGH);
     #endif
 }
 void SenvilleAURADisp::listenStop() {
-    detachInterrupt(digitalPinToInterrupt(CLK_HSPI));
     detachInterrupt(digitalPinToInterrupt(LED_INTER));
+    listening = false;
+    hspiArmed = false;
+    if(capture == DispHspi) return;
+    detachInterrupt(digitalPinToInterrupt(CLK_HSPI));
     #ifdef DEBUG
     digitalWrite(DEBUG_PIN,LOW);
     #endif
 }
-bool SenvilleAURADisp::hasUpdate() {
-    bool newVal = true;
-    uint8_t spaces = 0;
-    if( displayPtr >= DISPLAY_BYTE_SIZE ) {
-      // Test all display bytes for a change
-      for(int i=0; i< DISPLAY_BYTE_SIZE; i++) {
-          newVal = newVal && displayBuff[i] == displayBuffLast[i];
-          displayBuffLast[i] = displayBuff[i];
-          // Supress results with spaces -- due to flashing
-          if(i < DISP_LEDS)
-              spaces += (displayBuff[i] == DISPLAY_MASK ? 1 : 0);
-      }
-      if(spaces>0) return false;
+
+// HSPI as a slave with no command or address phase, shifting in the 3 display
+// bytes LSB first on the rising clock.  Nothing is sent back, so MISO (GPIO12,
+// the IR receive pin) is left as it is.
+void SenvilleAURADisp::hspiSlaveInit() {
+#ifdef DISP_HSPI_CAPTURE
+    PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTMS_U, FUNC_HSPI_CLK);   // GPIO14 - CLK_HSPI
+    PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTCK_U, FUNC_HSPID_MOSI); // GPIO13 - DATA_MOSI
+    PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTDO_U, FUNC_HSPI_CS0);   // GPIO15 - HCS, held low
+    WRITE_PERI_REG(SPI_USER(HSPI), SPI_USR_MOSI);
+    WRITE_PERI_REG(SPI_USER1(HSPI), ((DISPLAY_BYTE_SIZE * BITSINBYTE - 1) & SPI_USR_MOSI_BITLEN) << SPI_USR_MOSI_BITLEN_S);
+    WRITE_PERI_REG(SPI_USER2(HSPI), 0);
+    WRITE_PERI_REG(SPI_CTRL(HSPI), SPI_WR_BIT_ORDER | SPI_RD_BIT_ORDER);
+    WRITE_PERI_REG(SPI_SLAVE(HSPI), SPI_SLAVE_MODE);
+    hspiSlaveReset();
+#endif
+}
+void SenvilleAURADisp::hspiSlaveReset() {
+#ifdef DISP_HSPI_CAPTURE
+    SET_PERI_REG_MASK(SPI_SLAVE(HSPI), SPI_SYNC_RESET);
+    CLEAR_PERI_REG_MASK(SPI_SLAVE(HSPI), SPI_SYNC_RESET);
+#endif
+}
+// From the interrupt with a whole frame in displayBuff, kept if it differs from the
+// one before.  With the ring full it is dropped and tried again on the next frame.
+void SenvilleAURADisp::pushFrame() {
+    if(memcmp(displayBuffLast, (const uint8_t *)displayBuff, DISPLAY_BYTE_SIZE) == 0) return;
+    if((uint8_t)(ringHead - ringTail) >= DISP_RING_FRAMES) {
+        ringDropped++;
+        return;
+    }
+    DispFrame &f = ring[ringHead % DISP_RING_FRAMES];
+    for(uint8_t i = 0; i < DISPLAY_BYTE_SIZE; i++) {
+        f.bytes[i] = displayBuffLast[i] = displayBuff[i];
+    }
+    f.ms = millis();
+    ringHead++;
+}
+bool SenvilleAURADisp::nextFrame(DispFrame &frame) {
+    if(ringTail == ringHead) return false;
+    frame = ring[ringTail % DISP_RING_FRAMES];
+    ringTail++;
+    return true;
+}
+bool SenvilleAURADisp::nextUpdate() {
+    DispFrame f;
+    while(this->nextFrame(f)) {
+        if(this->show(f)) return true;
     }
-    return !newVal;
+    return false;
+}
+bool SenvilleAURADisp::show(const DispFrame &frame) {
+    // Supress results with spaces -- due to flashing
+    if(frame.bytes[DISP_CHAR1] == DISPLAY_MASK || frame.bytes[DISP_CHAR2] == DISPLAY_MASK) return false;
+    shown = frame;
+    return true;
+}
+unsigned long SenvilleAURADisp::getUpdateMs() {
+    return shown.ms;
 }
-#define APND_CHARBUFF(pos,buf,arg0,arg1) (pos) = strlen(buf); sprintf(&(buf)[(pos)],arg0,arg1);
-char *SenvilleAURADisp::toBuff(char *buf) {
-    int pos = 0;
-    sprintf(buf,"{" STAT_DISPRAW ":0x");
+bool SenvilleAURADisp::hasUpdate() {
+    bool updated = false;
+    while(this->nextUpdate()) updated = true;
+    return updated;
+}
+unsigned long SenvilleAURADisp::getDroppedFrames() {
+    return ringDropped;
+}
+bool SenvilleAURADisp::toBuff(BuffWriter &out) {
+    out.str("{" STAT_DISPRAW ":0x");
     for(uint8_t ptr = 0; ptr < DISP_LEDS; ptr++) {
-        APND_CHARBUFF(pos,buf,(displayBuff[ptr]<0x10?"0%s":"%s"), "")
-        APND_CHARBUFF(pos,buf,"%0X", displayBuff[ptr])
+        out.hex(shown.bytes[ptr], 2);
     }
-    APND_CHARBUFF(pos,buf,", " STAT_DISP ":\"%s", displayBytetoAscii(displayBuff[DISP_CHAR1]))
-    APND_CHARBUFF(pos,buf,"%s\"", displayBytetoAscii(displayBuff[DISP_CHAR2]))
-    APND_CHARBUFF(pos,buf,", " STAT_ONTME ":%ld }", millis())
+    out.str(", " STAT_DISP ":\"").str(displayBytetoAscii(shown.bytes[DISP_CHAR1]))
+       .str(displayBytetoAscii(shown.bytes[DISP_CHAR2])).chr('"');
+    out.str(", " STAT_ONTME ":").num(millis()).str(" }");
+    return !out.overflow();
+}
+char *SenvilleAURADisp::toBuff(char *buf, size_t size) {
+    BuffWriter out(buf, size);
+    this->toBuff(out);
     return buf;
 }
-char *SenvilleAURADisp::asciiDisplay(char *buf) {
-  int pos = 0;
-  sprintf(buf,"%s", displayBytetoAscii(displayBuff[DISP_CHAR1]));
-  APND_CHARBUFF(pos,buf,"%s", displayBytetoAscii(displayBuff[DISP_CHAR2]))
+bool propertiesToBuff(BuffWriter &out, const Properties *props, int cnt) {
+    bool first = true;
+    out.chr('{');
+    for(int i = 0; i < cnt; i++) {
+        if(props[i].key[0] == 0x00) continue;
+        if(!first) out.str(", ");
+        out.str(props[i].key, strnlen(props[i].key, DISP_MAXSTRINGPERCODE)).chr(':').num(props[i].value);
+        first = false;
+    }
+    out.chr('}');
+    return !out.overflow();
+}
+char *SenvilleAURADisp::asciiDisplay(char *buf, size_t size, DispContext context) {
+  BuffWriter out(buf, size);
+  out.str(displayBytetoAscii(shown.bytes[DISP_CHAR1], context)).str(displayBytetoAscii(shown.bytes[DISP_CHAR2]));
   return buf;
 }
 //
@@ -221,8 +313,8 @@ void SenvilleAURADisp::handler() {
       bitPtr = 0;
       displayBuff[displayPtr % DISPLAY_BYTE_SIZE] = rdByte & DISPLAY_MASK;
       displayPtr++;
-      if(displayPtr % DISPLAY_BYTE_SIZE == 0) {
-        this->listenStop(); // end when we've got 3 bytes
+      if(displayPtr == DISPLAY_BYTE_SIZE) {
+        pushFrame(); // got 3 bytes, the next sync starts the next frame
       }
     }
     sei();
@@ -230,6 +322,23 @@ void SenvilleAURADisp::handler() {
 // Reset to first byte. reset bits for sure alignment
 void SenvilleAURADisp::handleSynch() {
     cli();
+#ifdef DISP_HSPI_CAPTURE
+    if(capture == DispHspi) {
+        // Bytes between two LED_INTER edges are one frame, each edge ends one and
+        // starts the next
+        if(hspiArmed) {
+            uint32_t w = READ_PERI_REG(SPI_W0(HSPI));
+            for(uint8_t i = 0; i < DISPLAY_BYTE_SIZE; i++) {
+                displayBuff[i] = (w >> (i * BITSINBYTE)) & DISPLAY_MASK;
+            }
+            pushFrame();
+        }
+        hspiSlaveReset();
+        hspiArmed = true;
+        sei();
+        return;
+    }
+#endif
     displayPtr = 0;
     bitPtr = 0;
     #ifdef DEBUG
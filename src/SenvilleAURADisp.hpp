@@ -61,7 +61,7 @@
  * -- Meaning of values below : Range: 00-FF hex value of minutes running
  *    CT - Compressor continuous running time (Example: FF)
  * -- Meaning of values below : Range: 00-99 meanings unknown, decimal values
- *    5T - (ST) Causes of compressor stop (Example: 07)
+ *    ST - (5T on the display) Causes of compressor stop (Example: 07)
  * -- Meaning of values below : Range: 00-FF meanings unknown, hex values
  *    A0 - Reserve/unknown (Example: 00) (any ideas guys?  for which model?)
  *    A1 - Reserve/unknown (Example: 00)
@@ -86,6 +86,7 @@
 #else
 #include <SmingCore.h>
 #endif
+#include "BuffWriter.hpp"
 
 #define DISPLAY_BYTE_SIZE 3
 #define LED_INTER 4 /* GPIO4 - Pin D2 */
@@ -93,6 +94,12 @@
 #define CLK_HSPI 14  /* GPIO14 - Pin D5 */
 #define DEBUG_PIN 15 /* GPIO15 - Pin D8 */
 
+// How the display bytes are read.  DispBitBang takes an interrupt per CLK edge and
+// reads DATA; DispHspi has the HSPI peripheral clock them in as a slave (HCS, the
+// DEBUG_PIN, held low) and takes one interrupt per frame on LED_INTER.  Sming only,
+// and not yet checked on the hardware.
+typedef enum DispCaptureE {DispBitBang, DispHspi} DispCapture;
+
 #define SENVILLEAURA_PROPERTY_LABELS F(\
   "T1\0"\
   "T2\0"\
@@ -107,7 +114,7 @@
   "0F\0"\
   "LA\0"\
   "CT\0"\
-  "5T\0"\
+  "ST\0"\
   "A0\0"\
   "A1\0"\
   "b0\0"\
@@ -123,32 +130,62 @@
   "Td")
 
 #define DISP_MAXSTRINGPERCODE 3
-typedef struct displyMapAsciiS {
-    uint8_t dispCode;
-    char asciiVal[DISP_MAXSTRINGPERCODE];
-    displyMapAsciiS(uint8_t code, const char *ascii) {
-        dispCode = code;
-        memcpy(asciiVal,ascii,DISP_MAXSTRINGPERCODE * sizeof(char));
-    }
-} DisplayMapAscii;
+
+// Display frames are kept as they change, so the ring holds changes rather than
+// time.  A value stepped through in diagnostic mode flashes, a few entries each.
+#if defined(__AVR__)
+#define DISP_RING_FRAMES 8
+#else
+#define DISP_RING_FRAMES 32
+#endif
+
+typedef struct DispFrameS {
+    uint8_t bytes[DISPLAY_BYTE_SIZE]; // masked, two characters then the LEDs
+    unsigned long ms;                 // millis() as the frame was first seen
+} DispFrame;
+
+// Glyphs that are a digit or a letter read as the digit in a value, the letter at the
+// start of a label
+typedef enum DispContextE {DispValue, DispLabel} DispContext;
 
 class SenvilleAURADisp {
 private:
     static volatile short bitPtr;
     static volatile uint8_t rdByte;
     static volatile uint8_t displayPtr;
-    static volatile uint8_t displayBuff[DISPLAY_BYTE_SIZE];
-    static volatile uint8_t displayBuffLast[DISPLAY_BYTE_SIZE];
+    static volatile uint8_t displayBuff[DISPLAY_BYTE_SIZE]; // frame coming in
+    static uint8_t displayBuffLast[DISPLAY_BYTE_SIZE];      // last frame put in the ring
+    static DispFrame ring[DISP_RING_FRAMES];
+    static volatile uint8_t ringHead;        // next free, free running
+    static volatile uint8_t ringTail;        // next for the loop, free running
+    static volatile unsigned long ringDropped;
+    static volatile bool listening;
+    DispFrame shown;                         // frame of the last update
+    static void pushFrame();
+    static DispCapture capture;
+    static volatile bool hspiArmed; // slave reset at a frame start, next LED_INTER ends it
+    static void hspiSlaveInit();
+    static void hspiSlaveReset();
 public:
-    static const DisplayMapAscii displayMap[];
-
-    SenvilleAURADisp();
+    SenvilleAURADisp(DispCapture pcapture = DispBitBang);
     ~SenvilleAURADisp();
-    bool hasUpdate();
-    char *toBuff(char *buf); // to json string
-    char *asciiDisplay(char *buff); // to string buffer of just desplay value converted to ascii string
+    // Frames in the order the display changed, oldest first.  False once the ring is empty.
+    bool nextFrame(DispFrame &frame);
+    // Moves on to the next frame with both characters lit, a flashing display blanks
+    // between showings.  False when there is none; toBuff() and asciiDisplay() then
+    // still give the last one.
+    bool nextUpdate();
+    // As nextUpdate() for a frame the caller took with nextFrame(), false if it is blank
+    bool show(const DispFrame &frame);
+    unsigned long getUpdateMs(); // when the frame of the last update was first seen
+    bool hasUpdate();            // takes every update waiting, true if there was one
+    unsigned long getDroppedFrames(); // changes lost with the ring full
+    bool toBuff(BuffWriter &out); // to json string, false if out ran out of room
+    char *toBuff(char *buf, size_t size);
+    char *asciiDisplay(char *buff, size_t size, DispContext context = DispValue); // to string buffer of just desplay value converted to ascii string
+    static const char *displayBytetoAscii(uint8_t b, DispContext context = DispValue);
     static int alphaToInt(char *value); // convert a property str value to an integer value
-    void listen(); // pin is re-defined for listening
+    void listen(); // pin is re-defined for listening, frames are taken until listenStop()
     void listenStop(); // Stops interrupts, important for serial communication etc.
     void handler();
     void handleSynch();
@@ -174,4 +211,7 @@ typedef struct PropertiesS {
   };
 } Properties;
 
+// {key:value, ...} of the properties with a key, false if out ran out of room
+bool propertiesToBuff(BuffWriter &out, const Properties *props, int cnt = DISP_PROPERTIES);
+
 #endif /* SenvilleAURADisp_hpp */
@@ -0,0 +1,177 @@
+//
+//  SenvilleDispFilter.cpp
+//
+
+#include "SenvilleDispFilter.hpp"
+
+#define DISP_BLANK 0xFE
+
+SenvilleDispFilter::SenvilleDispFilter(const char *plabels, size_t plabelsLen) {
+    this->labels = plabels;
+    this->labelsLen = plabelsLen;
+    this->reset();
+}
+
+void SenvilleDispFilter::reset() {
+    for(uint8_t t = 0; t < DISP_TRACKS; t++) this->resetTrack((DispTrack)t);
+    memset(this->run, DISP_BLANK, sizeof(this->run));
+    this->runTrack = -1;
+    this->runStartMs = 0;
+    this->runVoted = 0;
+}
+void SenvilleDispFilter::resetTrack(DispTrack track) {
+    memset(&this->tracks[track], 0, sizeof(TrackState));
+}
+
+uint8_t SenvilleDispFilter::update(const DispFrame &frame) {
+    // The frame up until now is done, then this one has been seen once
+    uint8_t events = this->vote(frame.ms, true);
+    memcpy(this->run, frame.bytes, DISPLAY_BYTE_SIZE);
+    this->runStartMs = frame.ms;
+    this->runVoted = 0;
+    this->runTrack = this->trackOf(this->run);
+    return events | this->vote(frame.ms, false);
+}
+uint8_t SenvilleDispFilter::poll(unsigned long nowMs) {
+    return this->vote(nowMs, false);
+}
+
+// Some values read as a label too, b2 is 112 degC.  Once the label has
+// settled, anything else showing is its value until the track is reset.
+int8_t SenvilleDispFilter::trackOf(const uint8_t *bytes) {
+    if(bytes[0] == DISP_BLANK || bytes[1] == DISP_BLANK) return -1;
+    char text[DISP_MAXSTRINGPERCODE * 2];
+    TrackState &l = this->tracks[DispTrackLabel];
+    bool label = this->isLabel(bytes);
+    if(label && l.settled) {
+        toText(bytes, DispTrackLabel, text);
+        label = strcmp(text, l.text) == 0;
+    }
+    return label ? DispTrackLabel : DispTrackValue;
+}
+
+// Votes for the frames of the run not yet counted, closing once the next one has come
+uint8_t SenvilleDispFilter::vote(unsigned long nowMs, bool closing) {
+    if(this->runTrack < 0) return DispFilterNone;
+    unsigned long frames = (nowMs - this->runStartMs) / DISP_FRAME_MS + (closing ? 0 : 1);
+    if(frames > DISP_FILTER_WINDOW) frames = DISP_FILTER_WINDOW;
+    uint8_t events = DispFilterNone;
+    // A frame at a time, so it settles on the frame that gave it the majority
+    for(; this->runVoted < frames; this->runVoted++) {
+        events |= this->tally(this->runStartMs + (unsigned long)this->runVoted * DISP_FRAME_MS);
+    }
+    return events;
+}
+
+// One frame's vote on each digit of the run's track
+uint8_t SenvilleDispFilter::tally(unsigned long frameMs) {
+    TrackState &t = this->tracks[this->runTrack];
+    uint8_t total, confidence = 100;
+    bool majority = true;
+    unsigned long firstMs = 0;
+    for(uint8_t i = 0; i < DISP_DIGITS; i++) {
+        addVotes(t.digit[i], this->run[i], frameMs);
+        uint8_t w = winner(t.digit[i], &total);
+        if(i == 0 || (long)(t.digit[i].firstMs[w] - firstMs) > 0) firstMs = t.digit[i].firstMs[w];
+        uint8_t pct = (uint16_t)t.digit[i].votes[w] * 100 / total;
+        if(pct < confidence) confidence = pct;
+        majority = majority && t.digit[i].votes[w] >= DISP_FILTER_QUORUM && pct >= DISP_FILTER_MAJORITY_PCT;
+    }
+    t.confidence = confidence;
+    if(!majority) {
+        t.settled = false;
+        return DispFilterNone;
+    }
+
+    char text[DISP_MAXSTRINGPERCODE * 2];
+    uint8_t codes[DISP_DIGITS];
+    for(uint8_t i = 0; i < DISP_DIGITS; i++) codes[i] = t.digit[i].code[winner(t.digit[i], &total)];
+    toText(codes, this->runTrack, text);
+    // Back to what it settled on before a wobble is nothing new
+    bool same = t.text[0] && strcmp(text, t.text) == 0;
+    // Anything new from a showing that is up and has stayed up, a garbled frame
+    // is gone by the next one however many of them have voted for it
+    if(!same && (memcmp(codes, this->run, DISP_DIGITS) != 0 || this->runVoted + 1 < DISP_FILTER_MIN_RUN)) {
+        t.settled = false;
+        return DispFilterNone;
+    }
+    t.settled = true;
+    if(same) return DispFilterNone;
+    memcpy(t.text, text, sizeof(t.text));
+    t.settledAt = frameMs;
+    t.firstMs = firstMs;
+    if(this->runTrack == DispTrackLabel) {
+        // A new property, its value is still to come
+        this->resetTrack(DispTrackValue);
+        return DispFilterLabel;
+    }
+    return DispFilterValue;
+}
+
+// A vote for code, taking the place of the weakest other code if it is new.
+// Halving all once there are more than a window of votes lets an old value fade out.
+void SenvilleDispFilter::addVotes(DigitVotes &d, uint8_t code, unsigned long ms) {
+    uint8_t slot = 0;
+    for(uint8_t i = 0; i < DISP_FILTER_CANDIDATES; i++) {
+        if(d.votes[i] && d.code[i] == code) {
+            slot = i;
+            break;
+        }
+        if(d.votes[i] < d.votes[slot]) slot = i;
+    }
+    if(d.code[slot] != code || d.votes[slot] == 0) {
+        d.code[slot] = code;
+        d.votes[slot] = 0;
+        d.firstMs[slot] = ms;
+    }
+    d.votes[slot]++;
+    uint8_t sum = 0;
+    for(uint8_t i = 0; i < DISP_FILTER_CANDIDATES; i++) sum += d.votes[i];
+    if(sum > DISP_FILTER_WINDOW) {
+        for(uint8_t i = 0; i < DISP_FILTER_CANDIDATES; i++) d.votes[i] /= 2;
+    }
+}
+uint8_t SenvilleDispFilter::winner(const DigitVotes &d, uint8_t *total) {
+    uint8_t w = 0;
+    *total = 0;
+    for(uint8_t i = 0; i < DISP_FILTER_CANDIDATES; i++) {
+        *total += d.votes[i];
+        if(d.votes[i] > d.votes[w]) w = i;
+    }
+    return w;
+}
+
+// The first character of a label reads as the letter where it could be a digit
+void SenvilleDispFilter::toText(const uint8_t *codes, int8_t track, char *text) {
+    BuffWriter out(text, DISP_MAXSTRINGPERCODE * 2);
+    out.str(SenvilleAURADisp::displayBytetoAscii(codes[0], track == DispTrackLabel ? DispLabel : DispValue))
+       .str(SenvilleAURADisp::displayBytetoAscii(codes[1]));
+}
+bool SenvilleDispFilter::isLabel(const uint8_t *bytes) {
+    char text[DISP_MAXSTRINGPERCODE * 2];
+    toText(bytes, DispTrackLabel, text);
+    return this->indexOf(text) >= 0;
+}
+int8_t SenvilleDispFilter::indexOf(const char *text) {
+    int8_t n = 0;
+    for(size_t i = 0; i < this->labelsLen; i += strlen(this->labels + i) + 1, n++) {
+        if(strcmp(this->labels + i, text) == 0) return n;
+    }
+    return -1;
+}
+
+bool SenvilleDispFilter::isSettled(DispTrack track) {
+    return this->tracks[track].settled;
+}
+const char *SenvilleDispFilter::getText(DispTrack track) {
+    return this->tracks[track].text;
+}
+uint8_t SenvilleDispFilter::getConfidence(DispTrack track) {
+    return this->tracks[track].confidence;
+}
+unsigned long SenvilleDispFilter::getSettleMs(DispTrack track) {
+    return this->tracks[track].settledAt - this->tracks[track].firstMs;
+}
+unsigned long SenvilleDispFilter::getSettledAt(DispTrack track) {
+    return this->tracks[track].settledAt;
+}
@@ -0,0 +1,87 @@
+//
+//  SenvilleDispFilter.hpp
+//
+//  Settles what the display is showing from the frames of the display ring.
+//  The digits flash in normal mode, and in diagnostic mode the display
+//  blinks between a property label and its value, so a single frame is not
+//  to be trusted.  Each showing is put down as a label or a value, and each
+//  of its two digits votes, a vote per frame it was up, for its segment
+//  code on that track.  A track settles once both digits have a clear
+//  majority, which for a clean display is a few frames after it appears.
+//
+//      SenvilleDispFilter filter(labels, labelsLen);
+//      while(disp->nextFrame(frame)) settled |= filter.update(frame);
+//      settled |= filter.poll(millis());
+//      if(settled & DispFilterValue) ... filter.getText(DispTrackValue) ...
+//
+
+#ifndef SenvilleDispFilter_hpp
+#define SenvilleDispFilter_hpp
+
+#include "SenvilleAURADisp.hpp"
+
+#define DISP_FRAME_MS 12            /* a frame each LED_INTER cycle */
+#define DISP_DIGITS 2               /* characters ahead of the LED byte */
+#define DISP_FILTER_QUORUM 3        /* frames a digit needs, at least, to settle */
+#define DISP_FILTER_MAJORITY_PCT 75 /* of the votes on the digit */
+#define DISP_FILTER_WINDOW 8        /* frames of votes kept, older ones fade by half */
+#define DISP_FILTER_CANDIDATES 3    /* codes tallied per digit */
+#define DISP_FILTER_MIN_RUN DISP_FILTER_QUORUM /* frames in a row a new text must be up to settle */
+
+typedef enum DispTrackE {DispTrackLabel, DispTrackValue, DISP_TRACKS} DispTrack;
+// What update() and poll() return, the tracks that settled on something new
+typedef enum DispFilterEventE {DispFilterNone = 0x00, DispFilterLabel = 0x01, DispFilterValue = 0x02} DispFilterEvent;
+
+class SenvilleDispFilter {
+public:
+    // labels is the property label list, each one \0 terminated, len bytes in all
+    SenvilleDispFilter(const char *plabels, size_t plabelsLen);
+
+    void reset();                 // forget both tracks, as when the sweep starts over
+    // Forget one, the label as the sweep steps to the next property
+    void resetTrack(DispTrack track);
+    // Every frame from the display ring in order, blank ones too
+    uint8_t update(const DispFrame &frame);
+    // Counts the frame still up at nowMs, for a display that has stopped changing
+    uint8_t poll(unsigned long nowMs);
+
+    bool isSettled(DispTrack track);
+    const char *getText(DispTrack track);     // as it settled, "" until it has
+    uint8_t getConfidence(DispTrack track);   // % of the votes with the weaker digit's winner
+    unsigned long getSettleMs(DispTrack track); // from the settled text first showing
+    unsigned long getSettledAt(DispTrack track); // millis() of the frame that settled it
+
+    bool isLabel(const uint8_t *bytes); // the two characters read as a property label
+    int8_t indexOf(const char *text);   // of the label in the list, -1 if it is none
+
+private:
+    typedef struct DigitVotesS {
+        uint8_t code[DISP_FILTER_CANDIDATES];
+        uint8_t votes[DISP_FILTER_CANDIDATES];
+        unsigned long firstMs[DISP_FILTER_CANDIDATES]; // when it was first in the tally
+    } DigitVotes;
+    typedef struct TrackStateS {
+        DigitVotes digit[DISP_DIGITS];
+        bool settled;
+        char text[DISP_MAXSTRINGPERCODE * 2];
+        uint8_t confidence;
+        unsigned long firstMs, settledAt; // the settled text first seen, and settling
+    } TrackState;
+
+    const char *labels;
+    size_t labelsLen;
+    TrackState tracks[DISP_TRACKS];
+    uint8_t run[DISPLAY_BYTE_SIZE]; // the frame up now
+    int8_t runTrack;                // -1 blank
+    unsigned long runStartMs;
+    uint8_t runVoted;               // frames of it voted so far
+
+    int8_t trackOf(const uint8_t *bytes);
+    uint8_t vote(unsigned long nowMs, bool closing);
+    uint8_t tally(unsigned long frameMs);
+    static void addVotes(DigitVotes &d, uint8_t code, unsigned long ms);
+    static uint8_t winner(const DigitVotes &d, uint8_t *total);
+    static void toText(const uint8_t *codes, int8_t track, char *text);
+};
+
+#endif /* SenvilleDispFilter_hpp */
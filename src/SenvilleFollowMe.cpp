@@ -0,0 +1,123 @@
+//
+//  SenvilleFollowMe.cpp
+//
+
+#include "SenvilleFollowMe.hpp"
+
+SenvilleFollowMe::SenvilleFollowMe(SenvilleAURA *psenville, unsigned long pfixedIntervalMs) {
+    this->senville = psenville;
+    this->fixedIntervalMs = pfixedIntervalMs;
+    this->run = FmOff;
+    this->hasMeasured = false;
+    this->measured = 0;
+    this->sentTemp = 0;
+    this->lastSentMs = 0;
+    this->fixedLastMs = 0;
+    this->rnd = 0x2545F491;
+    this->jitterMs = this->nextJitter();
+    this->sent = 0;
+    this->airtimeUs = 0;
+    this->fixedSent = 0;
+    this->fixedAirtimeUs = 0;
+}
+
+void SenvilleFollowMe::setMeasured(uint8_t tempC) {
+    this->measured = tempC;
+    this->hasMeasured = true;
+}
+bool SenvilleFollowMe::start() {
+    if(!this->hasMeasured) return false;
+    if(this->run != FmRunning) this->run = FmStarting;
+    return true;
+}
+void SenvilleFollowMe::stop() {
+    if(this->run == FmStarting) {
+        this->run = FmOff;
+    } else if(this->run == FmRunning) {
+        this->run = FmStopping;
+    }
+}
+SenvilleFollowMe::FmRun SenvilleFollowMe::getRun() {
+    return this->run;
+}
+
+unsigned long SenvilleFollowMe::getNextSlotMs() {
+    return this->lastSentMs + FM_KEEPALIVE_MS - FM_MARGIN_MS - this->jitterMs;
+}
+
+uint8_t *SenvilleFollowMe::poll(uint8_t *msg, unsigned long nowMs, bool busy) {
+    switch(this->run) {
+        case FmStarting:
+            if(busy) return NULL;
+            this->fixedLastMs = nowMs;
+            return this->send(msg, FmStart, nowMs);
+        case FmStopping:
+            if(busy) return NULL;
+            this->run = FmOff;
+            return this->send(msg, FmStop, nowMs);
+        case FmRunning:
+            break;
+        default:
+            return NULL;
+    }
+
+    // What a fixed interval sender would have put on the wire by now
+    unsigned long frameUs = this->sent ? this->airtimeUs / this->sent : 0;
+    while(nowMs - this->fixedLastMs >= this->fixedIntervalMs) {
+        this->fixedLastMs += this->fixedIntervalMs;
+        this->fixedSent++;
+        this->fixedAirtimeUs += frameUs;
+    }
+
+    unsigned long since = nowMs - this->lastSentMs;
+    if(since >= FM_KEEPALIVE_MS - FM_URGENT_MS) {
+        return this->send(msg, FmUpdateTemp, nowMs);
+    }
+    if(busy) return NULL;
+    if(since >= FM_KEEPALIVE_MS - FM_MARGIN_MS - this->jitterMs
+       || (this->measured != this->sentTemp && since >= FM_MIN_GAP_MS)) {
+        return this->send(msg, FmUpdateTemp, nowMs);
+    }
+    return NULL;
+}
+
+uint8_t *SenvilleFollowMe::send(uint8_t *msg, FollowMeState state, unsigned long nowMs) {
+    this->senville->followMeCmd(msg, state, this->measured);
+    unsigned long us = SenvilleAURA::frameAirtimeUs(msg);
+    this->sent++;
+    this->airtimeUs += us;
+    // Starting and stopping are sent by both
+    if(state != FmUpdateTemp) {
+        this->fixedSent++;
+        this->fixedAirtimeUs += us;
+    }
+    if(state == FmStart) this->run = FmRunning;
+    this->sentTemp = this->measured;
+    this->lastSentMs = nowMs;
+    this->jitterMs = this->nextJitter();
+    return msg;
+}
+
+// xorshift32, enough to spread the slots
+unsigned long SenvilleFollowMe::nextJitter() {
+    this->rnd ^= this->rnd << 13;
+    this->rnd ^= this->rnd >> 17;
+    this->rnd ^= this->rnd << 5;
+    return this->rnd % FM_JITTER_MS;
+}
+
+unsigned long SenvilleFollowMe::getSent() {
+    return this->sent;
+}
+unsigned long SenvilleFollowMe::getAirtimeMs() {
+    return this->airtimeUs / 1000;
+}
+unsigned long SenvilleFollowMe::getFixedSent() {
+    return this->fixedSent;
+}
+unsigned long SenvilleFollowMe::getFixedAirtimeMs() {
+    return this->fixedAirtimeUs / 1000;
+}
+long SenvilleFollowMe::getSavedMs() {
+    return (long)this->getFixedAirtimeMs() - (long)this->getAirtimeMs();
+}
@@ -0,0 +1,76 @@
+//
+//  SenvilleFollowMe.hpp
+//
+//  Follow-Me from the node, in place of a controller pushing {Instr:4, ...}
+//  on a timer.  The unit drops Follow-Me if it hears nothing for about 3
+//  minutes, so a frame goes out when the measured temperature changes and
+//  otherwise only as that deadline nears.  Keep-alive slots are jittered so
+//  they do not line up with the display property scan, and while the caller
+//  says the IR link is busy frames wait unless the deadline is close.
+//
+//      SenvilleFollowMe followMe(senville);
+//      followMe.setMeasured(21);
+//      followMe.start();
+//      ...
+//      if(followMe.poll(msg, millis(), busy)) link->sendAsync(msg);
+//
+
+#ifndef SenvilleFollowMe_hpp
+#define SenvilleFollowMe_hpp
+
+#include "SenvilleAURA.hpp"
+
+#define FM_KEEPALIVE_MS 180000UL     /* unit gives up on Follow-Me after this */
+#define FM_MARGIN_MS 30000UL         /* keep-alive slot is this far before the deadline, */
+#define FM_JITTER_MS 20000UL         /*   less up to this much more */
+#define FM_URGENT_MS 10000UL         /* this near the deadline it is sent even when busy */
+#define FM_MIN_GAP_MS 5000UL         /* temperature changes sent no closer than this */
+#define FM_FIXED_INTERVAL_MS 60000UL /* the fixed interval sender compared against */
+
+class SenvilleFollowMe {
+public:
+    enum FmRun : uint8_t {FmOff, FmStarting, FmRunning, FmStopping};
+
+    SenvilleFollowMe(SenvilleAURA *psenville, unsigned long pfixedIntervalMs = FM_FIXED_INTERVAL_MS);
+
+    // Room temperature, degC.  Sent at the next slot if it differs from the last one sent.
+    void setMeasured(uint8_t tempC);
+    // Start needs a measured temperature, false if there is none yet
+    bool start();
+    void stop();
+    FmRun getRun();
+
+    // The frame due now written into msg, NULL if there is none.  busy holds back
+    // all but a keep-alive about to miss its deadline.
+    uint8_t *poll(uint8_t *msg, unsigned long nowMs, bool busy = false);
+    // When the next keep-alive goes out if nothing changes, valid while running
+    unsigned long getNextSlotMs();
+
+    // Frames sent and their time on the wire, then the same for a sender of one
+    // update every fixed interval over the same run, start and stop included
+    unsigned long getSent();
+    unsigned long getAirtimeMs();
+    unsigned long getFixedSent();
+    unsigned long getFixedAirtimeMs();
+    long getSavedMs();
+
+private:
+    SenvilleAURA *senville;
+    unsigned long fixedIntervalMs;
+    FmRun run;
+    bool hasMeasured;
+    uint8_t measured;
+    uint8_t sentTemp;
+    unsigned long lastSentMs;
+    unsigned long jitterMs;
+    unsigned long fixedLastMs;
+    uint32_t rnd;
+
+    unsigned long sent, airtimeUs;
+    unsigned long fixedSent, fixedAirtimeUs;
+
+    uint8_t *send(uint8_t *msg, FollowMeState state, unsigned long nowMs);
+    unsigned long nextJitter();
+};
+
+#endif /* SenvilleFollowMe_hpp */
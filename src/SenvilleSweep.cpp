@@ -0,0 +1,353 @@
+//
+//  SenvilleSweep.cpp
+//
+
+#include "SenvilleSweep.hpp"
+
+SenvilleSweep::SenvilleSweep(SenvilleDispFilter *pfilter, Properties *pprops) {
+    this->filter = pfilter;
+    this->props = pprops;
+    this->run = SweepIdle;
+    this->wanted = this->hot = SWEEP_ALL;
+    this->left = 0;
+    this->wrap = false;
+    this->sweeps = 0;
+    this->target = -1;
+    this->at = -1;
+    this->stepFrom = -1;
+    this->stepDir = 0;
+    this->stepLen = 0;
+    this->pending = 0;
+    this->landMs = 0;
+    this->landing = false;
+    this->entrySent = 0;
+    this->tries = 0;
+    this->reentries = 0;
+    this->sweepStartMs = 0;
+    this->sweepEndMs = 0;
+    this->targetMs = 0;
+    this->stepMs = 0;
+    this->lastStepMs = 0;
+    this->stepMaxMs = 0;
+    this->lastIndex = -1;
+    this->lastValue[0] = 0x00;
+    this->lastConfidence = 0;
+    this->lastSettleMs = 0;
+    this->planned = 0;
+    this->captured = 0;
+    this->missed = 0;
+    this->sent = 0;
+    this->retries = 0;
+    this->totalReentries = 0;
+}
+
+bool SenvilleSweep::setProperties(const char *spec, size_t len) {
+    uint32_t pwanted = 0, phot = 0;
+    bool cold = false;
+    size_t i = 0;
+    if(len == 0) {
+        this->setProperties(SWEEP_ALL, SWEEP_ALL);
+        return true;
+    }
+    while(i < len) {
+        if(spec[i] == ' ' || spec[i] == ',') {
+            i++;
+        } else if(spec[i] == '/') {
+            cold = true;
+            i++;
+        } else {
+            char label[DISP_MAXSTRINGPERCODE];
+            size_t n = 0;
+            for(; i < len && spec[i] != ' ' && spec[i] != ',' && spec[i] != '/'; i++) {
+                if(n == DISP_MAXSTRINGPERCODE - 1) return false;
+                label[n++] = spec[i];
+            }
+            label[n] = 0x00;
+            int8_t index = this->filter->indexOf(label);
+            if(index < 0) return false;
+            pwanted |= 1UL << index;
+            if(!cold) phot |= 1UL << index;
+        }
+    }
+    this->setProperties(pwanted, phot);
+    return true;
+}
+void SenvilleSweep::setProperties(uint32_t pwanted, uint32_t phot) {
+    this->hot = phot & SWEEP_ALL;
+    this->wanted = (pwanted | phot) & SWEEP_ALL;
+    this->sweeps = 0;                 // the cold ones go in the next one
+}
+uint32_t SenvilleSweep::getWanted() {
+    return this->wanted;
+}
+uint32_t SenvilleSweep::getHot() {
+    return this->hot;
+}
+void SenvilleSweep::setWrap(bool pwrap) {
+    this->wrap = pwrap;
+}
+
+bool SenvilleSweep::start(unsigned long nowMs) {
+    uint32_t due = this->sweeps++ % SWEEP_COLD_EVERY == 0 ? this->wanted : this->hot;
+    if(due == 0) return false;
+    this->left = due;
+    this->planned = 0;
+    for(int i = 0; i < DISP_PROPERTIES; i++) {
+        if(!((due >> i) & 0x01)) continue;
+        this->props[i].value = 0;
+        this->planned++;
+    }
+    this->target = this->choose(SWEEP_ENTRY_AT);
+    this->tries = 0;
+    this->reentries = 0;
+    this->sweepStartMs = this->sweepEndMs = nowMs;
+    this->stepMaxMs = 0;
+    this->captured = 0;
+    this->missed = 0;
+    this->sent = 0;
+    this->enter(nowMs);
+    return true;
+}
+void SenvilleSweep::stop() {
+    this->run = SweepIdle;
+    this->target = -1;
+}
+SenvilleSweep::SweepRun SenvilleSweep::getRun() {
+    return this->run;
+}
+bool SenvilleSweep::isRunning() {
+    return this->run != SweepIdle;
+}
+
+uint8_t SenvilleSweep::update(const DispFrame &frame) {
+    // The unit starts the new label as the command lands, frames before then are the old one
+    if(this->landing && (long)(frame.ms - this->landMs) >= 0) {
+        this->filter->resetTrack(DispTrackLabel);
+        this->landing = false;
+    }
+    return this->filter->update(frame);
+}
+
+uint8_t SenvilleSweep::poll(uint8_t *msg, unsigned long nowMs, uint8_t settled) {
+    if(this->run == SweepIdle) return SweepNone;
+    this->sweepEndMs = nowMs;
+    if(this->run == SweepEntering) {
+        if(nowMs - this->stepMs < SWEEP_CMD_GAP_MS) return SweepNone;
+        Option option = this->entrySent < SWEEP_ENTRY_COMMANDS / 2 ? Option::Led : Option::Direct;
+        if(++this->entrySent == SWEEP_ENTRY_COMMANDS) {
+            // Whichever property it lands on, the first label read says where it is
+            this->filter->reset();
+            this->run = SweepLabel;
+            this->at = this->stepFrom = -1;
+            this->stepLen = this->pending = 0;
+            // The first property from here, once out the others take in the time lost
+            if(this->captured + this->missed == 0 && this->reentries == 0) this->targetMs = nowMs;
+        }
+        return this->send(msg, option, nowMs);
+    }
+    // The rest of a step, labels on the way are not looked at
+    if(this->pending) {
+        if(nowMs - this->stepMs < SWEEP_CMD_GAP_MS) return SweepNone;
+        this->pending--;
+        return this->send(msg, this->stepDir > 0 ? Option::Led : Option::Direct, nowMs);
+    }
+
+    if(settled & DispFilterLabel) {
+        int8_t shown = this->filter->indexOf(this->filter->getText(DispTrackLabel));
+        // Plan from the first label read in diagnostic mode
+        if(shown >= 0 && this->at < 0 && this->stepFrom < 0) this->target = this->choose(shown);
+        // How far along the last step the label is, past its end if it is not on the way
+        int8_t along = shown < 0 || this->stepFrom < 0 ? 0 : this->hops(this->stepFrom, shown) * this->stepDir;
+        if(this->stepDir == 0 && shown != this->stepFrom) along = DISP_PROPERTIES;
+        if(shown == this->target) {
+            this->at = shown;
+            this->run = SweepValue;
+        } else if(shown >= 0 && this->stepFrom >= 0 && (along < 0 || along > this->stepLen)) {
+            // Nowhere a step could have gone, a value that reads as a label
+            this->filter->resetTrack(DispTrackLabel);
+        } else if(shown >= 0 && shown == this->stepFrom) {
+            if(nowMs - this->stepMs < SWEEP_MISS_MS) {
+                // Frames from before the step took
+                this->filter->resetTrack(DispTrackLabel);
+            } else {
+                // Still up well after the step, the unit never saw it
+                return this->retry(msg, nowMs);
+            }
+        } else if(shown >= 0) {
+            this->at = shown;
+            return this->step(msg, nowMs);
+        }
+    }
+    // The filter settles the label first and starts the value over, so a value
+    // settled since is this label's, even if a garbled frame has it wobbling now
+    if(this->run == SweepValue && this->filter->getText(DispTrackValue)[0]) {
+        strcpy(this->lastValue, this->filter->getText(DispTrackValue));
+        this->props[this->target] = PropertiesS((char *)this->filter->getText(DispTrackLabel), this->lastValue);
+        this->lastIndex = this->target;
+        this->lastConfidence = this->filter->getConfidence(DispTrackValue);
+        this->lastSettleMs = this->filter->getSettleMs(DispTrackValue);
+        this->lastStepMs = nowMs - this->targetMs;
+        if(this->lastStepMs > this->stepMaxMs) this->stepMaxMs = this->lastStepMs;
+        this->captured++;
+        return SweepCaptured | this->next(msg, nowMs);
+    }
+
+    if(nowMs - this->stepMs >= SWEEP_STEP_TIMEOUT_MS) return this->retry(msg, nowMs);
+    return SweepNone;
+}
+
+// The property left to read that starts the fewest commands over all of them from
+// here.  Going one way and coming back covers the properties on both sides, so it
+// is the nearest either side, whichever end of the tour is closer to come back from.
+int8_t SenvilleSweep::choose(int8_t from) {
+    if(this->left == 0) return -1;
+    if((this->left >> from) & 0x01) return from;
+    int8_t below = -1, above = -1, lo = -1, hi = -1;
+    if(!this->wrap) {
+        for(int8_t i = 0; i < DISP_PROPERTIES; i++) {
+            if(!((this->left >> i) & 0x01)) continue;
+            if(lo < 0) lo = i;
+            hi = i;
+            if(i < from) below = i;
+            else if(above < 0) above = i;
+        }
+        if(below < 0) return above;
+        if(above < 0) return below;
+        return 2 * (from - lo) + (hi - from) <= 2 * (hi - from) + (from - lo) ? below : above;
+    }
+    // Round the ring, each split of those left into the ones reached going up and
+    // the ones reached going down
+    uint8_t up[DISP_PROPERTIES], n = 0;
+    for(uint8_t d = 1; d < DISP_PROPERTIES; d++) {
+        if((this->left >> ((from + d) % DISP_PROPERTIES)) & 0x01) up[n++] = d;
+    }
+    int best = -1;
+    uint8_t bestD = 0;
+    for(uint8_t k = 0; k <= n; k++) {
+        int a = k ? up[k - 1] : 0;                   // farthest going up
+        int b = k < n ? DISP_PROPERTIES - up[k] : 0; // farthest going down
+        int cost = a <= b ? 2 * a + b : a + 2 * b;
+        if(best >= 0 && cost >= best) continue;
+        best = cost;
+        bestD = (a <= b && a > 0) || b == 0 ? up[0] : up[n - 1];
+    }
+    return (from + bestD) % DISP_PROPERTIES;
+}
+
+// Commands from one property to another the shortest way, Led ones positive
+int8_t SenvilleSweep::hops(int8_t from, int8_t to) {
+    int8_t d = to - from;
+    if(this->wrap && d > DISP_PROPERTIES / 2) d -= DISP_PROPERTIES;
+    if(this->wrap && d < -(DISP_PROPERTIES / 2)) d += DISP_PROPERTIES;
+    return d;
+}
+
+// Into diagnostic mode, the commands go out from the next poll
+uint8_t SenvilleSweep::enter(unsigned long nowMs) {
+    this->run = SweepEntering;
+    this->entrySent = 0;
+    this->pending = 0;
+    this->stepMs = nowMs - SWEEP_CMD_GAP_MS;
+    return SweepNone;
+}
+
+// From the label up now to the target, or look again if it is up.  The first
+// command goes now, the rest from the following polls.
+uint8_t SenvilleSweep::step(uint8_t *msg, unsigned long nowMs) {
+    this->run = SweepLabel;
+    this->stepFrom = this->at;
+    this->stepDir = 0;
+    this->stepLen = this->pending = 0;
+    this->stepMs = nowMs;
+    if(this->at < 0 || this->at == this->target) {
+        this->filter->resetTrack(DispTrackLabel);
+        return SweepNone;
+    }
+    int8_t h = this->hops(this->at, this->target);
+    this->stepDir = h > 0 ? 1 : -1;
+    this->stepLen = h * this->stepDir;
+    this->pending = this->stepLen - 1;
+    return this->send(msg, this->stepDir > 0 ? Option::Led : Option::Direct, nowMs);
+}
+
+uint8_t SenvilleSweep::next(uint8_t *msg, unsigned long nowMs) {
+    this->left &= ~(1UL << this->target);
+    this->target = this->choose(this->at >= 0 ? this->at : SWEEP_ENTRY_AT);
+    this->tries = 0;
+    this->targetMs = nowMs;
+    if(this->target < 0) {
+        this->stop();
+        return SweepDone;
+    }
+    return this->step(msg, nowMs);
+}
+
+// Nothing came of the last step.  Without a label the unit has left diagnostic mode.
+uint8_t SenvilleSweep::retry(uint8_t *msg, unsigned long nowMs) {
+    this->retries++;
+    if(!this->filter->isSettled(DispTrackLabel)) {
+        if(++this->reentries > SWEEP_REENTRIES) {
+            this->stop();
+            return SweepDone;
+        }
+        this->totalReentries++;
+        return this->enter(nowMs);
+    }
+    if(++this->tries > SWEEP_RETRIES) {
+        this->missed++;
+        return this->next(msg, nowMs);
+    }
+    return this->step(msg, nowMs);
+}
+
+uint8_t SenvilleSweep::send(uint8_t *msg, Option option, unsigned long nowMs) {
+    SenvilleAURA::optionCmd(msg, option);
+    this->sent++;
+    this->stepMs = nowMs;
+    this->landMs = nowMs + SenvilleAURA::frameAirtimeUs(msg) / 1000;
+    this->landing = true;
+    return SweepSend;
+}
+
+int8_t SenvilleSweep::getProperty() {
+    return this->target;
+}
+int8_t SenvilleSweep::getCapturedIndex() {
+    return this->lastIndex;
+}
+const char *SenvilleSweep::getValue() {
+    return this->lastValue;
+}
+uint8_t SenvilleSweep::getConfidence() {
+    return this->lastConfidence;
+}
+unsigned long SenvilleSweep::getSettleMs() {
+    return this->lastSettleMs;
+}
+unsigned long SenvilleSweep::getStepMs() {
+    return this->lastStepMs;
+}
+unsigned long SenvilleSweep::getSweepMs() {
+    return this->sweepEndMs - this->sweepStartMs;
+}
+unsigned long SenvilleSweep::getStepMaxMs() {
+    return this->stepMaxMs;
+}
+uint8_t SenvilleSweep::getPlanned() {
+    return this->planned;
+}
+uint8_t SenvilleSweep::getCaptured() {
+    return this->captured;
+}
+uint8_t SenvilleSweep::getMissed() {
+    return this->missed;
+}
+unsigned long SenvilleSweep::getSent() {
+    return this->sent;
+}
+unsigned long SenvilleSweep::getRetries() {
+    return this->retries;
+}
+unsigned long SenvilleSweep::getReentries() {
+    return this->totalReentries;
+}
@@ -0,0 +1,137 @@
+//
+//  SenvilleSweep.hpp
+//
+//  Steps the display through the diagnostic mode properties, moving on as
+//  soon as the display filter has settled the label and then the value of
+//  each one rather than on a fixed wait.  Only the properties asked for are
+//  read, the hot ones every sweep and the cold ones every SWEEP_COLD_EVERY
+//  sweeps.  The next one is picked, and Option::Led or Option::Direct sent
+//  toward it as many times as it is away, for the fewest commands over
+//  those left; the unit is taken not to wrap from the last property round
+//  to the first unless setWrap() says it does.  The label it lands on says
+//  whether any of the commands were lost.  A step the unit did not take is
+//  sent again once the old label is still up after SWEEP_MISS_MS; with no
+//  label at all for SWEEP_STEP_TIMEOUT_MS the unit has dropped out of
+//  diagnostic mode and it is entered again, carrying on from the property
+//  it was on.  Each property's latency, from the step toward it to its
+//  value settling, and the whole sweep's are kept.  The unit blinks the
+//  label for about half a second before the value, which bounds how soon
+//  any one property can be read.
+//
+//      SenvilleSweep sweep(filter, properties);
+//      sweep.setProperties("T1 T2 TP / CT ST", 16);
+//      sweep.start(millis());
+//      ...
+//      while(disp->nextFrame(frame)) settled |= sweep.update(frame);
+//      settled |= filter->poll(millis());
+//      uint8_t ev = sweep.poll(msg, millis(), settled);
+//      if(ev & SweepSend) link->sendAsync(msg);
+//      if(ev & SweepCaptured) ... sweep.getValue(), sweep.getStepMs() ...
+//
+
+#ifndef SenvilleSweep_hpp
+#define SenvilleSweep_hpp
+
+#include "SenvilleAURA.hpp"
+#include "SenvilleDispFilter.hpp"
+
+#define SWEEP_ENTRY_COMMANDS 6        /* Led three times then Direct three times */
+#define SWEEP_ENTRY_AT 0              /* property the unit shows once in diagnostic mode */
+#define SWEEP_CMD_GAP_MS 180          /* between commands sent in a row, an option frame's airtime */
+#define SWEEP_MISS_MS 600             /* old label still up this long after a step, it was missed */
+#define SWEEP_STEP_TIMEOUT_MS 2000    /* no label in this long, out of diagnostic mode */
+#define SWEEP_RETRIES 3               /* per property, then it is skipped */
+#define SWEEP_REENTRIES 5             /* per sweep, then it gives up */
+#define SWEEP_SCAN_INTERVAL 50        /* ms, scan() while sweeping so a settled value is acted on */
+#define SWEEP_COLD_EVERY 4            /* sweeps, the cold properties are read in one of this many */
+#define SWEEP_ALL ((1UL << DISP_PROPERTIES) - 1)
+
+// What poll() returns
+typedef enum SweepEventE {
+    SweepNone = 0x00, SweepSend = 0x01, SweepCaptured = 0x02, SweepDone = 0x04
+} SweepEvent;
+
+class SenvilleSweep {
+public:
+    enum SweepRun : uint8_t {SweepIdle, SweepEntering, SweepLabel, SweepValue};
+
+    // Values go into props, DISP_PROPERTIES of them in label order.  All of them are hot.
+    SenvilleSweep(SenvilleDispFilter *pfilter, Properties *pprops);
+
+    // Labels of the hot properties, then after a '/' the cold ones: "T1 T2 TP / CT ST".
+    // Empty for all of them hot.  False, and nothing changed, on a label that is not one.
+    bool setProperties(const char *spec, size_t len);
+    void setProperties(uint32_t pwanted, uint32_t phot);  // bit per property, hot ones wanted too
+    uint32_t getWanted();
+    uint32_t getHot();
+    void setWrap(bool pwrap);         // Led from the last property shows the first, Direct back
+
+    // Clears the values of the properties due, enters diagnostic mode.  False with none due.
+    bool start(unsigned long nowMs);
+    void stop();
+    SweepRun getRun();
+    bool isRunning();
+
+    // Every frame from the display ring, in place of the filter's own update()
+    uint8_t update(const DispFrame &frame);
+    // settled is what update() and the filter's poll() returned since the last poll.  A command
+    // to send is written into msg with SweepSend, a value just stored is
+    // getProperty() with SweepCaptured.
+    uint8_t poll(uint8_t *msg, unsigned long nowMs, uint8_t settled);
+
+    int8_t getProperty();             // the property being captured, -1 when idle
+    // The last one captured, as the filter settled it.  Stepping on starts the filter over.
+    int8_t getCapturedIndex();
+    const char *getValue();
+    uint8_t getConfidence();
+    unsigned long getSettleMs();
+    unsigned long getStepMs();        // last one captured, from its first step to its value
+    unsigned long getSweepMs();       // last sweep start to end, or so far
+    unsigned long getStepMaxMs();     // of the last sweep
+    uint8_t getPlanned();             // properties due in the last sweep
+    uint8_t getCaptured();
+    uint8_t getMissed();              // skipped after SWEEP_RETRIES
+    unsigned long getSent();          // commands of the last sweep, entry ones too
+    unsigned long getRetries();
+    unsigned long getReentries();
+
+private:
+    SenvilleDispFilter *filter;
+    Properties *props;
+    SweepRun run;
+    uint32_t wanted, hot;
+    uint32_t left;                    // due in this sweep and not yet read
+    bool wrap;
+    unsigned long sweeps;             // started since the properties were set
+    int8_t target;                    // property wanted
+    int8_t at;                        // label last settled, -1 not known
+    int8_t stepFrom;                  // label when the last step went out,
+    int8_t stepDir;                   //   which way it went,
+    uint8_t stepLen;                  //   how many commands it takes
+    uint8_t pending;                  //   and how many are still to go out
+    uint8_t entrySent;
+    uint8_t tries;                    // of the target
+    uint8_t reentries;
+    unsigned long sweepStartMs, sweepEndMs;
+    unsigned long targetMs;           // first step toward the target
+    unsigned long stepMs;             // last command out,
+    unsigned long landMs;             //   and when the unit has it
+    bool landing;
+    unsigned long lastStepMs, stepMaxMs;
+    int8_t lastIndex;
+    char lastValue[DISP_MAXSTRINGPERCODE * 2];
+    uint8_t lastConfidence;
+    unsigned long lastSettleMs;
+    uint8_t planned, captured, missed;
+    unsigned long sent, retries, totalReentries;
+
+    int8_t choose(int8_t from);
+    int8_t hops(int8_t from, int8_t to);
+    uint8_t enter(unsigned long nowMs);
+    uint8_t step(uint8_t *msg, unsigned long nowMs);
+    uint8_t next(uint8_t *msg, unsigned long nowMs);
+    uint8_t retry(uint8_t *msg, unsigned long nowMs);
+    uint8_t send(uint8_t *msg, Option option, unsigned long nowMs);
+};
+
+#endif /* SenvilleSweep_hpp */
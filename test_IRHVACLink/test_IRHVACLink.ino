@@ -24,9 +24,9 @@ void loop() {
  
     if(senville->isValid(mem)) {
       Serial.print("Validated message : ");
-      senville->toBuff(outputBuff);
+      senville->toBuff(outputBuff, sizeof(outputBuff));
       Serial.println(outputBuff);
-      senville->toJsonBuff(outputBuff);
+      senville->toJsonBuff(outputBuff, sizeof(outputBuff));
       Serial.println(outputBuff);
 
       // Test sending value
@@ -0,0 +1 @@
+../../src/BuffWriter.hpp
\ No newline at end of file
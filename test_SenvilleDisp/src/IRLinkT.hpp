@@ -0,0 +1 @@
+../../src/IRLinkT.hpp
\ No newline at end of file
@@ -13,7 +13,7 @@ void setup() {
 
 void loop() {
   if(disp->hasUpdate()) {
-    disp->toBuff(lineBuf);
+    disp->toBuff(lineBuf, sizeof(lineBuf));
     Serial.println(lineBuf);
     disp->listen();
   }